@@ -116,6 +116,12 @@ struct bluealsa_ctl {
 	struct ctl_elem *elem_list;
 	size_t elem_list_size;
 
+	/* Open addressing hash index of control elements by the name and index.
+	 * Every slot holds an element list offset incremented by one, so zero
+	 * denotes an empty slot. The size is always a power of two. */
+	size_t *elem_hash;
+	size_t elem_hash_size;
+
 	/* list of control element update events */
 	struct ctl_elem_update *elem_update_list;
 	size_t elem_update_list_size;
@@ -417,9 +423,11 @@ static int bluealsa_pcm_remove(struct bluealsa_ctl *ctl, const char *path) {
 	for (i = 0; i < ctl->pcm_list_size; i++)
 		if (strcmp(ctl->pcm_list[i]->pcm_path, path) == 0) {
 
-			/* clear all pending events associated with removed PCM */
+			/* clear all pending events associated with removed PCM,
+			 * except for the element remove events */
 			for (size_t ii = 0; ii < ctl->elem_update_list_size; ii++)
-				if (ctl->elem_update_list[ii].pcm == ctl->pcm_list[i])
+				if (ctl->elem_update_list[ii].pcm == ctl->pcm_list[i] &&
+						ctl->elem_update_list[ii].event_mask != SND_CTL_EVENT_MASK_REMOVE)
 					ctl->elem_update_list[ii].event_mask = 0;
 
 			/* remove PCM from the list */
@@ -765,6 +773,89 @@ static bool elem_list_dev_has_battery_elem(const struct ctl_elem *elem_list,
 	return false;
 }
 
+/**
+ * Calculate FNV-1a hash of the element name and index. */
+static uint32_t bluealsa_elem_hash(const char *name, unsigned int index) {
+	uint32_t hash = 2166136261U;
+	while (*name != '\0') {
+		hash ^= (unsigned char)*name++;
+		hash *= 16777619U;
+	}
+	hash ^= index;
+	hash *= 16777619U;
+	return hash;
+}
+
+/**
+ * Rebuild the hash index of control elements.
+ *
+ * @param ctl The BlueALSA controller context.
+ * @return On success this function returns 0. Otherwise -1 is returned and
+ *   the element lookup falls back to the linear search. */
+static int bluealsa_elem_hash_rebuild(struct bluealsa_ctl *ctl) {
+
+	/* keep the load factor below 0.5 */
+	size_t size = 16;
+	while (size < ctl->elem_list_size * 2)
+		size *= 2;
+
+	if (size != ctl->elem_hash_size) {
+		size_t *hash = ctl->elem_hash;
+		if ((hash = realloc(hash, size * sizeof(*hash))) == NULL) {
+			free(ctl->elem_hash);
+			ctl->elem_hash = NULL;
+			ctl->elem_hash_size = 0;
+			return -1;
+		}
+		ctl->elem_hash = hash;
+		ctl->elem_hash_size = size;
+	}
+
+	memset(ctl->elem_hash, 0, size * sizeof(*ctl->elem_hash));
+
+	const size_t mask = size - 1;
+	for (size_t i = 0; i < ctl->elem_list_size; i++) {
+		const struct ctl_elem *elem = &ctl->elem_list[i];
+		size_t slot = bluealsa_elem_hash(elem->name, elem->index) & mask;
+		while (ctl->elem_hash[slot] != 0)
+			slot = (slot + 1) & mask;
+		ctl->elem_hash[slot] = i + 1;
+	}
+
+	return 0;
+}
+
+/**
+ * Look up control element by its name and index.
+ *
+ * @param ctl The BlueALSA controller context.
+ * @param name The name of the element.
+ * @param index The index of the element.
+ * @return The offset of the element in the element list, or -1 if there is
+ *   no such element. */
+static ssize_t bluealsa_elem_hash_lookup(struct bluealsa_ctl *ctl,
+		const char *name, unsigned int index) {
+
+	if (ctl->elem_hash == NULL) {
+		for (size_t i = 0; i < ctl->elem_list_size; i++)
+			if (strcmp(ctl->elem_list[i].name, name) == 0 &&
+					ctl->elem_list[i].index == index)
+				return i;
+		return -1;
+	}
+
+	const size_t mask = ctl->elem_hash_size - 1;
+	size_t slot = bluealsa_elem_hash(name, index) & mask;
+	for (; ctl->elem_hash[slot] != 0; slot = (slot + 1) & mask) {
+		const size_t i = ctl->elem_hash[slot] - 1;
+		if (ctl->elem_list[i].index == index &&
+				strcmp(ctl->elem_list[i].name, name) == 0)
+			return i;
+	}
+
+	return -1;
+}
+
 static int bluealsa_create_elem_list(struct bluealsa_ctl *ctl) {
 
 	size_t count = 0;
@@ -866,9 +957,161 @@ static int bluealsa_create_elem_list(struct bluealsa_ctl *ctl) {
 	ctl->elem_list = elem_list;
 	ctl->elem_list_size = count;
 
+	bluealsa_elem_hash_rebuild(ctl);
+
 	return count;
 }
 
+/**
+ * Check whether elements of devices with a given name are annotated with the
+ * device ID number.
+ *
+ * @param ctl The BlueALSA controller context.
+ * @param name The name of the device.
+ * @return True if any such element name has the device ID suffix. */
+static bool bluealsa_elem_list_has_device_id(struct bluealsa_ctl *ctl,
+		const char *name) {
+
+	if (ctl->single_device)
+		return false;
+
+	for (size_t i = 0; i < ctl->elem_list_size; i++) {
+		const struct ctl_elem *elem = &ctl->elem_list[i];
+		if (strcmp(elem->dev->name, name) != 0)
+			continue;
+		struct ctl_elem tmp = *elem;
+		bluealsa_elem_set_name(ctl, &tmp, elem->dev->name, false);
+		if (strcmp(tmp.name, elem->name) != 0)
+			return true;
+	}
+
+	return false;
+}
+
+/**
+ * Append control elements of a new PCM to the element list.
+ *
+ * New elements are added at the end of the list, so the numids of all
+ * existing elements stay intact and only ADD events are generated. Hence,
+ * unlike with bluealsa_create_elem_list(), the list is not sorted. This is
+ * accepted, because ALSA does not require any particular order, and the
+ * sorted order is restored with the next full rebuild of the list.
+ *
+ * @param ctl The BlueALSA controller context.
+ * @param pcm The BlueALSA PCM from the controller PCM list.
+ * @return On success this function returns 0. Otherwise -1 is returned, in
+ *   which case the element list has to be recreated from scratch. */
+static int bluealsa_elem_list_add_pcm(struct bluealsa_ctl *ctl, struct ba_pcm *pcm) {
+
+	struct bt_dev *dev;
+	if ((dev = bluealsa_dev_get(ctl, pcm)) == NULL)
+		return -1;
+
+	/* Duplicated device names require element names to be annotated with
+	 * the device ID number, which might rename already existing elements. */
+	if (!ctl->single_device)
+		for (size_t i = 0; i < ctl->dev_list_size; i++)
+			if (ctl->dev_list[i] != dev &&
+					strcmp(ctl->dev_list[i]->name, dev->name) == 0)
+				return -1;
+
+	/* Elements of this device might still have the device ID suffix, which
+	 * is no longer needed. New elements are added without such suffix, so
+	 * names of all elements of the device have to be recomputed. */
+	if (bluealsa_elem_list_has_device_id(ctl, dev->name))
+		return -1;
+
+	/* volume, switch, codec, volume mode, delay sync and battery */
+	const size_t size = ctl->elem_list_size;
+	struct ctl_elem *elem_list = ctl->elem_list;
+	if ((elem_list = realloc(elem_list, (size + 6) * sizeof(*elem_list))) == NULL)
+		return -1;
+	ctl->elem_list = elem_list;
+
+	struct ba_pcm_codecs codecs = { 0 };
+	bool add_battery_elem = false;
+
+	if (ctl->show_codec && (
+				BA_PCM_A2DP_MAIN_CHANNEL(pcm) ||
+				BA_PCM_SCO_SPEAKER_CHANNEL(pcm)))
+		bluealsa_pcm_fetch_codecs(ctl, pcm, &codecs);
+
+	if (ctl->show_battery &&
+			!elem_list_dev_has_battery_elem(elem_list, size, dev)) {
+		bluealsa_dev_fetch_battery(ctl, dev);
+		add_battery_elem = true;
+	}
+
+	const size_t count = size + bluealsa_elem_list_add_pcm_elems(ctl,
+			&elem_list[size], dev, pcm, &codecs, add_battery_elem);
+
+	for (size_t i = size; i < count; i++) {
+		elem_list[i].numid = i + 1;
+		bluealsa_event_elem_added(ctl, &elem_list[i]);
+	}
+
+	ctl->elem_list_size = count;
+	bluealsa_elem_hash_rebuild(ctl);
+
+	return 0;
+}
+
+/**
+ * Remove control elements of a given PCM from the element list.
+ *
+ * Holes left by removed elements are filled with elements from the end of
+ * the list, so the numids of all other elements stay intact. Moved elements
+ * are announced as removed and added again with new numids.
+ *
+ * @param ctl The BlueALSA controller context.
+ * @param pcm The BlueALSA PCM from the controller PCM list.
+ * @return On success this function returns 0. If the device ID suffix of
+ *   remaining elements might no longer be needed, -1 is returned, in which
+ *   case the element list has to be recreated from scratch. */
+static int bluealsa_elem_list_remove_pcm(struct bluealsa_ctl *ctl,
+		const struct ba_pcm *pcm) {
+
+	struct ctl_elem *elem_list = ctl->elem_list;
+	size_t size = ctl->elem_list_size;
+	const struct bt_dev *dev = NULL;
+	size_t removed = 0;
+
+	for (size_t i = 0; i < size; i++)
+		if (elem_list[i].pcm == pcm) {
+			dev = elem_list[i].dev;
+			bluealsa_event_elem_removed(ctl, &elem_list[i]);
+			if (elem_list[i].type == CTL_ELEM_TYPE_CODEC)
+				ba_dbus_pcm_codecs_free(&elem_list[i].codecs);
+			removed++;
+		}
+
+	if (removed == 0)
+		return 0;
+
+	/* The number of holes below the new list size is equal to the number of
+	 * remaining elements above it, so every hole will be filled. */
+	size -= removed;
+	for (size_t hole = 0, tail = size;; hole++, tail++) {
+		while (hole < size && elem_list[hole].pcm != pcm)
+			hole++;
+		if (hole == size)
+			break;
+		while (elem_list[tail].pcm == pcm)
+			tail++;
+		bluealsa_event_elem_removed(ctl, &elem_list[tail]);
+		memcpy(&elem_list[hole], &elem_list[tail], sizeof(*elem_list));
+		elem_list[hole].numid = hole + 1;
+		bluealsa_event_elem_added(ctl, &elem_list[hole]);
+	}
+
+	ctl->elem_list_size = size;
+	bluealsa_elem_hash_rebuild(ctl);
+
+	/* The removed elements might have been the reason
+	 * for annotating other names with the device ID. */
+	return bluealsa_elem_list_has_device_id(ctl, dev->name) ? -1 : 0;
+}
+
 static void bluealsa_free_elem_list(struct bluealsa_ctl *ctl) {
 	for (size_t i = 0; i < ctl->elem_list_size; i++)
 		if (ctl->elem_list[i].type == CTL_ELEM_TYPE_CODEC)
@@ -895,6 +1138,7 @@ static void bluealsa_close(snd_ctl_ext_t *ext) {
 	free(ctl->dev_list);
 	free(ctl->pcm_list);
 	free(ctl->elem_list);
+	free(ctl->elem_hash);
 	free(ctl->elem_update_list);
 	free(ctl);
 }
@@ -928,12 +1172,10 @@ static snd_ctl_ext_key_t bluealsa_find_elem(snd_ctl_ext_t *ext, const snd_ctl_el
 
 	const char *name = snd_ctl_elem_id_get_name(id);
 	unsigned int index = snd_ctl_elem_id_get_index(id);
-	size_t i;
 
-	for (i = 0; i < ctl->elem_list_size; i++)
-		if (strcmp(ctl->elem_list[i].name, name) == 0 &&
-				ctl->elem_list[i].index == index)
-			return i;
+	ssize_t i;
+	if ((i = bluealsa_elem_hash_lookup(ctl, name, index)) != -1)
+		return i;
 
 	return SND_CTL_EXT_KEY_NOT_FOUND;
 }
@@ -1438,12 +1680,17 @@ static DBusHandlerResult bluealsa_dbus_msg_filter(DBusConnection *conn,
 			if (dbus_message_iter_get_ba_pcm(&iter, NULL, &pcm) &&
 					pcm.transport != BA_PCM_TRANSPORT_NONE) {
 
-				if (ctl->dynamic)
-					bluealsa_pcm_add(ctl, &pcm);
-				else
+				if (!ctl->dynamic) {
 					bluealsa_pcm_activate(ctl, &pcm);
+					goto remove_add;
+				}
 
-				goto remove_add;
+				if (bluealsa_pcm_add(ctl, &pcm) == -1 ||
+						bluealsa_elem_list_add_pcm(ctl,
+							ctl->pcm_list[ctl->pcm_list_size - 1]) == -1)
+					goto remove_add;
+
+				goto final;
 
 			}
 		}
@@ -1453,14 +1700,23 @@ static DBusHandlerResult bluealsa_dbus_msg_filter(DBusConnection *conn,
 			const char *pcm_path;
 			dbus_message_iter_get_basic(&iter, &pcm_path);
 
-			if (ctl->dynamic)
-				bluealsa_pcm_remove(ctl, pcm_path);
-			else
+			if (!ctl->dynamic) {
 				/* In the non-dynamic operation mode we never remove any elements,
 				 * we simply mark all elements of the removed PCM as inactive. */
 				bluealsa_pcm_deactivate(ctl, pcm_path);
+				goto remove_add;
+			}
+
+			bool rebuild = false;
+			for (i = 0; i < ctl->pcm_list_size; i++)
+				if (strcmp(ctl->pcm_list[i]->pcm_path, pcm_path) == 0 &&
+						bluealsa_elem_list_remove_pcm(ctl, ctl->pcm_list[i]) == -1)
+					rebuild = true;
+			bluealsa_pcm_remove(ctl, pcm_path);
 
-			goto remove_add;
+			if (rebuild)
+				goto remove_add;
+			goto final;
 
 		}
 
@@ -1494,11 +1750,12 @@ remove_add:
 		/* non-dynamic mode SHALL not add/remove any elements */
 		goto final;
 
-	/* During a PCM name change, new PCM insertion and/or deletion, the name
-	 * of all control elements might have change, because of optional unique
-	 * device ID suffix - for more information see the bluealsa_elem_set_name()
-	 * function. So, in such a case we will simply remove all old controllers
-	 * and add new ones in order to update potential name changes. */
+	/* During a device name change, or a PCM insertion which introduces device
+	 * name duplication, the name of all control elements might have change,
+	 * because of optional unique device ID suffix - for more information see
+	 * the bluealsa_elem_set_name() function. So, in such a case we will simply
+	 * remove all old controllers and add new ones in order to update potential
+	 * name changes. */
 
 	for (i = 0; i < ctl->elem_list_size; i++)
 		bluealsa_event_elem_removed(ctl, &ctl->elem_list[i]);
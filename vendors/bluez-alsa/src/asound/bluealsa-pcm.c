@@ -26,6 +26,7 @@
 #include <strings.h>
 #include <sys/eventfd.h>
 #include <sys/ioctl.h>
+#include <sys/mman.h>
 #include <sys/param.h>
 #include <sys/time.h>
 #include <unistd.h>
@@ -40,6 +41,7 @@
 #include "shared/defs.h"
 #include "shared/hex.h"
 #include "shared/log.h"
+#include "shared/pcm-status.h"
 #include "shared/rt.h"
 
 #define BA_PAUSE_STATE_RUNNING 0
@@ -78,6 +80,8 @@ struct bluealsa_pcm {
 	int ba_pcm_fd;
 	/* PCM control socket */
 	int ba_pcm_ctrl_fd;
+	/* PCM status page published by the server */
+	const struct ba_pcm_status *ba_pcm_status;
 
 	/* Indicates that the server is connected. */
 	atomic_bool connected;
@@ -104,6 +108,8 @@ struct bluealsa_pcm {
 	struct timespec delay_ts;
 	snd_pcm_uframes_t delay_hw_ptr;
 	unsigned int delay_pcm_nread;
+	/* frames transferred by the server at delay_ts, see the status page */
+	uint64_t delay_ba_frames;
 	/* In the capture mode, delay_running indicates that frames are being
 	 * transferred to the FIFO by the server. In playback mode it indicates
 	 * that the IO thread is transferring frames to the FIFO. */
@@ -173,9 +179,13 @@ static void io_thread_cleanup(struct bluealsa_pcm *pcm) {
 static void io_thread_update_delay(struct bluealsa_pcm *pcm,
 		snd_pcm_sframes_t hw_ptr) {
 
-	struct timespec now;
+	struct timespec now, ba_ts;
 	unsigned int nread = 0;
+	uint64_t ba_frames = 0;
+	uint32_t ba_delay;
 
+	if (pcm->ba_pcm_status != NULL)
+		ba_pcm_status_read(pcm->ba_pcm_status, &ba_delay, &ba_frames, &ba_ts);
 	gettimestamp(&now);
 	ioctl(pcm->ba_pcm_fd, FIONREAD, &nread);
 
@@ -184,6 +194,7 @@ static void io_thread_update_delay(struct bluealsa_pcm *pcm,
 	/* stash current time and levels */
 	pcm->delay_ts = now;
 	pcm->delay_pcm_nread = nread;
+	pcm->delay_ba_frames = ba_frames;
 	if (hw_ptr == -1) {
 		pcm->delay_hw_ptr = 0;
 		if (pcm->io.stream == SND_PCM_STREAM_PLAYBACK)
@@ -404,6 +415,11 @@ static int bluealsa_start(snd_pcm_ioplug_t *io) {
 	 * playback transmission begins only when first period has been written
 	 * by the application. */
 	pcm->delay_running = io->stream == SND_PCM_STREAM_CAPTURE ? true : false;
+	if (pcm->ba_pcm_status != NULL) {
+		uint32_t ba_delay;
+		struct timespec ba_ts;
+		ba_pcm_status_read(pcm->ba_pcm_status, &ba_delay, &pcm->delay_ba_frames, &ba_ts);
+	}
 	gettimestamp(&pcm->delay_ts);
 
 	/* start the IO thread */
@@ -586,6 +602,18 @@ static int bluealsa_hw_params(snd_pcm_ioplug_t *io, snd_pcm_hw_params_t *params)
 
 	pcm->connected = true;
 
+	/* Map the PCM status page, so the server delay can be read without
+	 * D-Bus round trips. Older servers do not provide such page, in which
+	 * case we will rely on the D-Bus Delay property. */
+	int status_fd;
+	if (ba_dbus_pcm_ctrl_status(pcm->ba_pcm_ctrl_fd, &status_fd, NULL)) {
+		void *status;
+		if ((status = mmap(NULL, sizeof(*pcm->ba_pcm_status), PROT_READ,
+						MAP_SHARED, status_fd, 0)) != MAP_FAILED)
+			pcm->ba_pcm_status = status;
+		close(status_fd);
+	}
+
 	if (pcm->io.stream == SND_PCM_STREAM_PLAYBACK)
 		/* By default, the size of the pipe buffer is set to a too large value for
 		 * our purpose. On modern Linux system it is 65536 bytes. Large buffer in
@@ -624,8 +652,12 @@ static int bluealsa_hw_free(snd_pcm_ioplug_t *io) {
 	if (pcm->ba_pcm_ctrl_fd != -1)
 		rv |= close(pcm->ba_pcm_ctrl_fd);
 
+	if (pcm->ba_pcm_status != NULL)
+		munmap((void *)pcm->ba_pcm_status, sizeof(*pcm->ba_pcm_status));
+
 	pcm->ba_pcm_fd = -1;
 	pcm->ba_pcm_ctrl_fd = -1;
+	pcm->ba_pcm_status = NULL;
 	pcm->connected = false;
 
 	return rv == 0 ? 0 : -errno;
@@ -803,6 +835,18 @@ static snd_pcm_sframes_t bluealsa_calculate_delay(snd_pcm_ioplug_t *io) {
 
 	snd_pcm_sframes_t delay = 0;
 
+	/* The BlueALSA component of the delay. If the server publishes the PCM
+	 * status page, it is always up to date, and reading it is cheap. The page
+	 * also tells how many frames the server has transferred, and when. */
+	uint32_t ba_delay = pcm->ba_pcm.delay;
+	uint64_t ba_frames = 0;
+	struct timespec ba_ts = { 0 };
+
+	if (pcm->ba_pcm_status != NULL)
+		ba_pcm_status_read(pcm->ba_pcm_status, &ba_delay, &ba_frames, &ba_ts);
+
+	/* take the time after reading the page, so it is not older than the
+	 * time of the last update stored in the page */
 	struct timespec now;
 	gettimestamp(&now);
 
@@ -815,10 +859,14 @@ static snd_pcm_sframes_t bluealsa_calculate_delay(snd_pcm_ioplug_t *io) {
 	 *
 	 * This synchronous dispatching will be performed only if the last D-Bus
 	 * dispatching was done more than one second ago - this should prioritize
-	 * asynchronous dispatching in the poll_revents() callback. */
+	 * asynchronous dispatching in the poll_revents() callback. With the
+	 * status page mapped, the Delay property is not needed, but other
+	 * signals (e.g. volume or codec change) shall still be processed. */
 	if (pcm->dbus_dispatch_ts.tv_sec + 1 < now.tv_sec) {
 		ba_dbus_connection_dispatch(&pcm->dbus_ctx);
 		gettimestamp(&pcm->dbus_dispatch_ts);
+		if (pcm->ba_pcm_status == NULL)
+			ba_delay = pcm->ba_pcm.delay;
 	}
 
 	pthread_mutex_lock(&pcm->mutex);
@@ -830,12 +878,23 @@ static snd_pcm_sframes_t bluealsa_calculate_delay(snd_pcm_ioplug_t *io) {
 	}
 
 	struct timespec diff;
-	timespecsub(&now, &pcm->delay_ts, &diff);
-
-	/* the maximum number of frames that can have been
-	 * produced/consumed by the server since pcm->delay_ts */
-	unsigned int tframes =
-		(diff.tv_sec * 1000 + diff.tv_nsec / 1000000) * io->rate / 1000;
+	unsigned int tframes;
+
+	if (ba_frames > pcm->delay_ba_frames &&
+			difftimespec(&pcm->delay_ts, &ba_ts, &diff) > 0) {
+		/* The server has updated the status page since pcm->delay_ts, so we
+		 * know exactly how many frames it has produced/consumed until then.
+		 * Extrapolate only the time elapsed since that update. */
+		timespecsub(&now, &ba_ts, &diff);
+		tframes = ba_frames - pcm->delay_ba_frames +
+			(diff.tv_sec * 1000 + diff.tv_nsec / 1000000) * io->rate / 1000;
+	}
+	else {
+		/* the maximum number of frames that can have been
+		 * produced/consumed by the server since pcm->delay_ts */
+		timespecsub(&now, &pcm->delay_ts, &diff);
+		tframes = (diff.tv_sec * 1000 + diff.tv_nsec / 1000000) * io->rate / 1000;
+	}
 
 	/* the number of frames that were in the FIFO at pcm->delay_ts */
 	snd_pcm_uframes_t fifo_delay = pcm->delay_pcm_nread / pcm->frame_size;
@@ -885,7 +944,7 @@ static snd_pcm_sframes_t bluealsa_calculate_delay(snd_pcm_ioplug_t *io) {
 	pthread_mutex_unlock(&pcm->mutex);
 
 	/* data transfer (communication) and encoding/decoding */
-	delay += (io->rate / 100) * pcm->ba_pcm.delay / 100;
+	delay += (io->rate / 100) * ba_delay / 100;
 
 	delay += pcm->delay_ex;
 
@@ -41,6 +41,8 @@ struct ba_config config = {
 
 	.disable_realtek_usb_fix = false,
 
+	.dbus_pcm_update_interval = 0,
+
 	/* CVSD is a mandatory codec */
 	.hfp.codecs.cvsd = true,
 #if ENABLE_MSBC
@@ -75,6 +75,11 @@ struct ba_config {
 	/* disable alt-3 MTU for mSBC with Realtek USB adapters */
 	bool disable_realtek_usb_fix;
 
+	/* The minimal time in milliseconds between two PCM property change
+	 * signals emitted over D-Bus. Changes which occur in the meantime are
+	 * merged and sent as a single signal. Zero disables this feature. */
+	unsigned int dbus_pcm_update_interval;
+
 	struct {
 
 		/* available HFP codecs */
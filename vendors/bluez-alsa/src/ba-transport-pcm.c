@@ -15,13 +15,17 @@
 #endif
 
 #include <errno.h>
+#include <fcntl.h>
 #include <math.h>
+#include <poll.h>
 #include <sched.h>
 #include <signal.h>
 #include <stdbool.h>
 #include <stdint.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
 #include <unistd.h>
 
 #include <glib.h>
@@ -32,6 +36,7 @@
 #include "ba-rfcomm.h"
 #include "ba-transport.h"
 #include "bluealsa-dbus.h"
+#include "bluealsa-iface.h"
 #include "bluez-iface.h"
 #include "bluez.h"
 #include "dbus.h"
@@ -41,6 +46,7 @@
 #endif
 #include "shared/defs.h"
 #include "shared/log.h"
+#include "shared/rt.h"
 
 static const char *transport_get_dbus_path_type(
 		enum ba_transport_profile profile) {
@@ -76,6 +82,8 @@ int transport_pcm_init(
 	pcm->fd_bt = -1;
 	pcm->pipe[0] = -1;
 	pcm->pipe[1] = -1;
+	pcm->status_fd = -1;
+	pcm->controller_fd = -1;
 
 	pcm->volume[0].level = config.volume_init_level;
 	pcm->volume[1].level = config.volume_init_level;
@@ -118,6 +126,11 @@ void transport_pcm_free(
 	if (pcm->pipe[1] != -1)
 		close(pcm->pipe[1]);
 
+	if (pcm->status != NULL)
+		munmap(pcm->status, sizeof(*pcm->status));
+	if (pcm->status_fd != -1)
+		close(pcm->status_fd);
+
 	g_hash_table_unref(pcm->delay_adjustments);
 	g_free(pcm->ba_dbus_path);
 
@@ -455,10 +468,11 @@ int ba_transport_pcm_release(struct ba_transport_pcm *pcm) {
 		pcm->fd = -1;
 	}
 
-	if (pcm->controller != NULL) {
-		g_source_destroy(pcm->controller);
-		g_source_unref(pcm->controller);
-		pcm->controller = NULL;
+	if (pcm->controller_fd != -1) {
+		/* Wake up the controller thread. The socket itself will be closed
+		 * by the thread, so we will not race with the poll() call. */
+		shutdown(pcm->controller_fd, SHUT_RDWR);
+		pcm->controller_fd = -1;
 	}
 
 	return 0;
@@ -535,6 +549,189 @@ int ba_transport_pcm_drop(struct ba_transport_pcm *pcm) {
 	return rv;
 }
 
+/**
+ * Send PCM controller reply with attached file descriptor. */
+static ssize_t transport_pcm_controller_send_fd(int sock, const char *reply, int fd) {
+
+	char buf[CMSG_SPACE(sizeof(fd))] = { 0 };
+	struct iovec io = { .iov_base = (void *)reply, .iov_len = strlen(reply) };
+	struct msghdr msg = {
+		.msg_iov = &io,
+		.msg_iovlen = 1,
+		.msg_control = buf,
+		.msg_controllen = sizeof(buf) };
+
+	struct cmsghdr *cmsg = CMSG_FIRSTHDR(&msg);
+	cmsg->cmsg_level = SOL_SOCKET;
+	cmsg->cmsg_type = SCM_RIGHTS;
+	cmsg->cmsg_len = CMSG_LEN(sizeof(fd));
+	memcpy(CMSG_DATA(cmsg), &fd, sizeof(fd));
+
+	ssize_t ret;
+	while ((ret = sendmsg(sock, &msg, MSG_NOSIGNAL)) == -1 && errno == EINTR)
+		continue;
+	return ret;
+}
+
+/**
+ * Send PCM controller reply. */
+static void transport_pcm_controller_send(int sock, const char *reply) {
+	ssize_t ret;
+	while ((ret = send(sock, reply, strlen(reply), MSG_NOSIGNAL)) == -1 && errno == EINTR)
+		continue;
+	if (ret == -1)
+		debug("Couldn't send PCM controller reply: %s", strerror(errno));
+}
+
+static void transport_pcm_controller_process(struct ba_transport_pcm *pcm,
+		int sock, const char *command, size_t len) {
+
+	if (strncmp(command, BLUEALSA_PCM_CTRL_DRAIN, len) == 0) {
+		if (pcm->mode == BA_TRANSPORT_PCM_MODE_SINK)
+			ba_transport_pcm_drain(pcm);
+		transport_pcm_controller_send(sock, "OK");
+	}
+	else if (strncmp(command, BLUEALSA_PCM_CTRL_DROP, len) == 0) {
+		if (pcm->mode == BA_TRANSPORT_PCM_MODE_SINK)
+			ba_transport_pcm_drop(pcm);
+		transport_pcm_controller_send(sock, "OK");
+	}
+	else if (strncmp(command, BLUEALSA_PCM_CTRL_PAUSE, len) == 0) {
+		ba_transport_pcm_pause(pcm);
+		transport_pcm_controller_send(sock, "OK");
+	}
+	else if (strncmp(command, BLUEALSA_PCM_CTRL_RESUME, len) == 0) {
+		ba_transport_pcm_resume(pcm);
+		transport_pcm_controller_send(sock, "OK");
+	}
+	else if (strncmp(command, BLUEALSA_PCM_CTRL_STATUS, len) == 0) {
+		pthread_mutex_lock(&pcm->mutex);
+		const int status_fd = pcm->status_fd;
+		pthread_mutex_unlock(&pcm->mutex);
+		if (status_fd == -1)
+			transport_pcm_controller_send(sock, "NotSupported");
+		else if (transport_pcm_controller_send_fd(sock, "OK", status_fd) == -1)
+			error("Couldn't send PCM status page: %s", strerror(errno));
+	}
+	else {
+		warn("Invalid PCM control command: %.*s", (int)len, command);
+		transport_pcm_controller_send(sock, "Invalid");
+	}
+
+}
+
+struct transport_pcm_controller {
+	struct ba_transport_pcm *pcm;
+	int sock;
+};
+
+/**
+ * PCM controller thread.
+ *
+ * Control commands are serviced outside of the main loop, so they are not
+ * delayed by the D-Bus traffic, and a blocking command (e.g. drain) does
+ * not stall the main loop. The thread terminates when the client closes
+ * the socket or when the PCM is released. */
+static void *transport_pcm_controller_thread(struct transport_pcm_controller *ctrl) {
+
+	struct ba_transport_pcm *pcm = ctrl->pcm;
+	const int sock = ctrl->sock;
+	free(ctrl);
+
+	struct pollfd pfd = { sock, POLLIN, 0 };
+	char command[32];
+	ssize_t len;
+
+	for (;;) {
+
+		if (poll(&pfd, 1, -1) == -1) {
+			if (errno == EINTR)
+				continue;
+			error("PCM controller poll error: %s", strerror(errno));
+			break;
+		}
+
+		if ((len = recv(sock, command, sizeof(command), 0)) == -1) {
+			if (errno == EINTR || errno == EAGAIN)
+				continue;
+			error("PCM controller read error: %s", strerror(errno));
+			break;
+		}
+
+		if (len == 0)
+			break;
+
+		transport_pcm_controller_process(pcm, sock, command, len);
+
+	}
+
+	/* If the socket was shut down by the ba_transport_pcm_release(),
+	 * the PCM is already released, so there is nothing more to do. */
+	pthread_mutex_lock(&pcm->mutex);
+	const bool client_closed = pcm->controller_fd == sock;
+	if (client_closed)
+		ba_transport_pcm_release(pcm);
+	pthread_mutex_unlock(&pcm->mutex);
+
+	if (client_closed) {
+		ba_transport_pcm_signal_send(pcm, BA_TRANSPORT_PCM_SIGNAL_CLOSE);
+		/* Check whether we've just closed the last PCM client and in
+		 * such a case schedule transport IO threads termination. */
+		ba_transport_stop_if_no_clients(pcm->t);
+	}
+
+	close(sock);
+	ba_transport_pcm_unref(pcm);
+	return NULL;
+}
+
+/**
+ * Start PCM controller thread for the given socket.
+ *
+ * On success, the ownership of the socket is passed to the thread. */
+int ba_transport_pcm_controller_start(struct ba_transport_pcm *pcm, int sock) {
+
+	struct transport_pcm_controller *ctrl;
+	if ((ctrl = malloc(sizeof(*ctrl))) == NULL)
+		return -1;
+
+	ctrl->pcm = ba_transport_pcm_ref(pcm);
+	ctrl->sock = sock;
+
+	pthread_attr_t attr;
+	pthread_attr_init(&attr);
+	pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+
+	/* Block all signals in the new thread, so they will be delivered
+	 * to the main thread which handles them with g_unix_signal_add(). */
+	sigset_t sigset, oldset;
+	sigfillset(&sigset);
+	pthread_sigmask(SIG_SETMASK, &sigset, &oldset);
+
+	pthread_t tid;
+	int err = pthread_create(&tid, &attr, PTHREAD_FUNC(transport_pcm_controller_thread), ctrl);
+
+	pthread_sigmask(SIG_SETMASK, &oldset, NULL);
+	pthread_attr_destroy(&attr);
+
+	if (err != 0) {
+		ba_transport_pcm_unref(pcm);
+		free(ctrl);
+		return errno = err, -1;
+	}
+
+	/* Control commands shall be handled with the same
+	 * latency requirements as the PCM IO itself. */
+	if (config.io_thread_rt_priority != 0) {
+		struct sched_param param = { .sched_priority = config.io_thread_rt_priority };
+		if ((err = pthread_setschedparam(tid, SCHED_FIFO, &param)) != 0)
+			warn("Couldn't set PCM controller thread RT priority: %s", strerror(err));
+	}
+
+	pthread_setname_np(tid, "ba-pcm-ctrl");
+	return 0;
+}
+
 int ba_transport_pcm_signal_send(
 		struct ba_transport_pcm *pcm,
 		enum ba_transport_pcm_signal signal) {
@@ -701,6 +898,85 @@ final:
 	return 0;
 }
 
+/**
+ * Prepare PCM status page for a new PCM client.
+ *
+ * The status page is created on the first call and it is reused afterwards,
+ * so the memfd passed to the client stays valid for the PCM lifetime. This
+ * function shall be called with the PCM lock held.
+ *
+ * @param pcm Transport PCM.
+ * @return On success this function returns 0. Otherwise, -1 is returned and
+ *   errno is set to indicate the error. */
+int ba_transport_pcm_status_open(struct ba_transport_pcm *pcm) {
+
+#if HAVE_MEMFD_CREATE
+	if (pcm->status == NULL) {
+
+		const size_t size = sizeof(*pcm->status);
+		int fd;
+
+		if ((fd = memfd_create("bluealsa-pcm-status", MFD_CLOEXEC | MFD_ALLOW_SEALING)) == -1)
+			return -1;
+		if (ftruncate(fd, size) == -1)
+			goto fail;
+
+		void *status;
+		if ((status = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0)) == MAP_FAILED)
+			goto fail;
+
+		/* Clients shall not be able to resize the page (which would
+		 * crash us with SIGBUS) nor to write to it. */
+		int seals = F_SEAL_SHRINK | F_SEAL_GROW;
+# if defined(F_SEAL_FUTURE_WRITE)
+		seals |= F_SEAL_FUTURE_WRITE;
+# endif
+		if (fcntl(fd, F_ADD_SEALS, seals) == -1)
+			warn("Couldn't seal PCM status page: %s", strerror(errno));
+
+		pcm->status = status;
+		pcm->status_fd = fd;
+		goto reset;
+
+fail:
+		close(fd);
+		return -1;
+	}
+
+reset:
+	pcm->status_frames = 0;
+	ba_pcm_status_update(pcm->status, MAX(ba_transport_pcm_get_delay(pcm), 0),
+			0, &(struct timespec){ 0 });
+	return 0;
+#else
+	(void)pcm;
+	errno = ENOTSUP;
+	return -1;
+#endif
+
+}
+
+/**
+ * Publish current PCM delay and transferred frames in the status page.
+ *
+ * This function shall be called by the PCM IO thread with the PCM lock held.
+ *
+ * @param pcm Transport PCM.
+ * @param samples Number of samples transferred by the last IO operation. */
+void ba_transport_pcm_status_update(struct ba_transport_pcm *pcm, size_t samples) {
+
+	if (pcm->status == NULL)
+		return;
+
+	struct timespec ts;
+	gettimestamp(&ts);
+
+	pcm->status_frames += samples / pcm->channels;
+	ba_pcm_status_update(pcm->status, MAX(ba_transport_pcm_get_delay(pcm), 0),
+			pcm->status_frames, &ts);
+
+}
+
 int ba_transport_pcm_get_delay(const struct ba_transport_pcm *pcm) {
 
 	const struct ba_transport *t = pcm->t;
@@ -22,6 +22,8 @@
 
 #include <glib.h>
 
+#include "shared/pcm-status.h"
+
 enum ba_transport_pcm_mode {
 	/* PCM used for capturing audio */
 	BA_TRANSPORT_PCM_MODE_SOURCE,
@@ -123,6 +125,13 @@ struct ba_transport_pcm {
 	/* indicates whether FIFO buffer was synchronized */
 	bool synced;
 
+	/* PCM status page shared with the client */
+	struct ba_pcm_status *status;
+	/* memfd backing the status page */
+	int status_fd;
+	/* frames transferred since the PCM was opened */
+	uint64_t status_frames;
+
 	/* internal software volume control */
 	bool soft_volume;
 
@@ -133,8 +142,8 @@ struct ba_transport_pcm {
 	/* new PCM client mutex */
 	pthread_mutex_t client_mtx;
 
-	/* source watch for controller socket */
-	GSource *controller;
+	/* PCM controller socket serviced by a dedicated thread */
+	int controller_fd;
 
 	/* actual thread ID */
 	pthread_t tid;
@@ -146,6 +155,13 @@ struct ba_transport_pcm {
 	char *ba_dbus_path;
 	bool ba_dbus_exported;
 
+	/* properties waiting for the coalesced D-Bus update */
+	unsigned int ba_dbus_update_mask;
+	/* timer source of the coalesced D-Bus update */
+	GSource *ba_dbus_update_timer;
+	/* the last Delay value sent over D-Bus */
+	int ba_dbus_delay;
+
 };
 
 int transport_pcm_init(
@@ -216,6 +232,8 @@ int ba_transport_pcm_resume(struct ba_transport_pcm *pcm);
 int ba_transport_pcm_drain(struct ba_transport_pcm *pcm);
 int ba_transport_pcm_drop(struct ba_transport_pcm *pcm);
 
+int ba_transport_pcm_controller_start(struct ba_transport_pcm *pcm, int sock);
+
 int ba_transport_pcm_signal_send(
 		struct ba_transport_pcm *pcm,
 		enum ba_transport_pcm_signal signal);
@@ -236,6 +254,9 @@ void ba_transport_pcm_volume_set(
 int ba_transport_pcm_volume_update(
 		struct ba_transport_pcm *pcm);
 
+int ba_transport_pcm_status_open(struct ba_transport_pcm *pcm);
+void ba_transport_pcm_status_update(struct ba_transport_pcm *pcm, size_t samples);
+
 int ba_transport_pcm_get_delay(
 		const struct ba_transport_pcm *pcm);
 
@@ -50,6 +50,9 @@
 static const char *bluealsa_dbus_manager_path = "/org/bluealsa";
 static GDBusObjectManagerServer *bluealsa_dbus_manager = NULL;
 
+/* guard coalesced PCM property updates */
+static pthread_mutex_t bluealsa_dbus_pcm_update_mtx = PTHREAD_MUTEX_INITIALIZER;
+
 static GVariant *ba_variant_new_bluealsa_version(void) {
 	return g_variant_new_string(PACKAGE_VERSION);
 }
@@ -363,62 +366,6 @@ void bluealsa_dbus_register(void) {
 
 }
 
-static gboolean bluealsa_pcm_controller(GIOChannel *ch, GIOCondition condition,
-		void *userdata) {
-	(void)condition;
-
-	struct ba_transport_pcm *pcm = userdata;
-	GError *err = NULL;
-	char command[32];
-	size_t len;
-
-	switch (g_io_channel_read_chars(ch, command, sizeof(command), &len, &err)) {
-	case G_IO_STATUS_AGAIN:
-		return TRUE;
-	case G_IO_STATUS_ERROR:
-		error("PCM controller read error: %s", err->message);
-		g_error_free(err);
-		return TRUE;
-	case G_IO_STATUS_NORMAL:
-		if (strncmp(command, BLUEALSA_PCM_CTRL_DRAIN, len) == 0) {
-			if (pcm->mode == BA_TRANSPORT_PCM_MODE_SINK)
-				ba_transport_pcm_drain(pcm);
-			g_io_channel_write_chars(ch, "OK", -1, &len, NULL);
-		}
-		else if (strncmp(command, BLUEALSA_PCM_CTRL_DROP, len) == 0) {
-			if (pcm->mode == BA_TRANSPORT_PCM_MODE_SINK)
-				ba_transport_pcm_drop(pcm);
-			g_io_channel_write_chars(ch, "OK", -1, &len, NULL);
-		}
-		else if (strncmp(command, BLUEALSA_PCM_CTRL_PAUSE, len) == 0) {
-			ba_transport_pcm_pause(pcm);
-			g_io_channel_write_chars(ch, "OK", -1, &len, NULL);
-		}
-		else if (strncmp(command, BLUEALSA_PCM_CTRL_RESUME, len) == 0) {
-			ba_transport_pcm_resume(pcm);
-			g_io_channel_write_chars(ch, "OK", -1, &len, NULL);
-		}
-		else {
-			warn("Invalid PCM control command: %*s", (int)len, command);
-			g_io_channel_write_chars(ch, "Invalid", -1, &len, NULL);
-		}
-		g_io_channel_flush(ch, NULL);
-		return TRUE;
-	case G_IO_STATUS_EOF:
-		pthread_mutex_lock(&pcm->mutex);
-		ba_transport_pcm_release(pcm);
-		pthread_mutex_unlock(&pcm->mutex);
-		ba_transport_pcm_signal_send(pcm, BA_TRANSPORT_PCM_SIGNAL_CLOSE);
-		/* Check whether we've just closed the last PCM client and in
-		 * such a case schedule transport IO threads termination. */
-		ba_transport_stop_if_no_clients(pcm->t);
-		/* remove channel from watch */
-		return FALSE;
-	}
-
-	return TRUE;
-}
-
 static void bluealsa_pcm_open(GDBusMethodInvocation *inv, void *userdata) {
 
 	struct ba_transport_pcm *pcm = userdata;
@@ -490,20 +437,30 @@ static void bluealsa_pcm_open(GDBusMethodInvocation *inv, void *userdata) {
 
 	pthread_mutex_lock(&pcm->mutex);
 
+	/* The controller thread takes the PCM lock only after poll() returns, in
+	 * order to check whether the PCM still uses its socket. This lock is held
+	 * until the controller_fd is set below, and ba_transport_pcm_release()
+	 * shuts the socket down and resets the controller_fd with the same lock
+	 * held. So the thread will always see its own socket in the controller_fd,
+	 * unless the PCM has been released, and it can be started right here. */
+	if (ba_transport_pcm_controller_start(pcm, pcm_fds[2]) == -1) {
+		pthread_mutex_unlock(&pcm->mutex);
+		g_dbus_method_invocation_return_error(inv, G_DBUS_ERROR,
+				G_DBUS_ERROR_FAILED, "Create PCM controller: %s", strerror(errno));
+		goto fail;
+	}
+
 	/* get correct PIPE endpoint - PIPE is unidirectional */
 	pcm->fd = pcm_fds[is_sink ? 0 : 1];
 	/* set newly opened PCM as active */
 	pcm->paused = false;
+	/* controller socket is owned by the controller thread */
+	pcm->controller_fd = pcm_fds[2];
 
-	GIOChannel *ch = g_io_channel_unix_new(pcm_fds[2]);
-	g_io_channel_set_close_on_unref(ch, TRUE);
-	g_io_channel_set_encoding(ch, NULL, NULL);
-	g_io_channel_set_buffered(ch, FALSE);
-
-	pcm->controller = g_io_create_watch_full(ch, G_PRIORITY_DEFAULT,
-			G_IO_IN, bluealsa_pcm_controller, ba_transport_pcm_ref(pcm),
-			(GDestroyNotify)ba_transport_pcm_unref);
-	g_io_channel_unref(ch);
+	/* The status page is optional, the client will fall back to the
+	 * D-Bus Delay property in case it is not available. */
+	if (ba_transport_pcm_status_open(pcm) == -1)
+		debug("Couldn't create PCM status page: %s", strerror(errno));
 
 	pthread_mutex_unlock(&pcm->mutex);
 
@@ -1000,6 +957,11 @@ int bluealsa_dbus_pcm_register(struct ba_transport_pcm *pcm) {
 
 	ba_transport_pcm_ref(pcm);
 
+	/* initial Delay value is obtained by clients with the property getter */
+	pthread_mutex_lock(&bluealsa_dbus_pcm_update_mtx);
+	pcm->ba_dbus_delay = ba_transport_pcm_get_delay(pcm);
+	pthread_mutex_unlock(&bluealsa_dbus_pcm_update_mtx);
+
 	g_dbus_object_skeleton_add_interface(skeleton, G_DBUS_INTERFACE_SKELETON(ifs_pcm));
 	g_dbus_object_manager_server_export(bluealsa_dbus_manager, skeleton);
 	pcm->ba_dbus_exported = true;
@@ -1014,7 +976,16 @@ fail:
 	return 0;
 }
 
-void bluealsa_dbus_pcm_update(struct ba_transport_pcm *pcm, unsigned int mask) {
+/**
+ * Emit PCM properties changed signal. */
+static void bluealsa_dbus_pcm_emit(struct ba_transport_pcm *pcm, unsigned int mask) {
+
+	if (mask & (BA_DBUS_PCM_UPDATE_DELAY | BA_DBUS_PCM_UPDATE_DELAY_ADJUSTMENT)) {
+		const int delay = ba_transport_pcm_get_delay(pcm);
+		pthread_mutex_lock(&bluealsa_dbus_pcm_update_mtx);
+		pcm->ba_dbus_delay = delay;
+		pthread_mutex_unlock(&bluealsa_dbus_pcm_update_mtx);
+	}
 
 	GVariantBuilder props;
 	g_variant_builder_init(&props, G_VARIANT_TYPE("a{sv}"));
@@ -1045,11 +1016,108 @@ void bluealsa_dbus_pcm_update(struct ba_transport_pcm *pcm, unsigned int mask) {
 
 }
 
+static gboolean bluealsa_dbus_pcm_update_timeout(void *userdata) {
+
+	struct ba_transport_pcm *pcm = userdata;
+	GSource *timer = NULL;
+
+	pthread_mutex_lock(&bluealsa_dbus_pcm_update_mtx);
+
+	unsigned int mask = pcm->ba_dbus_update_mask;
+	pcm->ba_dbus_update_mask = 0;
+
+	/* Nothing has changed during the last interval, so the timer is
+	 * no longer needed. Next update will be emitted immediately. */
+	if (mask == 0 && pcm->ba_dbus_update_timer == g_main_current_source()) {
+		timer = pcm->ba_dbus_update_timer;
+		pcm->ba_dbus_update_timer = NULL;
+	}
+
+	pthread_mutex_unlock(&bluealsa_dbus_pcm_update_mtx);
+
+	if (mask != 0) {
+		bluealsa_dbus_pcm_emit(pcm, mask);
+		return G_SOURCE_CONTINUE;
+	}
+
+	if (timer != NULL)
+		g_source_unref(timer);
+	return G_SOURCE_REMOVE;
+}
+
+/**
+ * Notify D-Bus clients about PCM property changes.
+ *
+ * If the D-Bus update interval is configured, at most one signal per
+ * interval is emitted. The first change is emitted immediately, and all
+ * changes which occur within the following interval are merged into one
+ * signal emitted from the main loop when the interval elapses. In such
+ * case, delay changes smaller than the hysteresis are not reported.
+ *
+ * This function can be called from any thread.
+ *
+ * @param pcm Transport PCM.
+ * @param mask Bit mask of changed properties. */
+void bluealsa_dbus_pcm_update(struct ba_transport_pcm *pcm, unsigned int mask) {
+
+	if (config.dbus_pcm_update_interval == 0) {
+		bluealsa_dbus_pcm_emit(pcm, mask);
+		return;
+	}
+
+	/* Suppress tiny delay fluctuations. However, the delay adjustment
+	 * is set explicitly by the user, so it shall be always reported. */
+	if ((mask & BA_DBUS_PCM_UPDATE_DELAY) &&
+			!(mask & BA_DBUS_PCM_UPDATE_DELAY_ADJUSTMENT)) {
+		const int delay = ba_transport_pcm_get_delay(pcm);
+		pthread_mutex_lock(&bluealsa_dbus_pcm_update_mtx);
+		const int diff = delay - pcm->ba_dbus_delay;
+		pthread_mutex_unlock(&bluealsa_dbus_pcm_update_mtx);
+		if (abs(diff) < BA_DBUS_PCM_DELAY_HYSTERESIS)
+			mask &= ~BA_DBUS_PCM_UPDATE_DELAY;
+	}
+
+	if (mask == 0)
+		return;
+
+	pthread_mutex_lock(&bluealsa_dbus_pcm_update_mtx);
+
+	if (pcm->ba_dbus_update_timer != NULL) {
+		/* the signal will be emitted when the current interval elapses */
+		pcm->ba_dbus_update_mask |= mask;
+		pthread_mutex_unlock(&bluealsa_dbus_pcm_update_mtx);
+		return;
+	}
+
+	GSource *timer = g_timeout_source_new(config.dbus_pcm_update_interval);
+	g_source_set_callback(timer, bluealsa_dbus_pcm_update_timeout,
+			ba_transport_pcm_ref(pcm), (GDestroyNotify)ba_transport_pcm_unref);
+	g_source_attach(timer, NULL);
+	pcm->ba_dbus_update_timer = timer;
+
+	pthread_mutex_unlock(&bluealsa_dbus_pcm_update_mtx);
+
+	bluealsa_dbus_pcm_emit(pcm, mask);
+
+}
+
 void bluealsa_dbus_pcm_unregister(struct ba_transport_pcm *pcm) {
 
 	if (!pcm->ba_dbus_exported)
 		return;
 
+	pthread_mutex_lock(&bluealsa_dbus_pcm_update_mtx);
+	GSource *timer = pcm->ba_dbus_update_timer;
+	pcm->ba_dbus_update_timer = NULL;
+	pcm->ba_dbus_update_mask = 0;
+	pthread_mutex_unlock(&bluealsa_dbus_pcm_update_mtx);
+
+	/* drop pending updates for the PCM which is about to be removed */
+	if (timer != NULL) {
+		g_source_destroy(timer);
+		g_source_unref(timer);
+	}
+
 	g_dbus_object_manager_server_unexport(bluealsa_dbus_manager, pcm->ba_dbus_path);
 	pcm->ba_dbus_exported = false;
 
@@ -33,6 +33,11 @@
 #define BA_DBUS_PCM_UPDATE_VOLUME           (1 << 8)
 #define BA_DBUS_PCM_UPDATE_RUNNING          (1 << 9)
 
+/**
+ * Minimal change of the PCM delay (in 1/10 of millisecond) which will
+ * be reported with the D-Bus property change signal. */
+#define BA_DBUS_PCM_DELAY_HYSTERESIS 10
+
 #define BA_DBUS_RFCOMM_UPDATE_FEATURES (1 << 0)
 #define BA_DBUS_RFCOMM_UPDATE_BATTERY  (1 << 1)
 
@@ -39,6 +39,7 @@
 #define BLUEALSA_PCM_CTRL_DROP   "Drop"
 #define BLUEALSA_PCM_CTRL_PAUSE  "Pause"
 #define BLUEALSA_PCM_CTRL_RESUME "Resume"
+#define BLUEALSA_PCM_CTRL_STATUS "Status"
 
 #define BLUEALSA_PCM_MODE_SINK   "sink"
 #define BLUEALSA_PCM_MODE_SOURCE "source"
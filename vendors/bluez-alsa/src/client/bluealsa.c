@@ -0,0 +1,382 @@
+/*
+ * BlueALSA - bluealsa.c
+ * Copyright (c) 2016-2024 Arkadiusz Bokowy
+ *
+ * This file is a part of bluez-alsa.
+ *
+ * This project is licensed under the terms of the MIT license.
+ *
+ */
+
+#include "client/bluealsa.h"
+
+#if HAVE_CONFIG_H
+# include <config.h>
+#endif
+
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <sys/param.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <dbus/dbus.h>
+
+#include "shared/dbus-client.h"
+#include "shared/dbus-client-pcm.h"
+#include "shared/pcm-status.h"
+
+struct bluealsa_pcm {
+
+	/* D-Bus connection context */
+	struct ba_dbus_ctx dbus_ctx;
+	/* BlueALSA PCM properties at the time of opening */
+	struct ba_pcm ba_pcm;
+
+	/* PCM FIFO */
+	int fd;
+	/* PCM control socket */
+	int ctrl_fd;
+	/* PCM status page published by the server */
+	const struct ba_pcm_status *status;
+
+	/* exported stream parameters */
+	struct bluealsa_pcm_info info;
+
+	bluealsa_pcm_io_cb callback;
+	void *userdata;
+
+	/* Period buffer. In the playback mode it holds data returned by the
+	 * callback which were not written to the FIFO yet. In the capture mode
+	 * it accumulates data until a full period can be passed to the callback.
+	 * In both cases, buffer_offset points to the beginning of valid data and
+	 * buffer_len is the number of valid bytes. */
+	uint8_t *buffer;
+	size_t buffer_size;
+	size_t buffer_offset;
+	size_t buffer_len;
+
+};
+
+/**
+ * Open BlueALSA PCM.
+ *
+ * The returned handle does not spawn any thread. The application shall poll
+ * the descriptor returned by bluealsa_pcm_poll_descriptor() and call the
+ * bluealsa_pcm_process() function when the descriptor is ready.
+ *
+ * @param service BlueALSA D-Bus service name. If NULL, the default service
+ *   name is used.
+ * @param pcm_path BlueALSA PCM D-Bus object path.
+ * @param period_frames Number of frames transferred in a single callback.
+ * @param callback PCM IO callback.
+ * @param userdata Data passed to the callback.
+ * @return On success this function returns PCM handle. Otherwise, NULL is
+ *   returned and errno is set to indicate the error. */
+struct bluealsa_pcm *bluealsa_pcm_open(
+		const char *service,
+		const char *pcm_path,
+		size_t period_frames,
+		bluealsa_pcm_io_cb callback,
+		void *userdata) {
+
+	DBusError err = DBUS_ERROR_INIT;
+	struct bluealsa_pcm *pcm;
+	struct ba_pcm *pcms = NULL;
+	size_t pcms_count = 0;
+	size_t i;
+	int rv;
+
+	if (period_frames == 0 || callback == NULL) {
+		errno = EINVAL;
+		return NULL;
+	}
+
+	if ((pcm = calloc(1, sizeof(*pcm))) == NULL)
+		return NULL;
+
+	pcm->fd = -1;
+	pcm->ctrl_fd = -1;
+	pcm->callback = callback;
+	pcm->userdata = userdata;
+
+	if (service == NULL)
+		service = BLUEALSA_SERVICE;
+
+	if (!ba_dbus_connection_ctx_init(&pcm->dbus_ctx, service, &err))
+		goto fail;
+
+	if (!ba_dbus_pcm_get_all(&pcm->dbus_ctx, &pcms, &pcms_count, &err))
+		goto fail;
+
+	for (i = 0; i < pcms_count; i++)
+		if (strcmp(pcms[i].pcm_path, pcm_path) == 0)
+			break;
+
+	if (i == pcms_count) {
+		free(pcms);
+		rv = ENODEV;
+		goto fail_errno;
+	}
+
+	memcpy(&pcm->ba_pcm, &pcms[i], sizeof(pcm->ba_pcm));
+	free(pcms);
+
+	pcm->info.playback = pcm->ba_pcm.mode == BA_PCM_MODE_SINK;
+	pcm->info.format = pcm->ba_pcm.format;
+	pcm->info.channels = pcm->ba_pcm.channels;
+	pcm->info.rate = pcm->ba_pcm.sampling;
+	pcm->info.frame_size = BLUEALSA_PCM_FORMAT_BYTES(pcm->ba_pcm.format) * pcm->ba_pcm.channels;
+	pcm->info.period_frames = period_frames;
+
+	pcm->buffer_size = period_frames * pcm->info.frame_size;
+	if ((pcm->buffer = malloc(pcm->buffer_size)) == NULL) {
+		rv = ENOMEM;
+		goto fail_errno;
+	}
+
+	if (!ba_dbus_pcm_open(&pcm->dbus_ctx, pcm->ba_pcm.pcm_path,
+				&pcm->fd, &pcm->ctrl_fd, &err))
+		goto fail;
+
+	/* All transfers are non-blocking, application drives them. */
+	if (fcntl(pcm->fd, F_SETFL, fcntl(pcm->fd, F_GETFL) | O_NONBLOCK) == -1) {
+		rv = errno;
+		goto fail_errno;
+	}
+
+	/* The status page is optional - older servers do not provide it. */
+	int status_fd;
+	if (ba_dbus_pcm_ctrl_status(pcm->ctrl_fd, &status_fd, NULL)) {
+		void *status;
+		if ((status = mmap(NULL, sizeof(*pcm->status), PROT_READ,
+						MAP_SHARED, status_fd, 0)) != MAP_FAILED)
+			pcm->status = status;
+		close(status_fd);
+	}
+
+	return pcm;
+
+fail:
+	rv = dbus_error_to_errno(&err);
+	dbus_error_free(&err);
+fail_errno:
+	bluealsa_pcm_close(pcm);
+	errno = rv;
+	return NULL;
+}
+
+/**
+ * Close BlueALSA PCM and release all resources. */
+void bluealsa_pcm_close(
+		struct bluealsa_pcm *pcm) {
+	if (pcm->status != NULL)
+		munmap((void *)pcm->status, sizeof(*pcm->status));
+	if (pcm->ctrl_fd != -1)
+		close(pcm->ctrl_fd);
+	if (pcm->fd != -1)
+		close(pcm->fd);
+	ba_dbus_connection_ctx_free(&pcm->dbus_ctx);
+	free(pcm->buffer);
+	free(pcm);
+}
+
+/**
+ * Get BlueALSA PCM stream parameters. */
+const struct bluealsa_pcm_info *bluealsa_pcm_get_info(
+		const struct bluealsa_pcm *pcm) {
+	return &pcm->info;
+}
+
+/**
+ * Get the file descriptor which shall be polled by the application.
+ *
+ * @param pcm BlueALSA PCM handle.
+ * @param pfd Address where the poll descriptor will be stored.
+ * @return This function returns 0. */
+int bluealsa_pcm_poll_descriptor(
+		const struct bluealsa_pcm *pcm,
+		struct pollfd *pfd) {
+	pfd->fd = pcm->fd;
+	pfd->events = pcm->info.playback ? POLLOUT : POLLIN;
+	pfd->revents = 0;
+	return 0;
+}
+
+static int bluealsa_pcm_process_playback(struct bluealsa_pcm *pcm) {
+
+	const size_t frame_size = pcm->info.frame_size;
+	int frames = 0;
+	int rv = 0;
+
+	/* Writing to a FIFO without a reader raises SIGPIPE. Block it for the
+	 * time of the transfer, so the application will not be killed when the
+	 * server closes the PCM, and consume it in case it was raised by us. */
+	sigset_t sigset, oldset;
+	sigemptyset(&sigset);
+	sigaddset(&sigset, SIGPIPE);
+	pthread_sigmask(SIG_BLOCK, &sigset, &oldset);
+
+	for (;;) {
+
+		if (pcm->buffer_len == 0) {
+			size_t n = pcm->callback(pcm, pcm->buffer, pcm->info.period_frames, pcm->userdata);
+			if (n == 0)
+				break;
+			pcm->buffer_offset = 0;
+			pcm->buffer_len = MIN(n, pcm->info.period_frames) * frame_size;
+		}
+
+		ssize_t ret;
+		if ((ret = write(pcm->fd, pcm->buffer + pcm->buffer_offset, pcm->buffer_len)) == -1) {
+			if (errno == EINTR)
+				continue;
+			if (errno == EAGAIN)
+				break;
+			if ((rv = -errno) == -EPIPE) {
+				if (!sigismember(&oldset, SIGPIPE)) {
+					const struct timespec ts = { 0 };
+					sigtimedwait(&sigset, NULL, &ts);
+				}
+				rv = -ENODEV;
+			}
+			break;
+		}
+
+		pcm->buffer_offset += ret;
+		pcm->buffer_len -= ret;
+		if (pcm->buffer_len == 0)
+			frames += pcm->buffer_offset / frame_size;
+
+	}
+
+	pthread_sigmask(SIG_SETMASK, &oldset, NULL);
+	return rv == 0 ? frames : rv;
+}
+
+static int bluealsa_pcm_process_capture(struct bluealsa_pcm *pcm) {
+
+	int frames = 0;
+
+	for (;;) {
+
+		ssize_t ret;
+		if ((ret = read(pcm->fd, pcm->buffer + pcm->buffer_len,
+						pcm->buffer_size - pcm->buffer_len)) == -1) {
+			if (errno == EINTR)
+				continue;
+			if (errno == EAGAIN)
+				break;
+			return -errno;
+		}
+
+		/* the server has closed the PCM */
+		if (ret == 0)
+			return -ENODEV;
+
+		if ((pcm->buffer_len += ret) == pcm->buffer_size) {
+			pcm->callback(pcm, pcm->buffer, pcm->info.period_frames, pcm->userdata);
+			frames += pcm->info.period_frames;
+			pcm->buffer_len = 0;
+		}
+
+	}
+
+	return frames;
+}
+
+/**
+ * Transfer as many periods as possible without blocking.
+ *
+ * The PCM IO callback is called from this function only, i.e. in the context
+ * of the application thread.
+ *
+ * @param pcm BlueALSA PCM handle.
+ * @return On success this function returns the number of transferred frames.
+ *   Otherwise, negative error code is returned. The -ENODEV error indicates
+ *   that the PCM was closed by the server. */
+int bluealsa_pcm_process(
+		struct bluealsa_pcm *pcm) {
+	if (pcm->info.playback)
+		return bluealsa_pcm_process_playback(pcm);
+	return bluealsa_pcm_process_capture(pcm);
+}
+
+/**
+ * Get overall PCM delay.
+ *
+ * The delay consists of frames buffered by this library, frames queued in
+ * the FIFO and the server delay, which includes encoding or decoding and
+ * the Bluetooth transfer. In case when the server does not provide the PCM
+ * status page, the server delay is the one reported when the PCM was opened.
+ *
+ * @param pcm BlueALSA PCM handle.
+ * @param frames Address where the delay in frames will be stored.
+ * @return On success this function returns 0. Otherwise, negative error code
+ *   is returned. */
+int bluealsa_pcm_get_delay(
+		struct bluealsa_pcm *pcm,
+		long *frames) {
+
+	const size_t frame_size = pcm->info.frame_size;
+	uint32_t ba_delay = pcm->ba_pcm.delay;
+	uint64_t ba_frames;
+	struct timespec ba_timestamp;
+	int nread = 0;
+
+	if (ioctl(pcm->fd, FIONREAD, &nread) == -1)
+		return -errno;
+
+	if (pcm->status != NULL)
+		ba_pcm_status_read(pcm->status, &ba_delay, &ba_frames, &ba_timestamp);
+
+	long delay = (nread + pcm->buffer_len) / frame_size;
+	delay += (pcm->info.rate / 100) * ba_delay / 100;
+
+	*frames = delay;
+	return 0;
+}
+
+/**
+ * Pause or resume BlueALSA PCM. */
+int bluealsa_pcm_pause(
+		struct bluealsa_pcm *pcm,
+		bool enable) {
+	dbus_bool_t ok = enable ?
+		ba_dbus_pcm_ctrl_send_pause(pcm->ctrl_fd, NULL) :
+		ba_dbus_pcm_ctrl_send_resume(pcm->ctrl_fd, NULL);
+	return ok ? 0 : -errno;
+}
+
+/**
+ * Wait until the server has played all queued frames.
+ *
+ * Frames buffered by this library which were not written to the FIFO yet
+ * are not drained, so the application shall call bluealsa_pcm_process()
+ * until its callback has no more data before calling this function. */
+int bluealsa_pcm_drain(
+		struct bluealsa_pcm *pcm) {
+	if (!ba_dbus_pcm_ctrl_send_drain(pcm->ctrl_fd, NULL))
+		return -errno;
+	return 0;
+}
+
+/**
+ * Drop all queued frames. */
+int bluealsa_pcm_drop(
+		struct bluealsa_pcm *pcm) {
+	pcm->buffer_offset = 0;
+	pcm->buffer_len = 0;
+	if (!ba_dbus_pcm_ctrl_send_drop(pcm->ctrl_fd, NULL))
+		return -errno;
+	return 0;
+}
@@ -0,0 +1,107 @@
+/*
+ * BlueALSA - bluealsa.h
+ * Copyright (c) 2016-2024 Arkadiusz Bokowy
+ *
+ * This file is a part of bluez-alsa.
+ *
+ * This project is licensed under the terms of the MIT license.
+ *
+ */
+
+#pragma once
+#ifndef BLUEALSA_CLIENT_BLUEALSA_H_
+#define BLUEALSA_CLIENT_BLUEALSA_H_
+
+#include <poll.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Decode 16-bit BlueALSA PCM format identifier. */
+#define BLUEALSA_PCM_FORMAT_SIGN(format)   (((format) >> 15) & 0x1)
+#define BLUEALSA_PCM_FORMAT_WIDTH(format)  ((format) & 0xFF)
+#define BLUEALSA_PCM_FORMAT_BYTES(format)  (((format) >> 8) & 0x3F)
+#define BLUEALSA_PCM_FORMAT_ENDIAN(format) (((format) >> 14) & 0x1)
+
+/**
+ * Opaque BlueALSA PCM handle. */
+struct bluealsa_pcm;
+
+/**
+ * BlueALSA PCM stream parameters. */
+struct bluealsa_pcm_info {
+	/* true for playback (sink) PCM, false for capture (source) PCM */
+	bool playback;
+	/* 16-bit BlueALSA PCM format identifier */
+	unsigned int format;
+	/* number of audio channels */
+	unsigned int channels;
+	/* sampling frequency */
+	unsigned int rate;
+	/* size of a single frame in bytes */
+	size_t frame_size;
+	/* number of frames transferred in a single callback */
+	size_t period_frames;
+};
+
+/**
+ * PCM IO callback.
+ *
+ * For a playback PCM this callback shall fill the buffer with up to the given
+ * number of frames and return the number of frames written. Returning 0 means
+ * that the application has no data at the moment.
+ *
+ * For a capture PCM the buffer contains exactly the given number of frames
+ * read from the server. The return value is ignored.
+ *
+ * @param pcm BlueALSA PCM handle.
+ * @param buffer PCM data buffer.
+ * @param frames Number of frames in the buffer.
+ * @param userdata Data passed to the bluealsa_pcm_open() function.
+ * @return Number of processed frames. */
+typedef size_t (*bluealsa_pcm_io_cb)(struct bluealsa_pcm *pcm,
+		void *buffer, size_t frames, void *userdata);
+
+struct bluealsa_pcm *bluealsa_pcm_open(
+		const char *service,
+		const char *pcm_path,
+		size_t period_frames,
+		bluealsa_pcm_io_cb callback,
+		void *userdata);
+
+void bluealsa_pcm_close(
+		struct bluealsa_pcm *pcm);
+
+const struct bluealsa_pcm_info *bluealsa_pcm_get_info(
+		const struct bluealsa_pcm *pcm);
+
+int bluealsa_pcm_poll_descriptor(
+		const struct bluealsa_pcm *pcm,
+		struct pollfd *pfd);
+
+int bluealsa_pcm_process(
+		struct bluealsa_pcm *pcm);
+
+int bluealsa_pcm_get_delay(
+		struct bluealsa_pcm *pcm,
+		long *frames);
+
+int bluealsa_pcm_pause(
+		struct bluealsa_pcm *pcm,
+		bool enable);
+
+int bluealsa_pcm_drain(
+		struct bluealsa_pcm *pcm);
+
+int bluealsa_pcm_drop(
+		struct bluealsa_pcm *pcm);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -202,6 +202,8 @@ ssize_t io_pcm_read(
 		debug("PCM client closed connection: %d", fd);
 		ba_transport_pcm_release(pcm);
 	}
+	else if (ret > 0)
+		ba_transport_pcm_status_update(pcm, ret / sample_size);
 
 	pthread_mutex_unlock(&pcm->mutex);
 
@@ -261,6 +263,8 @@ ssize_t io_pcm_write(
 	/* It is guaranteed, that this function will write data atomically. */
 	ret = samples;
 
+	ba_transport_pcm_status_update(pcm, samples);
+
 final:
 	pthread_mutex_unlock(&pcm->mutex);
 	return ret;
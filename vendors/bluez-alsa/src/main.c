@@ -163,6 +163,7 @@ int main(int argc, char **argv) {
 		{ "keep-alive", required_argument, NULL, 8 },
 		{ "io-rt-priority", required_argument, NULL, 3 },
 		{ "disable-realtek-usb-fix", no_argument, NULL, 21 },
+		{ "dbus-update-interval", required_argument, NULL, 24 },
 		{ "a2dp-force-mono", no_argument, NULL, 6 },
 		{ "a2dp-force-audio-cd", no_argument, NULL, 7 },
 		{ "a2dp-volume", no_argument, NULL, 9 },
@@ -217,6 +218,7 @@ int main(int argc, char **argv) {
 					"  --keep-alive=SEC\t\tkeep Bluetooth transport alive\n"
 					"  --io-rt-priority=NUM\t\treal-time priority for IO threads\n"
 					"  --disable-realtek-usb-fix\tdisable fix for mSBC on Realtek USB\n"
+					"  --dbus-update-interval=MSEC\tcoalesce D-Bus property updates\n"
 					"  --a2dp-force-mono\t\ttry to force monophonic sound\n"
 					"  --a2dp-force-audio-cd\t\ttry to force 44.1 kHz sampling\n"
 					"  --a2dp-volume\t\t\tnative volume control by default\n"
@@ -437,6 +439,16 @@ int main(int argc, char **argv) {
 			config.disable_realtek_usb_fix = true;
 			break;
 
+		case 24 /* --dbus-update-interval=MSEC */ : {
+			const int interval = atoi(optarg);
+			if (interval < 0 || interval > 10000) {
+				error("Invalid D-Bus update interval [0, 10000]: %s", optarg);
+				return EXIT_FAILURE;
+			}
+			config.dbus_pcm_update_interval = interval;
+			break;
+		}
+
 		case 6 /* --a2dp-force-mono */ :
 			config.a2dp.force_mono = true;
 			break;
@@ -566,6 +566,66 @@ dbus_bool_t ba_dbus_pcm_ctrl_send(
 	return TRUE;
 }
 
+/**
+ * Get the PCM status page file descriptor from the PCM controller socket.
+ *
+ * The returned file descriptor refers to the memory which can be mapped
+ * read-only as the struct ba_pcm_status, see shared/pcm-status.h header. */
+dbus_bool_t ba_dbus_pcm_ctrl_status(
+		int fd_pcm_ctrl,
+		int *fd_status,
+		DBusError *error) {
+
+	const char *command = "Status";
+	if (send(fd_pcm_ctrl, command, strlen(command), MSG_NOSIGNAL) == -1) {
+		dbus_set_error(error, DBUS_ERROR_FAILED, "Send: %s", strerror(errno));
+		return FALSE;
+	}
+
+	struct pollfd pfd = { fd_pcm_ctrl, POLLIN, 0 };
+	int res;
+	while ((res = poll(&pfd, 1, 200)) == -1 && errno == EINTR)
+		continue;
+
+	if (res == 0) {
+		errno = EIO;
+		dbus_set_error(error, DBUS_ERROR_IO_ERROR, "Read: %s", strerror(errno));
+		return FALSE;
+	}
+
+	char rep[32];
+	char buf[CMSG_SPACE(sizeof(int))];
+	struct iovec io = { .iov_base = rep, .iov_len = sizeof(rep) };
+	struct msghdr msg = {
+		.msg_iov = &io,
+		.msg_iovlen = 1,
+		.msg_control = buf,
+		.msg_controllen = sizeof(buf) };
+
+	ssize_t len;
+	if ((len = recvmsg(fd_pcm_ctrl, &msg, MSG_CMSG_CLOEXEC)) == -1) {
+		dbus_set_error(error, DBUS_ERROR_FAILED, "Read: %s", strerror(errno));
+		return FALSE;
+	}
+
+	int fd = -1;
+	struct cmsghdr *cmsg;
+	for (cmsg = CMSG_FIRSTHDR(&msg); cmsg != NULL; cmsg = CMSG_NXTHDR(&msg, cmsg))
+		if (cmsg->cmsg_level == SOL_SOCKET && cmsg->cmsg_type == SCM_RIGHTS)
+			memcpy(&fd, CMSG_DATA(cmsg), sizeof(fd));
+
+	if (strncmp(rep, "OK", len) != 0 || fd == -1) {
+		dbus_set_error(error, DBUS_ERROR_NOT_SUPPORTED, "Response: %.*s", (int)len, rep);
+		if (fd != -1)
+			close(fd);
+		errno = ENOMSG;
+		return FALSE;
+	}
+
+	*fd_status = fd;
+	return TRUE;
+}
+
 /**
  * Parse BlueALSA PCM. */
 dbus_bool_t dbus_message_iter_get_ba_pcm(
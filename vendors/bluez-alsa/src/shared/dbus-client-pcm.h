@@ -229,6 +229,11 @@ dbus_bool_t ba_dbus_pcm_ctrl_send(
 #define ba_dbus_pcm_ctrl_send_resume(fd, err) \
 	ba_dbus_pcm_ctrl_send(fd, "Resume", 200, err)
 
+dbus_bool_t ba_dbus_pcm_ctrl_status(
+		int fd_pcm_ctrl,
+		int *fd_status,
+		DBusError *error);
+
 dbus_bool_t dbus_message_iter_get_ba_pcm(
 		DBusMessageIter *iter,
 		DBusError *error,
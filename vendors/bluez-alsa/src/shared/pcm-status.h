@@ -0,0 +1,88 @@
+/*
+ * BlueALSA - pcm-status.h
+ * Copyright (c) 2016-2024 Arkadiusz Bokowy
+ *
+ * This file is a part of bluez-alsa.
+ *
+ * This project is licensed under the terms of the MIT license.
+ *
+ */
+
+#pragma once
+#ifndef BLUEALSA_SHARED_PCMSTATUS_H_
+#define BLUEALSA_SHARED_PCMSTATUS_H_
+
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <time.h>
+
+/**
+ * PCM status page shared between the BlueALSA service and a PCM client.
+ *
+ * The page is written by the PCM IO thread only, and it is read by the client
+ * without any locking. Consistency of the snapshot is guaranteed by the
+ * sequence counter, which is odd while the update is in progress. Only the
+ * counter is atomic, because atomic types which are not lock-free do not
+ * work across process boundaries. Other fields are plain, and they shall be
+ * accessed with the ba_pcm_status_update() and ba_pcm_status_read() only. */
+struct ba_pcm_status {
+	/* update sequence counter */
+	_Atomic uint32_t seq;
+	/* overall PCM delay in 1/10 of millisecond */
+	uint32_t delay;
+	/* number of PCM frames transferred since the PCM was opened */
+	uint64_t frames;
+	/* time of the last update, see gettimestamp() */
+	struct timespec timestamp;
+};
+
+#if ATOMIC_INT_LOCK_FREE != 2
+# error "PCM status page requires lock-free 32-bit atomic operations"
+#endif
+
+/**
+ * Update PCM status page.
+ *
+ * @param status Address of the PCM status page.
+ * @param delay PCM delay in 1/10 of millisecond.
+ * @param frames Number of PCM frames transferred so far.
+ * @param timestamp Time of the update. */
+static inline void ba_pcm_status_update(struct ba_pcm_status *status,
+		uint32_t delay, uint64_t frames, const struct timespec *timestamp) {
+	const uint32_t seq = atomic_load_explicit(&status->seq, memory_order_relaxed);
+	atomic_store_explicit(&status->seq, seq + 1, memory_order_relaxed);
+	atomic_thread_fence(memory_order_release);
+	*(volatile uint32_t *)&status->delay = delay;
+	*(volatile uint64_t *)&status->frames = frames;
+	*(volatile time_t *)&status->timestamp.tv_sec = timestamp->tv_sec;
+	*(volatile long *)&status->timestamp.tv_nsec = timestamp->tv_nsec;
+	atomic_store_explicit(&status->seq, seq + 2, memory_order_release);
+}
+
+/**
+ * Read consistent snapshot of the PCM status page.
+ *
+ * @param status Address of the PCM status page.
+ * @param delay Address where the PCM delay will be stored.
+ * @param frames Address where the number of frames will be stored.
+ * @param timestamp Address where the time of the update will be stored.
+ * @return This function returns true if the page was updated at least once,
+ *   otherwise false is returned and output values shall not be used. */
+static inline bool ba_pcm_status_read(const struct ba_pcm_status *status,
+		uint32_t *delay, uint64_t *frames, struct timespec *timestamp) {
+	struct ba_pcm_status *s = (struct ba_pcm_status *)status;
+	uint32_t seq;
+	do {
+		while ((seq = atomic_load_explicit(&s->seq, memory_order_acquire)) & 1)
+			continue;
+		*delay = *(const volatile uint32_t *)&s->delay;
+		*frames = *(const volatile uint64_t *)&s->frames;
+		timestamp->tv_sec = *(const volatile time_t *)&s->timestamp.tv_sec;
+		timestamp->tv_nsec = *(const volatile long *)&s->timestamp.tv_nsec;
+		atomic_thread_fence(memory_order_acquire);
+	} while (atomic_load_explicit(&s->seq, memory_order_relaxed) != seq);
+	return seq != 0;
+}
+
+#endif
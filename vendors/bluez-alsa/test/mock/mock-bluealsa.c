@@ -219,6 +219,12 @@ static struct ba_transport *mock_transport_new_a2dp(struct ba_device *d,
 	return t;
 }
 
+/* Update A2DP delay the same way as BlueZ transport property change does. */
+static void mock_transport_set_a2dp_delay(struct ba_transport *t, uint16_t delay) {
+	t->a2dp.delay = delay;
+	bluealsa_dbus_pcm_update(&t->a2dp.pcm, BA_DBUS_PCM_UPDATE_DELAY);
+}
+
 /* SCO acquisition override for testing purposes. */
 int transport_acquire_bt_sco(struct ba_transport *t) {
 
@@ -314,10 +320,25 @@ void mock_bluealsa_run(void) {
 
 	if (config.profile.a2dp_source) {
 
-		if (a2dp_sbc_source.enabled)
-			g_ptr_array_add(tt, mock_transport_new_a2dp(ba_device_1, BT_UUID_A2DP_SOURCE,
+		if (a2dp_sbc_source.enabled) {
+
+			struct ba_transport *t;
+			g_ptr_array_add(tt, t = mock_transport_new_a2dp(ba_device_1, BT_UUID_A2DP_SOURCE,
 						&a2dp_sbc_source, &config_sbc_44100_stereo));
 
+			/* Mock delay reports from the BT device: a change, a jitter
+			 * below the D-Bus update hysteresis, and two changes in quick
+			 * succession. */
+
+			if (mock_delay_reports) {
+				const uint16_t delays[] = { 300, 305, 400, 500 };
+				usleep(mock_fuzzing_ms * 1000);
+				for (size_t i = 0; i < ARRAYSIZE(delays); i++)
+					mock_transport_set_a2dp_delay(t, delays[i]);
+			}
+
+		}
+
 #if ENABLE_APTX
 		if (a2dp_aptx_source.enabled)
 			g_ptr_array_add(tt, mock_transport_new_a2dp(ba_device_2, BT_UUID_A2DP_SOURCE,
@@ -397,6 +418,29 @@ void mock_bluealsa_run(void) {
 	if (config.profile.hsp_hs)
 		g_ptr_array_add(tt, mock_transport_new_sco(ba_device_2, BT_UUID_HSP_HS));
 
+	/* Connect additional devices, each with A2DP and HFP profiles
+	 * (depending on enabled profiles), in order to mock a crowd. */
+	GPtrArray *dd = g_ptr_array_new_with_free_func((GDestroyNotify)ba_device_unref);
+	for (size_t i = 0; i < mock_extra_devices; i++) {
+
+		char address[18];
+		sprintf(address, "AA:BB:CC:DD:EE:%02zX", i);
+
+		struct ba_device *d;
+		g_ptr_array_add(dd, d = mock_device_new(ba_adapter, address));
+		mock_bluez_device_add(d->bluez_dbus_path, MOCK_BLUEZ_ADAPTER_PATH, address);
+
+		if (config.profile.a2dp_source && a2dp_sbc_source.enabled)
+			g_ptr_array_add(tt, mock_transport_new_a2dp(d, BT_UUID_A2DP_SOURCE,
+						&a2dp_sbc_source, &config_sbc_44100_stereo));
+		if (config.profile.a2dp_sink && a2dp_sbc_sink.enabled)
+			g_ptr_array_add(tt, mock_transport_new_a2dp(d, BT_UUID_A2DP_SINK,
+						&a2dp_sbc_sink, &config_sbc_44100_stereo));
+		if (config.profile.hfp_ag)
+			g_ptr_array_add(tt, mock_transport_new_sco(d, BT_UUID_HFP_AG));
+
+	}
+
 #if ENABLE_UPOWER
 	mock_upower_display_device_set_percentage(50.00);
 	mock_upower_display_device_set_is_present(false);
@@ -417,6 +461,7 @@ void mock_bluealsa_run(void) {
 	usleep(mock_fuzzing_ms * 1000);
 
 	g_ptr_array_free(tt, TRUE);
+	g_ptr_array_free(dd, TRUE);
 
 }
 
@@ -140,7 +140,7 @@ static void mock_bluez_adapter_add(const char *adapter_path, const char *address
 
 }
 
-static void mock_bluez_device_add(const char *device_path, const char *adapter_path,
+void mock_bluez_device_add(const char *device_path, const char *adapter_path,
 		const char *address) {
 
 	g_autoptr(MockBluezDevice1) device = mock_bluez_device1_skeleton_new();
@@ -50,6 +50,8 @@ GAsyncQueue *mock_sem_timeout = NULL;
 char mock_ba_service_name[32] = BLUEALSA_SERVICE;
 bool mock_dump_output = false;
 int mock_fuzzing_ms = 0;
+unsigned int mock_extra_devices = 0;
+bool mock_delay_reports = false;
 
 static const char *dbus_address = NULL;
 GDBusConnection *mock_dbus_connection_new_sync(GError **error) {
@@ -124,6 +126,9 @@ int main(int argc, char *argv[]) {
 		{ "device-name", required_argument, NULL, 2 },
 		{ "dump-output", no_argument, NULL, 6 },
 		{ "fuzzing", required_argument, NULL, 7 },
+		{ "extra-devices", required_argument, NULL, 8 },
+		{ "delay-reports", no_argument, NULL, 9 },
+		{ "dbus-update-interval", required_argument, NULL, 10 },
 		{ 0, 0, 0, 0 },
 	};
 
@@ -142,7 +147,10 @@ int main(int argc, char *argv[]) {
 					"  -t, --timeout=MSEC\t\tmock server exit timeout\n"
 					"  --device-name=MAC:NAME\tmock BT device name\n"
 					"  --dump-output\t\t\tdump Bluetooth transport data\n"
-					"  --fuzzing=MSEC\t\tmock human actions with timings\n",
+					"  --fuzzing=MSEC\t\tmock human actions with timings\n"
+					"  --extra-devices=NUM\t\tconnect additional BT devices\n"
+					"  --delay-reports\t\tmock A2DP delay reports\n"
+					"  --dbus-update-interval=MSEC\tcoalesce D-Bus property updates\n",
 					argv[0]);
 			return EXIT_SUCCESS;
 		case 'B' /* --dbus=NAME */ :
@@ -212,6 +220,15 @@ int main(int argc, char *argv[]) {
 		case 7 /* --fuzzing=MSEC */ :
 			mock_fuzzing_ms = atoi(optarg);
 			break;
+		case 8 /* --extra-devices=NUM */ :
+			mock_extra_devices = MIN(atoi(optarg), 255);
+			break;
+		case 9 /* --delay-reports */ :
+			mock_delay_reports = true;
+			break;
+		case 10 /* --dbus-update-interval=MSEC */ :
+			config.dbus_pcm_update_interval = atoi(optarg);
+			break;
 		default:
 			fprintf(stderr, "Try '%s --help' for more information.\n", argv[0]);
 			return EXIT_FAILURE;
@@ -36,6 +36,8 @@ extern GAsyncQueue *mock_sem_timeout;
 extern char mock_ba_service_name[32];
 extern bool mock_dump_output;
 extern int mock_fuzzing_ms;
+extern unsigned int mock_extra_devices;
+extern bool mock_delay_reports;
 
 GDBusConnection *mock_dbus_connection_new_sync(GError **error);
 
@@ -44,6 +46,8 @@ void mock_bluealsa_service_start(void);
 void mock_bluealsa_service_stop(void);
 
 int mock_bluez_device_name_mapping_add(const char *mapping);
+void mock_bluez_device_add(const char *device_path, const char *adapter_path,
+		const char *address);
 int mock_bluez_device_profile_new_connection(const char *device_path,
 		const char *uuid, GAsyncQueue *sem_ready);
 int mock_bluez_device_media_set_configuration(const char *device_path,
@@ -18,11 +18,13 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <time.h>
 
 #include <check.h>
 #include <alsa/asoundlib.h>
 
 #include "shared/log.h"
+#include "shared/rt.h"
 
 #include "inc/check.inc"
 #include "inc/mock.inc"
@@ -534,23 +536,20 @@ CK_START_TEST(test_notifications) {
 #endif
 
 	/* Processed events:
-	 * - 0 removes; 2 new elems (12:34:... A2DP)
-	 * - 2 removes; 4 new elems (12:34:... A2DP, 23:45:... A2DP)
-	 * - 4 removes; 7 new elems (2x A2DP, SCO playback, battery)
-	 * - 7 removes; 9 new elems (2x A2DP, SCO playback/capture, battery)
+	 * - 2 new elems (12:34:... A2DP)
+	 * - 2 new elems (23:45:... A2DP)
+	 * - 3 new elems (SCO playback, battery)
+	 * - 2 new elems (SCO capture)
 	 * - 4 updates per codec (SCO codec updates if codec selection is supported)
 	 */
-	size_t expected_events = (0 + 2) + (2 + 4) + (4 + 7) + (7 + 9) + events_update_codec;
+	size_t expected_events = 2 + 2 + 3 + 2 + events_update_codec;
 
 	/* XXX: It is possible that the battery element (RFCOMM D-Bus path) will not
 	 *      be exported in time. In such case, the number of events will be less
-	 *      by 2 when RFCOMM D-Bus path is not available during the playback SCO
-	 *      addition and less by another 1 when the path is not available during
-	 *      the capture SCO addition. We shall account for this in the test, as
-	 *      it is not an error. */
+	 *      by 1, because the battery element is bound to the SCO playback PCM.
+	 *      We shall account for this in the test, as it is not an error. */
 	int result = events == expected_events ||
-					events == expected_events - 2 ||
-					events == expected_events - 3;
+					events == expected_events - 1;
 	ck_assert_int_eq(result, 1);
 
 	snd_ctl_event_free(event);
@@ -576,6 +575,91 @@ CK_START_TEST(test_alsa_high_level_control_interface) {
 
 } CK_END_TEST
 
+CK_START_TEST(test_benchmark_many_devices) {
+
+	struct spawn_process sp_ba_mock;
+	struct timespec t0, t, diff;
+	snd_ctl_t *ctl = NULL;
+
+	/* Mock 50 devices in total: 2 built-in devices with 6 PCMs
+	 * and 48 extra devices with 4 PCMs (A2DP and HFP) each. */
+	ck_assert_int_ne(spawn_bluealsa_mock(&sp_ba_mock, NULL, true,
+				"--timeout=30000",
+				"--profile=a2dp-source",
+				"--profile=a2dp-sink",
+				"--profile=hfp-ag",
+				"--extra-devices=48",
+				NULL), -1);
+
+	gettimestamp(&t0);
+	ck_assert_int_eq(snd_ctl_open(&ctl, "bluealsa", 0), 0);
+	gettimestamp(&t);
+	difftimespec(&t0, &t, &diff);
+	debug("Open: %ld us", diff.tv_sec * 1000000 + diff.tv_nsec / 1000);
+
+	snd_ctl_elem_list_t *elems;
+	snd_ctl_elem_list_alloca(&elems);
+
+	ck_assert_int_eq(snd_ctl_elem_list(ctl, elems), 0);
+	const unsigned int count = snd_ctl_elem_list_get_count(elems);
+	/* volume and switch elements for every PCM */
+	ck_assert_uint_eq(count, (6 + 48 * 4) * 2);
+	ck_assert_int_eq(snd_ctl_elem_list_alloc_space(elems, count), 0);
+	ck_assert_int_eq(snd_ctl_elem_list(ctl, elems), 0);
+
+	snd_ctl_elem_info_t *info;
+	snd_ctl_elem_info_alloca(&info);
+
+	/* look up every element by its name and index */
+	gettimestamp(&t0);
+	for (unsigned int i = 0; i < count; i++) {
+		snd_ctl_elem_info_clear(info);
+		snd_ctl_elem_info_set_interface(info, SND_CTL_ELEM_IFACE_MIXER);
+		snd_ctl_elem_info_set_name(info, snd_ctl_elem_list_get_name(elems, i));
+		snd_ctl_elem_info_set_index(info, snd_ctl_elem_list_get_index(elems, i));
+		ck_assert_int_eq(snd_ctl_elem_info(ctl, info), 0);
+	}
+	gettimestamp(&t);
+	difftimespec(&t0, &t, &diff);
+	debug("Lookup %u elements by name: %ld us", count,
+			diff.tv_sec * 1000000 + diff.tv_nsec / 1000);
+
+	snd_ctl_event_t *event;
+	snd_ctl_event_malloc(&event);
+
+	ck_assert_int_eq(snd_ctl_subscribe_events(ctl, 1), 0);
+
+	/* Terminate the mock, so all PCMs will be removed one by one. Every
+	 * removal shall be announced without re-adding all other elements. */
+	gettimestamp(&t0);
+	spawn_terminate(&sp_ba_mock, 0);
+
+	size_t events = 0;
+	int elements = count;
+	while (elements > 0 && snd_ctl_wait(ctl, 1000) == 1)
+		while (snd_ctl_read(ctl, event) == 1) {
+			if (snd_ctl_event_elem_get_mask(event) == SND_CTL_EVENT_MASK_ADD)
+				elements++;
+			if (snd_ctl_event_elem_get_mask(event) == SND_CTL_EVENT_MASK_REMOVE)
+				elements--;
+			events++;
+		}
+
+	gettimestamp(&t);
+	difftimespec(&t0, &t, &diff);
+	debug("Remove %u elements: %zu events: %ld us", count, events,
+			diff.tv_sec * 1000000 + diff.tv_nsec / 1000);
+
+	ck_assert_int_eq(elements, 0);
+	/* at most one remove and add event pair per moved element */
+	ck_assert_uint_le(events, 3 * count);
+
+	snd_ctl_elem_list_free_space(elems);
+	snd_ctl_event_free(event);
+	ck_assert_int_eq(test_pcm_close(&sp_ba_mock, ctl), 0);
+
+} CK_END_TEST
+
 int main(int argc, char *argv[]) {
 	preload(argc, argv, ".libs/libaloader.so");
 
@@ -607,6 +691,12 @@ int main(int argc, char *argv[]) {
 	tcase_add_test(tc, test_notifications);
 	tcase_add_test(tc, test_alsa_high_level_control_interface);
 
+	/* Connecting a crowd of mock devices takes a while. */
+	TCase *tc_benchmark = tcase_create("benchmark");
+	suite_add_tcase(s, tc_benchmark);
+	tcase_set_timeout(tc_benchmark, 30);
+	tcase_add_test(tc_benchmark, test_benchmark_many_devices);
+
 	srunner_run_all(sr, CK_ENV);
 	int nf = srunner_ntests_failed(sr);
 
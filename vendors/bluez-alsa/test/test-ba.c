@@ -14,6 +14,7 @@
 
 #include <assert.h>
 #include <errno.h>
+#include <poll.h>
 #include <pthread.h>
 #include <stdbool.h>
 #include <stddef.h>
@@ -21,7 +22,9 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/socket.h>
 #include <sys/stat.h>
+#include <unistd.h>
 
 #include <bluetooth/bluetooth.h>
 #include <bluetooth/hci.h>
@@ -356,6 +359,172 @@ CK_START_TEST(test_ba_transport_pcm_volume) {
 
 } CK_END_TEST
 
+#if HAVE_MEMFD_CREATE
+CK_START_TEST(test_ba_transport_pcm_status) {
+
+	struct ba_adapter *a;
+	struct ba_device *d;
+	struct ba_transport *t;
+	bdaddr_t addr = { 0 };
+
+	ck_assert_ptr_ne(a = ba_adapter_new(0), NULL);
+	ck_assert_ptr_ne(d = ba_device_new(a, &addr), NULL);
+
+	struct a2dp_sep sep = { .type = A2DP_SINK, .codec_id = A2DP_CODEC_SBC };
+	a2dp_sbc_t configuration = {
+		.sampling_freq = SBC_SAMPLING_FREQ_48000,
+		.channel_mode = SBC_CHANNEL_MODE_STEREO };
+	ck_assert_ptr_ne(t = ba_transport_new_a2dp(d,
+				BA_TRANSPORT_PROFILE_A2DP_SINK, "/owner", "/path/a2dp", &sep,
+				&configuration), NULL);
+
+	ba_adapter_unref(a);
+	ba_device_unref(d);
+
+	struct ba_transport_pcm *pcm = &t->a2dp.pcm;
+	ck_assert_int_eq(pcm->channels, 2);
+	ck_assert_ptr_eq(pcm->status, NULL);
+
+	uint32_t delay;
+	uint64_t frames;
+	struct timespec timestamp;
+
+	pthread_mutex_lock(&pcm->mutex);
+	ck_assert_int_eq(ba_transport_pcm_status_open(pcm), 0);
+	pthread_mutex_unlock(&pcm->mutex);
+
+	ck_assert_ptr_ne(pcm->status, NULL);
+	ck_assert_int_ne(pcm->status_fd, -1);
+	ck_assert_int_eq(ba_pcm_status_read(pcm->status, &delay, &frames, &timestamp), true);
+	ck_assert_int_eq(delay, ba_transport_pcm_get_delay(pcm));
+	ck_assert_int_eq(frames, 0);
+
+	pthread_mutex_lock(&pcm->mutex);
+	pcm->delay += 100;
+	ba_transport_pcm_status_update(pcm, 256);
+	ba_transport_pcm_status_update(pcm, 256);
+	pthread_mutex_unlock(&pcm->mutex);
+
+	ck_assert_int_eq(ba_pcm_status_read(pcm->status, &delay, &frames, &timestamp), true);
+	ck_assert_int_eq(delay, ba_transport_pcm_get_delay(pcm));
+	ck_assert_int_eq(frames, 256);
+	ck_assert_int_gt(timestamp.tv_sec + timestamp.tv_nsec, 0);
+
+	/* re-opening PCM shall reuse the page and reset the counter */
+	const int status_fd = pcm->status_fd;
+	pthread_mutex_lock(&pcm->mutex);
+	pcm->delay -= 100;
+	ck_assert_int_eq(ba_transport_pcm_status_open(pcm), 0);
+	pthread_mutex_unlock(&pcm->mutex);
+
+	ck_assert_int_eq(pcm->status_fd, status_fd);
+	ck_assert_int_eq(ba_pcm_status_read(pcm->status, &delay, &frames, &timestamp), true);
+	ck_assert_int_eq(delay, ba_transport_pcm_get_delay(pcm));
+	ck_assert_int_eq(frames, 0);
+
+	ba_transport_unref(t);
+
+} CK_END_TEST
+#endif
+
+/**
+ * Send PCM controller command and check the reply. */
+static bool pcm_controller_command(int fd, const char *command, const char *reply) {
+
+	struct pollfd pfd = { fd, POLLIN, 0 };
+	char buffer[32];
+	ssize_t len;
+
+	if (send(fd, command, strlen(command), 0) == -1 ||
+			poll(&pfd, 1, 1000) != 1 ||
+			(len = recv(fd, buffer, sizeof(buffer), 0)) == -1)
+		return false;
+
+	return (size_t)len == strlen(reply) && memcmp(buffer, reply, len) == 0;
+}
+
+/**
+ * Wait until the transport reference count drops to the given value. */
+static bool transport_wait_ref_count(struct ba_transport *t, int count) {
+	for (size_t i = 0; i < 100; i++) {
+		pthread_mutex_lock(&t->d->transports_mutex);
+		const int ref_count = t->ref_count;
+		pthread_mutex_unlock(&t->d->transports_mutex);
+		if (ref_count == count)
+			return true;
+		usleep(10000);
+	}
+	return false;
+}
+
+CK_START_TEST(test_ba_transport_pcm_controller) {
+
+	struct ba_adapter *a;
+	struct ba_device *d;
+	struct ba_transport *t;
+	bdaddr_t addr = { 0 };
+
+	ck_assert_ptr_ne(a = ba_adapter_new(0), NULL);
+	ck_assert_ptr_ne(d = ba_device_new(a, &addr), NULL);
+
+	struct a2dp_sep sep = { .type = A2DP_SINK, .codec_id = A2DP_CODEC_SBC };
+	a2dp_sbc_t configuration = {
+		.sampling_freq = SBC_SAMPLING_FREQ_48000,
+		.channel_mode = SBC_CHANNEL_MODE_STEREO };
+	ck_assert_ptr_ne(t = ba_transport_new_a2dp(d,
+				BA_TRANSPORT_PROFILE_A2DP_SINK, "/owner", "/path/a2dp", &sep,
+				&configuration), NULL);
+
+	ba_adapter_unref(a);
+	ba_device_unref(d);
+
+	struct ba_transport_pcm *pcm = &t->a2dp.pcm;
+	int fds[2];
+
+	ck_assert_int_eq(socketpair(AF_UNIX, SOCK_SEQPACKET | SOCK_NONBLOCK, 0, fds), 0);
+	pthread_mutex_lock(&pcm->mutex);
+	ck_assert_int_eq(ba_transport_pcm_controller_start(pcm, fds[0]), 0);
+	pcm->controller_fd = fds[0];
+	pthread_mutex_unlock(&pcm->mutex);
+
+	/* the controller thread holds a transport reference */
+	ck_assert_int_eq(t->ref_count, 2);
+
+	ck_assert_int_eq(pcm_controller_command(fds[1], "Pause", "OK"), true);
+	ck_assert_int_eq(pcm->paused, true);
+	ck_assert_int_eq(pcm_controller_command(fds[1], "Resume", "OK"), true);
+	ck_assert_int_eq(pcm->paused, false);
+	ck_assert_int_eq(pcm_controller_command(fds[1], "Status", "NotSupported"), true);
+	ck_assert_int_eq(pcm_controller_command(fds[1], "Foo", "Invalid"), true);
+
+	/* Releasing PCM shall shut the socket down and terminate the thread
+	 * blocked in poll(), which shall not release the PCM once more. */
+	pthread_mutex_lock(&pcm->mutex);
+	ba_transport_pcm_release(pcm);
+	pthread_mutex_unlock(&pcm->mutex);
+
+	char buffer[32];
+	struct pollfd pfd = { fds[1], POLLIN, 0 };
+	ck_assert_int_eq(poll(&pfd, 1, 1000), 1);
+	ck_assert_int_eq(recv(fds[1], buffer, sizeof(buffer), 0), 0);
+	ck_assert_int_eq(transport_wait_ref_count(t, 1), true);
+	close(fds[1]);
+
+	/* closing the socket by the client shall release the PCM */
+	ck_assert_int_eq(socketpair(AF_UNIX, SOCK_SEQPACKET | SOCK_NONBLOCK, 0, fds), 0);
+	pthread_mutex_lock(&pcm->mutex);
+	ck_assert_int_eq(ba_transport_pcm_controller_start(pcm, fds[0]), 0);
+	pcm->controller_fd = fds[0];
+	pthread_mutex_unlock(&pcm->mutex);
+
+	close(fds[1]);
+	ck_assert_int_eq(transport_wait_ref_count(t, 1), true);
+	ck_assert_int_eq(pcm->controller_fd, -1);
+
+	ba_transport_unref(t);
+
+} CK_END_TEST
+
 static int test_cascade_free_transport_unref(struct ba_transport *t) {
 	return ba_transport_unref(t), 0;
 }
@@ -488,6 +657,10 @@ int main(void) {
 	tcase_add_test(tc, test_ba_transport_threads_sync_termination);
 	tcase_add_test(tc, test_ba_transport_pcm_format);
 	tcase_add_test(tc, test_ba_transport_pcm_volume);
+#if HAVE_MEMFD_CREATE
+	tcase_add_test(tc, test_ba_transport_pcm_status);
+#endif
+	tcase_add_test(tc, test_ba_transport_pcm_controller);
 	tcase_add_test(tc, test_cascade_free);
 	tcase_add_test(tc, test_storage);
 
@@ -0,0 +1,221 @@
+/*
+ * test-libbluealsa.c
+ * Copyright (c) 2016-2024 Arkadiusz Bokowy
+ *
+ * This file is a part of bluez-alsa.
+ *
+ * This project is licensed under the terms of the MIT license.
+ *
+ */
+
+#if HAVE_CONFIG_H
+# include <config.h>
+#endif
+
+#include <errno.h>
+#include <libgen.h>
+#include <poll.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include <check.h>
+
+#include "client/bluealsa.h"
+#include "shared/rt.h"
+
+#include "inc/check.inc"
+#include "inc/mock.inc"
+#include "inc/spawn.inc"
+
+struct test_io_data {
+	size_t callbacks;
+	size_t frames;
+};
+
+static size_t test_io_callback(struct bluealsa_pcm *pcm,
+		void *buffer, size_t frames, void *userdata) {
+	const struct bluealsa_pcm_info *info = bluealsa_pcm_get_info(pcm);
+	struct test_io_data *data = userdata;
+	if (info->playback)
+		memset(buffer, 0, frames * info->frame_size);
+	data->callbacks++;
+	data->frames += frames;
+	return frames;
+}
+
+/**
+ * Run PCM IO loop for the given time in milliseconds. */
+static int test_io_run(struct bluealsa_pcm *pcm, int duration) {
+
+	struct timespec ts0, ts;
+	gettimestamp(&ts0);
+
+	int rv = 0;
+	for (;;) {
+
+		gettimestamp(&ts);
+		int elapsed = (ts.tv_sec - ts0.tv_sec) * 1000 + (ts.tv_nsec - ts0.tv_nsec) / 1000000;
+		if (elapsed >= duration)
+			break;
+
+		struct pollfd pfd;
+		bluealsa_pcm_poll_descriptor(pcm, &pfd);
+		if (poll(&pfd, 1, duration - elapsed) <= 0)
+			continue;
+
+		if ((rv = bluealsa_pcm_process(pcm)) < 0)
+			break;
+
+	}
+
+	return rv;
+}
+
+CK_START_TEST(test_open_invalid) {
+
+	struct spawn_process sp_ba_mock;
+	ck_assert_int_ne(spawn_bluealsa_mock(&sp_ba_mock, NULL, true,
+				"--profile=a2dp-source",
+				NULL), -1);
+
+	struct test_io_data data = { 0 };
+	ck_assert_ptr_eq(bluealsa_pcm_open(NULL,
+				"/org/bluealsa/hci11/dev_FF_FF_FF_FF_FF_FF/a2dpsrc/sink", 256,
+				test_io_callback, &data), NULL);
+	ck_assert_int_eq(errno, ENODEV);
+
+	ck_assert_ptr_eq(bluealsa_pcm_open(NULL,
+				"/org/bluealsa/hci11/dev_12_34_56_78_9A_BC/a2dpsrc/sink", 0,
+				test_io_callback, &data), NULL);
+	ck_assert_int_eq(errno, EINVAL);
+
+	spawn_terminate(&sp_ba_mock, 0);
+	spawn_close(&sp_ba_mock, NULL);
+
+} CK_END_TEST
+
+CK_START_TEST(test_playback) {
+
+	struct spawn_process sp_ba_mock;
+	ck_assert_int_ne(spawn_bluealsa_mock(&sp_ba_mock, NULL, true,
+				"--profile=a2dp-source",
+				NULL), -1);
+
+	struct test_io_data data = { 0 };
+	struct bluealsa_pcm *pcm;
+	ck_assert_ptr_ne(pcm = bluealsa_pcm_open(NULL,
+				"/org/bluealsa/hci11/dev_12_34_56_78_9A_BC/a2dpsrc/sink", 256,
+				test_io_callback, &data), NULL);
+
+	const struct bluealsa_pcm_info *info = bluealsa_pcm_get_info(pcm);
+	ck_assert_int_eq(info->playback, true);
+	ck_assert_int_eq(info->channels, 2);
+	ck_assert_int_eq(info->frame_size, 4);
+	ck_assert_int_eq(info->period_frames, 256);
+
+	ck_assert_int_ge(test_io_run(pcm, 250), 0);
+	ck_assert_uint_gt(data.callbacks, 0);
+	ck_assert_uint_eq(data.frames, data.callbacks * 256);
+
+	/* the FIFO shall be filled up, so there has to be some delay */
+	long delay = 0;
+	ck_assert_int_eq(bluealsa_pcm_get_delay(pcm, &delay), 0);
+	ck_assert_int_gt(delay, 0);
+
+	ck_assert_int_eq(bluealsa_pcm_pause(pcm, true), 0);
+	ck_assert_int_eq(bluealsa_pcm_pause(pcm, false), 0);
+	ck_assert_int_eq(bluealsa_pcm_drop(pcm), 0);
+
+	bluealsa_pcm_close(pcm);
+
+	spawn_terminate(&sp_ba_mock, 0);
+	spawn_close(&sp_ba_mock, NULL);
+
+} CK_END_TEST
+
+CK_START_TEST(test_capture) {
+
+	struct spawn_process sp_ba_mock;
+	ck_assert_int_ne(spawn_bluealsa_mock(&sp_ba_mock, NULL, true,
+				"--profile=a2dp-sink",
+				NULL), -1);
+
+	struct test_io_data data = { 0 };
+	struct bluealsa_pcm *pcm;
+	ck_assert_ptr_ne(pcm = bluealsa_pcm_open(NULL,
+				"/org/bluealsa/hci11/dev_12_34_56_78_9A_BC/a2dpsnk/source", 128,
+				test_io_callback, &data), NULL);
+
+	ck_assert_int_eq(bluealsa_pcm_get_info(pcm)->playback, false);
+
+	ck_assert_int_ge(test_io_run(pcm, 250), 0);
+	ck_assert_uint_gt(data.callbacks, 0);
+	ck_assert_uint_eq(data.frames, data.callbacks * 128);
+
+	long delay = 0;
+	ck_assert_int_eq(bluealsa_pcm_get_delay(pcm, &delay), 0);
+	ck_assert_int_ge(delay, 0);
+
+	bluealsa_pcm_close(pcm);
+
+	spawn_terminate(&sp_ba_mock, 0);
+	spawn_close(&sp_ba_mock, NULL);
+
+} CK_END_TEST
+
+CK_START_TEST(test_server_closed) {
+
+	struct spawn_process sp_ba_mock;
+	ck_assert_int_ne(spawn_bluealsa_mock(&sp_ba_mock, NULL, true,
+				"--profile=a2dp-source",
+				NULL), -1);
+
+	struct test_io_data data = { 0 };
+	struct bluealsa_pcm *pcm;
+	ck_assert_ptr_ne(pcm = bluealsa_pcm_open(NULL,
+				"/org/bluealsa/hci11/dev_12_34_56_78_9A_BC/a2dpsrc/sink", 256,
+				test_io_callback, &data), NULL);
+
+	ck_assert_int_ge(test_io_run(pcm, 100), 0);
+
+	spawn_terminate(&sp_ba_mock, 0);
+	spawn_close(&sp_ba_mock, NULL);
+
+	/* the application shall not be killed with SIGPIPE */
+	ck_assert_int_eq(test_io_run(pcm, 500), -ENODEV);
+
+	bluealsa_pcm_close(pcm);
+
+} CK_END_TEST
+
+int main(int argc, char *argv[]) {
+	(void)argc;
+
+	char *argv_0 = strdup(argv[0]);
+	char *argv_0_dir = dirname(argv_0);
+
+	snprintf(bluealsa_mock_path, sizeof(bluealsa_mock_path),
+			"%s/mock/bluealsa-mock", argv_0_dir);
+
+	Suite *s = suite_create(__FILE__);
+	TCase *tc = tcase_create(__FILE__);
+	SRunner *sr = srunner_create(s);
+
+	suite_add_tcase(s, tc);
+
+	tcase_add_test(tc, test_open_invalid);
+	tcase_add_test(tc, test_playback);
+	tcase_add_test(tc, test_capture);
+	tcase_add_test(tc, test_server_closed);
+
+	srunner_run_all(sr, CK_ENV);
+	int nf = srunner_ntests_failed(sr);
+
+	srunner_free(sr);
+	free(argv_0);
+
+	return nf == 0 ? 0 : 1;
+}
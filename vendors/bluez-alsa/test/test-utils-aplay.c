@@ -226,6 +226,73 @@ CK_START_TEST(test_play_single_audio) {
 
 } CK_END_TEST
 
+CK_START_TEST(test_play_standby) {
+
+	struct spawn_process sp_ba_mock;
+	ck_assert_int_ne(spawn_bluealsa_mock(&sp_ba_mock, NULL, true,
+				"--profile=a2dp-sink",
+				NULL), -1);
+
+	struct spawn_process sp_ba_aplay;
+	ck_assert_int_ne(spawn_bluealsa_aplay(&sp_ba_aplay,
+				"--pcm-standby",
+				"--profile-a2dp",
+				"--pcm=null",
+				"-v", "-v",
+				NULL), -1);
+	spawn_terminate(&sp_ba_aplay, 500);
+
+	char output[8192] = "";
+	ck_assert_int_gt(spawn_read(&sp_ba_aplay, NULL, 0, output, sizeof(output)), 0);
+
+	ck_assert_ptr_ne(strstr(output,
+				"Used configuration for 12:34:56:78:9A:BC"), NULL);
+	/* check if the first samples were played with pre-opened PCM */
+	ck_assert_ptr_ne(strstr(output,
+				"Time to first sample for 12:34:56:78:9A:BC"), NULL);
+	ck_assert_ptr_ne(strstr(output,
+				"(ALSA PCM ready: 0 ms"), NULL);
+
+	spawn_close(&sp_ba_aplay, NULL);
+	spawn_terminate(&sp_ba_mock, 0);
+	spawn_close(&sp_ba_mock, NULL);
+
+} CK_END_TEST
+
+CK_START_TEST(test_play_mix) {
+
+	struct spawn_process sp_ba_mock;
+	ck_assert_int_ne(spawn_bluealsa_mock(&sp_ba_mock, NULL, true,
+				"--profile=a2dp-sink",
+				NULL), -1);
+
+	struct spawn_process sp_ba_aplay;
+	ck_assert_int_ne(spawn_bluealsa_aplay(&sp_ba_aplay,
+				"--mix",
+				"--profile-a2dp",
+				"--pcm=null",
+				"--pcm-period-time=20000",
+				"-v", "-v",
+				NULL), -1);
+	spawn_terminate(&sp_ba_aplay, 500);
+
+	char output[8192] = "";
+	ck_assert_int_gt(spawn_read(&sp_ba_aplay, NULL, 0, output, sizeof(output)), 0);
+
+	/* check if both devices were mixed into one PCM */
+	ck_assert_ptr_ne(strstr(output,
+				"Used configuration for 12:34:56:78:9A:BC"), NULL);
+	ck_assert_ptr_ne(strstr(output,
+				"Used configuration for 23:45:67:89:AB:CD"), NULL);
+	ck_assert_ptr_ne(strstr(output,
+				"Used configuration for mixer"), NULL);
+
+	spawn_close(&sp_ba_aplay, NULL);
+	spawn_terminate(&sp_ba_mock, 0);
+	spawn_close(&sp_ba_mock, NULL);
+
+} CK_END_TEST
+
 CK_START_TEST(test_play_mixer_setup) {
 
 	struct spawn_process sp_ba_mock;
@@ -330,6 +397,8 @@ int main(int argc, char *argv[]) {
 	tcase_add_test(tc, test_list_pcms);
 	tcase_add_test(tc, test_play_all);
 	tcase_add_test(tc, test_play_single_audio);
+	tcase_add_test(tc, test_play_standby);
+	tcase_add_test(tc, test_play_mix);
 	tcase_add_test(tc, test_play_mixer_setup);
 	tcase_add_test(tc, test_play_dbus_signals);
 
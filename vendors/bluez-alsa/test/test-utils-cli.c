@@ -415,6 +415,125 @@ CK_START_TEST(test_monitor) {
 
 } CK_END_TEST
 
+CK_START_TEST(test_monitor_json) {
+
+	struct spawn_process sp_ba_mock;
+	ck_assert_int_ne(spawn_bluealsa_mock(&sp_ba_mock, NULL, false,
+				"--timeout=0",
+				"--fuzzing=200",
+				"--delay-reports",
+				"--profile=a2dp-source",
+				"--profile=hfp-ag",
+				NULL), -1);
+
+	char output[4096];
+
+	/* check invalid interval */
+	ck_assert_int_eq(run_bluealsa_cli(output, sizeof(output),
+				"monitor", "--interval=-1", NULL), EXIT_FAILURE);
+
+	/* check monitor command with coalesced JSON output */
+	ck_assert_int_eq(run_bluealsa_cli(output, sizeof(output),
+				"monitor", "--json", "--interval=100", "--properties",
+				NULL), 0);
+
+	ck_assert_ptr_ne(strstr(output,
+				"{\"event\":\"ServiceRunning\",\"service\":\"org.bluealsa\"}"), NULL);
+	ck_assert_ptr_ne(strstr(output,
+				"{\"event\":\"PCMAdded\",\"path\":\"/org/bluealsa/hci11/dev_23_45_67_89_AB_CD/a2dpsrc/sink\"}"), NULL);
+	ck_assert_ptr_ne(strstr(output,
+				"{\"event\":\"PCMRemoved\",\"path\":\"/org/bluealsa/hci11/dev_23_45_67_89_AB_CD/a2dpsrc/sink\"}"), NULL);
+
+	/* Mocked delay reports are sent in a quick succession, so they shall be
+	 * merged into a single record (or two, if they were split by the end of
+	 * the interval) instead of four separate ones. */
+	size_t delays = 0;
+	const char *tmp = output;
+	while ((tmp = strstr(tmp,
+					"\"path\":\"/org/bluealsa/hci11/dev_12_34_56_78_9A_BC/a2dpsrc/sink\"")) != NULL) {
+		const char *eol = strchr(tmp, '\n');
+		const char *delay = strstr(tmp, "\"Delay\":");
+		if (delay != NULL && (eol == NULL || delay < eol))
+			delays++;
+		tmp++;
+	}
+	ck_assert_uint_ge(delays, 1);
+	ck_assert_uint_le(delays, 2);
+
+#if ENABLE_MSBC
+	ck_assert_ptr_ne(strstr(output,
+				"{\"event\":\"PropertiesChanged\",\"path\":\"/org/bluealsa/hci11/dev_12_34_56_78_9A_BC/hfpag/sink\",\"Codec\":\"CVSD\""), NULL);
+#endif
+
+	spawn_terminate(&sp_ba_mock, 0);
+	spawn_close(&sp_ba_mock, NULL);
+
+} CK_END_TEST
+
+/**
+ * Get values of the Delay property reported by the monitor command. */
+static size_t get_monitor_delays(const char *output, const char *path,
+		unsigned int *delays, size_t size) {
+
+	char prefix[256];
+	snprintf(prefix, sizeof(prefix), "PropertyChanged %s Delay ", path);
+
+	size_t n = 0;
+	const char *tmp = output;
+	while (n < size && (tmp = strstr(tmp, prefix)) != NULL) {
+		tmp += strlen(prefix);
+		delays[n++] = strtoul(tmp, NULL, 10);
+	}
+
+	return n;
+}
+
+CK_START_TEST(test_monitor_delay) {
+
+	const char *path = "/org/bluealsa/hci11/dev_12_34_56_78_9A_BC/a2dpsrc/sink";
+	struct spawn_process sp_ba_mock;
+	unsigned int delays[16];
+	char output[4096];
+	size_t n;
+
+	/* Mocked delay reports are: +300, +305, +400 and +500 (in 1/10 ms) on
+	 * top of the codec delay. Without the update interval, all of them
+	 * shall be reported as they are. */
+	ck_assert_int_ne(spawn_bluealsa_mock(&sp_ba_mock, NULL, false,
+				"--timeout=0",
+				"--fuzzing=200",
+				"--delay-reports",
+				"--profile=a2dp-source",
+				NULL), -1);
+	ck_assert_int_eq(run_bluealsa_cli(output, sizeof(output),
+				"monitor", "--properties=delay", NULL), 0);
+	spawn_terminate(&sp_ba_mock, 0);
+	spawn_close(&sp_ba_mock, NULL);
+
+	ck_assert_uint_ge(n = get_monitor_delays(output, path, delays, 16), 4);
+	ck_assert_uint_eq(delays[n - 3] - delays[n - 4], 5);
+	ck_assert_uint_eq(delays[n - 2] - delays[n - 4], 100);
+	ck_assert_uint_eq(delays[n - 1] - delays[n - 4], 200);
+
+	/* With the update interval, the jitter shall be suppressed by the
+	 * hysteresis and the last two changes shall be merged into one. */
+	ck_assert_int_ne(spawn_bluealsa_mock(&sp_ba_mock, NULL, false,
+				"--timeout=0",
+				"--fuzzing=200",
+				"--delay-reports",
+				"--dbus-update-interval=50",
+				"--profile=a2dp-source",
+				NULL), -1);
+	ck_assert_int_eq(run_bluealsa_cli(output, sizeof(output),
+				"monitor", "--properties=delay", NULL), 0);
+	spawn_terminate(&sp_ba_mock, 0);
+	spawn_close(&sp_ba_mock, NULL);
+
+	ck_assert_uint_ge(n = get_monitor_delays(output, path, delays, 16), 2);
+	ck_assert_uint_eq(delays[n - 1] - delays[n - 2], 200);
+
+} CK_END_TEST
+
 CK_START_TEST(test_open) {
 
 	struct spawn_process sp_ba_mock;
@@ -461,6 +580,56 @@ CK_START_TEST(test_open) {
 
 } CK_END_TEST
 
+CK_START_TEST(test_open_splice) {
+
+	struct spawn_process sp_ba_mock;
+	ck_assert_int_ne(spawn_bluealsa_mock(&sp_ba_mock, NULL, true,
+				"--profile=hsp-ag",
+				NULL), -1);
+
+	char * ba_cli_in_argv[32] = {
+		bluealsa_cli_path, "open", "--splice",
+		"/org/bluealsa/hci11/dev_23_45_67_89_AB_CD/hspag/source",
+		NULL };
+	char * ba_cli_out_argv[32] = {
+		bluealsa_cli_path, "open", "--splice",
+		"/org/bluealsa/hci11/dev_23_45_67_89_AB_CD/hspag/sink",
+		NULL };
+
+	struct spawn_process sp_ba_cli_in;
+	ck_assert_int_ne(spawn(&sp_ba_cli_in, ba_cli_in_argv,
+				NULL, SPAWN_FLAG_REDIRECT_STDOUT), -1);
+
+	struct spawn_process sp_ba_cli_out;
+	ck_assert_int_ne(spawn(&sp_ba_cli_out, ba_cli_out_argv,
+				sp_ba_cli_in.f_stdout, SPAWN_FLAG_REDIRECT_STDERR), -1);
+
+	/* let it run for a while */
+	usleep(250000);
+
+	spawn_terminate(&sp_ba_cli_in, 0);
+	spawn_terminate(&sp_ba_cli_out, 500);
+
+	char output[4096];
+	ck_assert_int_gt(spawn_read(&sp_ba_cli_out, NULL, 0, output, sizeof(output)), 0);
+
+	/* check whether data were transferred in the splice mode */
+	ck_assert_ptr_ne(strstr(output, "Transferred: "), NULL);
+	ck_assert_ptr_ne(strstr(output, "Transfers: "), NULL);
+
+	int wstatus = 0;
+	/* the same as in the copy mode, see test_open() */
+	spawn_close(&sp_ba_cli_in, &wstatus);
+	ck_assert_int_eq(WTERMSIG(wstatus), SIGTERM);
+	spawn_close(&sp_ba_cli_out, &wstatus);
+	ck_assert_int_eq(WIFEXITED(wstatus), 1);
+	ck_assert_int_eq(WEXITSTATUS(wstatus), 0);
+
+	spawn_terminate(&sp_ba_mock, 0);
+	spawn_close(&sp_ba_mock, NULL);
+
+} CK_END_TEST
+
 int main(int argc, char *argv[]) {
 	preload(argc, argv, ".libs/libaloader.so");
 
@@ -488,7 +657,10 @@ int main(int argc, char *argv[]) {
 	tcase_add_test(tc, test_delay_adjustment);
 	tcase_add_test(tc, test_volume);
 	tcase_add_test(tc, test_monitor);
+	tcase_add_test(tc, test_monitor_json);
+	tcase_add_test(tc, test_monitor_delay);
 	tcase_add_test(tc, test_open);
+	tcase_add_test(tc, test_open_splice);
 
 	srunner_run_all(sr, CK_ENV);
 	int nf = srunner_ntests_failed(sr);
@@ -14,10 +14,10 @@
 #include <stdlib.h>
 #include <string.h>
 
-static int alsa_pcm_set_hw_params(snd_pcm_t *pcm, snd_pcm_format_t format, int channels,
-		int rate, unsigned int *buffer_time, unsigned int *period_time, char **msg) {
+static int alsa_pcm_set_hw_params(snd_pcm_t *pcm, snd_pcm_access_t *access,
+		snd_pcm_format_t format, int channels, int rate, unsigned int *buffer_time,
+		unsigned int *period_time, char **msg) {
 
-	const snd_pcm_access_t access = SND_PCM_ACCESS_RW_INTERLEAVED;
 	snd_pcm_hw_params_t *params;
 	char buf[256];
 	int dir;
@@ -30,8 +30,15 @@ static int alsa_pcm_set_hw_params(snd_pcm_t *pcm, snd_pcm_format_t format, int c
 		goto fail;
 	}
 
-	if ((err = snd_pcm_hw_params_set_access(pcm, params, access)) != 0) {
-		snprintf(buf, sizeof(buf), "Set assess type: %s: %s", snd_strerror(err), snd_pcm_access_name(access));
+	if ((err = snd_pcm_hw_params_set_access(pcm, params, *access)) != 0 &&
+			*access == SND_PCM_ACCESS_MMAP_INTERLEAVED) {
+		/* not all PCM plugins support mmap, fall back to read/write access */
+		*access = SND_PCM_ACCESS_RW_INTERLEAVED;
+		err = snd_pcm_hw_params_set_access(pcm, params, *access);
+	}
+
+	if (err != 0) {
+		snprintf(buf, sizeof(buf), "Set assess type: %s: %s", snd_strerror(err), snd_pcm_access_name(*access));
 		goto fail;
 	}
 
@@ -115,7 +122,13 @@ fail:
 	return err;
 }
 
-int alsa_pcm_open(snd_pcm_t **pcm, const char *name,
+/**
+ * Open ALSA playback PCM.
+ *
+ * @param access The requested access type. In case when the mmap access
+ *   is not supported by the PCM, the read/write access is used instead,
+ *   and this parameter is updated accordingly. */
+int alsa_pcm_open(snd_pcm_t **pcm, const char *name, snd_pcm_access_t *access,
 		snd_pcm_format_t format, int channels, int rate,
 		unsigned int *buffer_time, unsigned int *period_time,
 		char **msg) {
@@ -130,7 +143,8 @@ int alsa_pcm_open(snd_pcm_t **pcm, const char *name,
 		goto fail;
 	}
 
-	if ((err = alsa_pcm_set_hw_params(_pcm, format, channels, rate, buffer_time, period_time, &tmp)) != 0) {
+	if ((err = alsa_pcm_set_hw_params(_pcm, access, format, channels, rate,
+					buffer_time, period_time, &tmp)) != 0) {
 		snprintf(buf, sizeof(buf), "Set HW params: %s", tmp);
 		goto fail;
 	}
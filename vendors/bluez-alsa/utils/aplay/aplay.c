@@ -39,9 +39,11 @@
 #include "shared/ffb.h"
 #include "shared/log.h"
 #include "shared/nv.h"
+#include "shared/rt.h"
 #include "alsa-mixer.h"
 #include "alsa-pcm.h"
 #include "dbus.h"
+#include "mix.h"
 
 enum volume_type {
 	VOL_TYPE_AUTO,
@@ -60,11 +62,14 @@ struct io_worker {
 	int ba_pcm_ctrl_fd;
 	/* opened playback PCM device */
 	snd_pcm_t *snd_pcm;
+	snd_pcm_access_t snd_pcm_access;
 	/* mixer for volume control */
 	snd_mixer_t *snd_mixer;
 	snd_mixer_elem_t *snd_mixer_elem;
 	long mixer_volume_db_max_value;
 	bool mixer_has_mute_switch;
+	/* source of the software mixer */
+	struct mix_source *mix_src;
 	/* if true, playback is active */
 	atomic_bool active;
 	/* human-readable BT address */
@@ -85,6 +90,7 @@ static bdaddr_t *ba_addrs = NULL;
 static size_t ba_addrs_count = 0;
 static unsigned int pcm_buffer_time = 500000;
 static unsigned int pcm_period_time = 100000;
+static bool pcm_standby = false;
 
 /* local PCM muted state for software mute */
 static bool pcm_muted = false;
@@ -98,6 +104,23 @@ static size_t ba_pcms_count = 0;
 static pthread_mutex_t single_playback_mutex = PTHREAD_MUTEX_INITIALIZER;
 static bool force_single_playback = false;
 
+/* software mixer used by all workers */
+static struct mix *mix = NULL;
+static bool mix_playback = false;
+
+/* prepared playback PCM kept in the warm-standby mode */
+struct standby_pcm {
+	snd_pcm_t *pcm;
+	snd_pcm_access_t access;
+	snd_pcm_format_t format;
+	unsigned int channels;
+	unsigned int rate;
+};
+
+static pthread_mutex_t standby_pcms_mutex = PTHREAD_MUTEX_INITIALIZER;
+static struct standby_pcm standby_pcms[4];
+static size_t standby_pcms_count = 0;
+
 static pthread_rwlock_t workers_lock = PTHREAD_RWLOCK_INITIALIZER;
 static struct io_worker *workers = NULL;
 static size_t workers_count = 0;
@@ -141,6 +164,90 @@ static const char *bluealsa_get_profile(const struct ba_pcm *pcm) {
 	}
 }
 
+/**
+ * Take prepared playback PCM with given hardware parameters from the
+ * warm-standby cache.
+ *
+ * @return On success this function returns the PCM. If there is no such
+ *   PCM in the cache, NULL is returned. */
+static snd_pcm_t *standby_pcm_get(snd_pcm_format_t format, unsigned int channels,
+		unsigned int rate, snd_pcm_access_t *access) {
+
+	snd_pcm_t *pcm = NULL;
+	size_t i;
+
+	pthread_mutex_lock(&standby_pcms_mutex);
+
+	for (i = 0; i < standby_pcms_count; i++)
+		if (standby_pcms[i].format == format &&
+				standby_pcms[i].channels == channels &&
+				standby_pcms[i].rate == rate) {
+			pcm = standby_pcms[i].pcm;
+			*access = standby_pcms[i].access;
+			memmove(&standby_pcms[i], &standby_pcms[i + 1],
+					sizeof(*standby_pcms) * (--standby_pcms_count - i));
+			break;
+		}
+
+	pthread_mutex_unlock(&standby_pcms_mutex);
+
+	return pcm;
+}
+
+/**
+ * Put playback PCM into the warm-standby cache.
+ *
+ * The PCM is stopped and prepared, so it will be ready for the next stream.
+ * If the cache is full, the least recently used PCM is closed. */
+static void standby_pcm_put(snd_pcm_t *pcm, snd_pcm_access_t access,
+		snd_pcm_format_t format, unsigned int channels, unsigned int rate) {
+
+	int err;
+	if ((err = snd_pcm_drop(pcm)) != 0 ||
+			(err = snd_pcm_prepare(pcm)) != 0) {
+		warn("Couldn't prepare ALSA playback PCM for standby: %s", snd_strerror(err));
+		snd_pcm_close(pcm);
+		return;
+	}
+
+	debug("Keeping ALSA playback PCM in standby: channels=%u rate=%u", channels, rate);
+
+	pthread_mutex_lock(&standby_pcms_mutex);
+
+	if (standby_pcms_count == ARRAYSIZE(standby_pcms)) {
+		snd_pcm_close(standby_pcms[0].pcm);
+		memmove(&standby_pcms[0], &standby_pcms[1],
+				sizeof(*standby_pcms) * --standby_pcms_count);
+	}
+
+	struct standby_pcm *entry = &standby_pcms[standby_pcms_count++];
+	entry->pcm = pcm;
+	entry->access = access;
+	entry->format = format;
+	entry->channels = channels;
+	entry->rate = rate;
+
+	pthread_mutex_unlock(&standby_pcms_mutex);
+
+}
+
+/**
+ * Close all playback PCMs in the warm-standby cache.
+ *
+ * @return This function returns the number of closed PCMs. */
+static size_t standby_pcm_flush(void) {
+
+	pthread_mutex_lock(&standby_pcms_mutex);
+
+	size_t count = standby_pcms_count;
+	while (standby_pcms_count > 0)
+		snd_pcm_close(standby_pcms[--standby_pcms_count].pcm);
+
+	pthread_mutex_unlock(&standby_pcms_mutex);
+
+	return count;
+}
+
 static snd_pcm_format_t bluealsa_get_snd_pcm_format(const struct ba_pcm *pcm) {
 	switch (pcm->format) {
 	case 0x0108:
@@ -487,6 +594,41 @@ static int io_worker_mixer_volume_sync_snd_mixer_elem(
 	return 0;
 }
 
+/**
+ * Update software mixer source gain according to BlueALSA PCM volume. */
+static void io_worker_mix_src_sync_gain(
+		struct io_worker *worker,
+		const struct ba_pcm *ba_pcm) {
+
+	if (worker->mix_src == NULL)
+		return;
+
+	bool softvol = ba_pcm->soft_volume;
+	if (volume_type != VOL_TYPE_AUTO)
+		softvol = volume_type == VOL_TYPE_SOFTWARE;
+
+	/* With software volume the audio is already scaled by the server. When
+	 * the volume control is disabled, the audio shall be passed as is. */
+	if (softvol || volume_type == VOL_TYPE_NONE) {
+		mix_source_set_gain(worker->mix_src, 1.0);
+		return;
+	}
+
+	const int vmax = BA_PCM_VOLUME_MAX(ba_pcm);
+	int volume = ba_pcm->volume.ch1_volume;
+	int muted = ba_pcm->volume.ch1_muted;
+
+	if (ba_pcm->channels > 1) {
+		volume = (ba_pcm->volume.ch1_volume + ba_pcm->volume.ch2_volume) / 2;
+		muted = ba_pcm->volume.ch1_muted || ba_pcm->volume.ch2_muted;
+	}
+
+	/* convert loudness to dB and dB to the amplitude gain */
+	double db = 10 * log2(1.0 * volume / vmax);
+	mix_source_set_gain(worker->mix_src, muted ? 0 : pow(10, db / 20));
+
+}
+
 static int io_worker_mixer_elem_callback(snd_mixer_elem_t *elem, unsigned int mask) {
 	struct io_worker *worker = snd_mixer_elem_get_callback_private(elem);
 	if (mask & SND_CTL_EVENT_MASK_VALUE)
@@ -518,6 +660,190 @@ static int io_worker_mixer_volume_sync_setup(
 	return 0;
 }
 
+/**
+ * Get writable part of the ALSA playback PCM mmap area.
+ *
+ * This function waits for the free space in the PCM buffer, so it blocks
+ * the same way as the snd_pcm_writei() does.
+ *
+ * @param pcm The ALSA playback PCM opened with the interleaved mmap access.
+ * @param frames_max The maximum number of frames to get.
+ * @param ptr The address of the pointer to the first writable frame.
+ * @param offset The address where the mmap area offset will be stored.
+ * @param frames The address where the number of contiguous frames which
+ *   can be written will be stored.
+ * @return On success this function returns 0. Otherwise, a negative ALSA
+ *   error code is returned. */
+static int io_worker_mmap_begin(snd_pcm_t *pcm, snd_pcm_uframes_t frames_max,
+		void **ptr, snd_pcm_uframes_t *offset, snd_pcm_uframes_t *frames) {
+
+	const snd_pcm_channel_area_t *areas;
+	snd_pcm_sframes_t avail;
+	int err = 0;
+
+	while ((avail = snd_pcm_avail_update(pcm)) <= 0) {
+		/* A full buffer of a PCM which was not started would never drain,
+		 * e.g. when the start threshold was not reached before the xrun. */
+		if (avail == 0 && snd_pcm_state(pcm) == SND_PCM_STATE_PREPARED)
+			err = snd_pcm_start(pcm);
+		else if (avail == 0)
+			err = snd_pcm_wait(pcm, -1);
+		if (avail < 0 || err < 0) {
+			if ((err = snd_pcm_recover(pcm, avail < 0 ? avail : err, 1)) != 0)
+				return err;
+			debug("ALSA playback PCM underrun");
+		}
+	}
+
+	*frames = MIN((snd_pcm_uframes_t)avail, frames_max);
+	if ((err = snd_pcm_mmap_begin(pcm, &areas, offset, frames)) != 0)
+		return err;
+
+	/* with the interleaved access all channels share the same area */
+	*ptr = (uint8_t *)areas[0].addr + (areas[0].first + *offset * areas[0].step) / 8;
+	return 0;
+}
+
+/**
+ * Commit frames written to the ALSA playback PCM mmap area.
+ *
+ * Unlike the snd_pcm_mmap_writei(), the mmap commit does not start the
+ * PCM automatically, so it is started here once the number of queued
+ * frames reaches the start threshold.
+ *
+ * @param pcm The ALSA playback PCM opened with the interleaved mmap access.
+ * @param offset The mmap area offset returned by the io_worker_mmap_begin().
+ * @param frames The number of frames to commit.
+ * @return On success this function returns 0. Otherwise, a negative ALSA
+ *   error code is returned. */
+static int io_worker_mmap_commit(snd_pcm_t *pcm, snd_pcm_uframes_t offset,
+		snd_pcm_uframes_t frames) {
+
+	snd_pcm_sw_params_t *params;
+	snd_pcm_uframes_t buffer_size, period_size, threshold;
+	snd_pcm_sframes_t ret;
+	int err;
+
+	if ((ret = snd_pcm_mmap_commit(pcm, offset, frames)) < 0) {
+		if ((err = snd_pcm_recover(pcm, ret, 1)) != 0)
+			return err;
+		debug("ALSA playback PCM underrun");
+		/* recovered PCM is empty, there is nothing to start */
+		return 0;
+	}
+
+	if (snd_pcm_state(pcm) != SND_PCM_STATE_PREPARED)
+		return 0;
+
+	snd_pcm_sw_params_alloca(&params);
+	if ((err = snd_pcm_sw_params_current(pcm, params)) != 0 ||
+			(err = snd_pcm_sw_params_get_start_threshold(params, &threshold)) != 0)
+		return err;
+
+	if ((err = snd_pcm_get_params(pcm, &buffer_size, &period_size)) != 0)
+		return err;
+	if ((ret = snd_pcm_avail_update(pcm)) < 0)
+		return ret;
+
+	/* start when the number of queued frames reached the threshold */
+	if (buffer_size - (snd_pcm_uframes_t)ret >= threshold)
+		return snd_pcm_start(pcm);
+
+	return 0;
+}
+
+/**
+ * Open ALSA playback PCM and mixer for the worker.
+ *
+ * In the warm-standby mode, a prepared PCM is taken from the cache if
+ * there is one with matching hardware parameters.
+ *
+ * @param worker The IO worker.
+ * @param format The PCM format of the BlueALSA source PCM.
+ * @param cached The address where the information whether the PCM was
+ *   taken from the cache will be stored.
+ * @return On success this function returns 0. Otherwise, -1 is returned. */
+static int io_worker_pcm_open(
+		struct io_worker *worker,
+		snd_pcm_format_t format,
+		bool *cached) {
+
+	unsigned int buffer_time = pcm_buffer_time;
+	unsigned int period_time = pcm_period_time;
+	snd_pcm_access_t access = SND_PCM_ACCESS_MMAP_INTERLEAVED;
+	snd_pcm_uframes_t buffer_frames;
+	snd_pcm_uframes_t period_frames;
+	char *tmp;
+
+	*cached = false;
+	if (pcm_standby && (worker->snd_pcm = standby_pcm_get(format,
+					worker->ba_pcm.channels, worker->ba_pcm.sampling, &access)) != NULL)
+		*cached = true;
+
+	if (!*cached) {
+
+		debug("Opening ALSA playback PCM: name=%s channels=%u rate=%u",
+				pcm_device, worker->ba_pcm.channels, worker->ba_pcm.sampling);
+
+		int err = alsa_pcm_open(&worker->snd_pcm, pcm_device, &access, format,
+				worker->ba_pcm.channels, worker->ba_pcm.sampling, &buffer_time, &period_time, &tmp);
+
+		/* The device might be held by PCMs with different hardware parameters
+		 * kept in the standby cache. Release them and try once again. */
+		if (err != 0 && standby_pcm_flush() > 0) {
+			free(tmp);
+			buffer_time = pcm_buffer_time;
+			period_time = pcm_period_time;
+			access = SND_PCM_ACCESS_MMAP_INTERLEAVED;
+			err = alsa_pcm_open(&worker->snd_pcm, pcm_device, &access, format,
+					worker->ba_pcm.channels, worker->ba_pcm.sampling, &buffer_time, &period_time, &tmp);
+		}
+
+		if (err != 0) {
+			warn("Couldn't open ALSA playback PCM: %s", tmp);
+			free(tmp);
+			return -1;
+		}
+
+	}
+
+	worker->snd_pcm_access = access;
+	snd_pcm_get_params(worker->snd_pcm, &buffer_frames, &period_frames);
+
+	if (*cached) {
+		/* the PCM might have been opened with different time settings */
+		buffer_time = buffer_frames * 1000000 / worker->ba_pcm.sampling;
+		period_time = period_frames * 1000000 / worker->ba_pcm.sampling;
+	}
+
+	if (worker->snd_mixer == NULL) {
+		io_worker_mixer_open(worker, mixer_device, mixer_elem_name, mixer_elem_index);
+		io_worker_mixer_volume_sync_setup(worker);
+	}
+
+	if (verbose >= 2) {
+		info("Used configuration for %s:\n"
+				"  ALSA PCM buffer time: %u us (%zu bytes)\n"
+				"  ALSA PCM period time: %u us (%zu bytes)\n"
+				"  ALSA PCM access: %s\n"
+				"  PCM format: %s\n"
+				"  Sampling rate: %u Hz\n"
+				"  Channels: %u",
+				worker->addr,
+				buffer_time, snd_pcm_frames_to_bytes(worker->snd_pcm, buffer_frames),
+				period_time, snd_pcm_frames_to_bytes(worker->snd_pcm, period_frames),
+				snd_pcm_access_name(access),
+				snd_pcm_format_name(format),
+				worker->ba_pcm.sampling,
+				worker->ba_pcm.channels);
+	}
+
+	if (verbose >= 3)
+		alsa_pcm_dump(worker->snd_pcm, stderr);
+
+	return 0;
+}
+
 static void io_worker_routine_exit(struct io_worker *worker) {
 	if (worker->ba_pcm_fd != -1) {
 		close(worker->ba_pcm_fd);
@@ -528,7 +854,12 @@ static void io_worker_routine_exit(struct io_worker *worker) {
 		worker->ba_pcm_ctrl_fd = -1;
 	}
 	if (worker->snd_pcm != NULL) {
-		snd_pcm_close(worker->snd_pcm);
+		if (pcm_standby)
+			standby_pcm_put(worker->snd_pcm, worker->snd_pcm_access,
+					bluealsa_get_snd_pcm_format(&worker->ba_pcm),
+					worker->ba_pcm.channels, worker->ba_pcm.sampling);
+		else
+			snd_pcm_close(worker->snd_pcm);
 		worker->snd_pcm = NULL;
 	}
 	if (worker->snd_mixer != NULL) {
@@ -543,6 +874,7 @@ static void *io_worker_routine(struct io_worker *w) {
 
 	snd_pcm_format_t pcm_format = bluealsa_get_snd_pcm_format(&w->ba_pcm);
 	ssize_t pcm_format_size = snd_pcm_format_size(pcm_format, 1);
+	ssize_t pcm_frame_size = pcm_format_size * w->ba_pcm.channels;
 	size_t pcm_1s_samples = w->ba_pcm.sampling * w->ba_pcm.channels;
 	ffb_t buffer = { 0 };
 
@@ -590,6 +922,18 @@ static void *io_worker_routine(struct io_worker *w) {
 	size_t pcm_max_read_len_init = pcm_1s_samples / 100 * pcm_format_size;
 	size_t pcm_max_read_len = pcm_max_read_len_init;
 
+	/* If true, the playback PCM was opened with the mmap access. */
+	bool pcm_mmap = false;
+	/* If true, the playback PCM was taken from the standby cache. */
+	bool pcm_cached = false;
+	/* Time spent on opening the playback PCM. */
+	struct timespec pcm_open_time = { 0 };
+
+	/* Time-stamp of the first samples after the device became active,
+	 * used for the time-to-first-sample metric. */
+	struct timespec ts_first_sample;
+	bool first_sample_pending = false;
+
 	/* Track the lock state of the single playback mutex within this thread. */
 	bool single_playback_mutex_locked = false;
 
@@ -603,6 +947,16 @@ static void *io_worker_routine(struct io_worker *w) {
 
 	int timeout = -1;
 
+	/* In the warm-standby mode, the playback PCM is opened right away,
+	 * so the first samples can be played without any delay. */
+	if (pcm_standby && mix == NULL &&
+			io_worker_pcm_open(w, pcm_format, &pcm_cached) == 0) {
+		snd_pcm_uframes_t buffer_frames, period_frames;
+		snd_pcm_get_params(w->snd_pcm, &buffer_frames, &period_frames);
+		pcm_max_read_len = period_frames * pcm_frame_size;
+		pcm_mmap = w->snd_pcm_access == SND_PCM_ACCESS_MMAP_INTERLEAVED;
+	}
+
 	debug("Starting IO loop");
 	for (;;) {
 
@@ -646,8 +1000,12 @@ static void *io_worker_routine(struct io_worker *w) {
 			debug("BT device marked as inactive: %s", w->addr);
 			pause_retry_pcm_samples = pcm_1s_samples;
 			pause_retries = 0;
+			first_sample_pending = false;
 			w->active = false;
 			timeout = -1;
+			/* keep the PCM ready for the next stream */
+			if (pcm_standby)
+				continue;
 			goto close_alsa;
 		}
 
@@ -657,6 +1015,55 @@ static void *io_worker_routine(struct io_worker *w) {
 		if (w->snd_mixer != NULL)
 			snd_mixer_handle_events(w->snd_mixer);
 
+		/* With the mmap access, the FIFO is read directly into the ALSA
+		 * ring buffer, so PCM samples are not copied in the user space. */
+		if (pcm_mmap && w->active && fds[1].revents & POLLIN) {
+
+			snd_pcm_uframes_t offset;
+			snd_pcm_uframes_t frames;
+			void *ptr;
+			int err;
+
+			if ((err = io_worker_mmap_begin(w->snd_pcm, pcm_max_read_len / pcm_frame_size,
+							&ptr, &offset, &frames)) != 0) {
+				error("ALSA playback PCM write error: %s", snd_strerror(err));
+				goto close_alsa;
+			}
+
+			/* The FIFO is not frame-aligned, so a read might end in the
+			 * middle of a frame. Such a partial frame is kept in the buffer
+			 * and placed in front of the data read in the next iteration. */
+			size_t partial = ffb_blen_out(&buffer);
+			memcpy(ptr, buffer.data, partial);
+
+			ssize_t ret;
+			if ((ret = read(w->ba_pcm_fd, (uint8_t *)ptr + partial,
+							frames * pcm_frame_size - partial)) == -1) {
+				snd_pcm_mmap_commit(w->snd_pcm, offset, 0);
+				if (errno == EINTR || errno == EAGAIN)
+					continue;
+				error("BlueALSA source PCM read error: %s", strerror(errno));
+				goto fail;
+			}
+
+			ret += partial;
+			frames = ret / pcm_frame_size;
+			partial = ret % pcm_frame_size;
+
+			memcpy(buffer.data, (uint8_t *)ptr + frames * pcm_frame_size, partial);
+			buffer.tail = (uint8_t *)buffer.data + partial;
+
+			if (!w->mixer_has_mute_switch && pcm_muted)
+				snd_pcm_format_set_silence(pcm_format, ptr, frames * w->ba_pcm.channels);
+
+			if ((err = io_worker_mmap_commit(w->snd_pcm, offset, frames)) != 0) {
+				error("ALSA playback PCM write error: %s", snd_strerror(err));
+				goto close_alsa;
+			}
+
+			continue;
+		}
+
 		size_t read_samples = 0;
 		if (fds[1].revents & POLLIN) {
 
@@ -713,13 +1120,42 @@ static void *io_worker_routine(struct io_worker *w) {
 
 		}
 
-		if (w->snd_pcm == NULL) {
+		if (w->mix_src != NULL) {
+
+			if (!w->active && verbose >= 2) {
+				info("Used configuration for %s:\n"
+						"  Software mixer: %s\n"
+						"  PCM format: %s\n"
+						"  Sampling rate: %u Hz\n"
+						"  Channels: %u",
+						w->addr,
+						pcm_device,
+						snd_pcm_format_name(pcm_format),
+						w->ba_pcm.sampling,
+						w->ba_pcm.channels);
+			}
+
+			/* mark device as active and set timeout to 500ms */
+			w->active = true;
+			timeout = 500;
+
+			/* The mixer queue never blocks, so there are no leftovers. In case
+			 * of the queue overflow, samples are dropped by the mixer. */
+			ffb_seek(&buffer, read_samples);
+			mix_source_write(w->mix_src, buffer.data, ffb_len_out(&buffer));
+			ffb_rewind(&buffer);
+
+			continue;
+		}
+
+		if (!w->active && !first_sample_pending) {
+			gettimestamp(&ts_first_sample);
+			first_sample_pending = true;
+			pcm_open_time.tv_sec = pcm_open_time.tv_nsec = 0;
+			pcm_cached = false;
+		}
 
-			unsigned int buffer_time = pcm_buffer_time;
-			unsigned int period_time = pcm_period_time;
-			snd_pcm_uframes_t buffer_frames;
-			snd_pcm_uframes_t period_frames;
-			char *tmp;
+		if (w->snd_pcm == NULL) {
 
 			if (pcm_open_retries > 0) {
 				/* After PCM open failure wait some time before retry. This can not be
@@ -732,46 +1168,28 @@ static void *io_worker_routine(struct io_worker *w) {
 					continue;
 			}
 
-			debug("Opening ALSA playback PCM: name=%s channels=%u rate=%u",
-					pcm_device, w->ba_pcm.channels, w->ba_pcm.sampling);
-			if (alsa_pcm_open(&w->snd_pcm, pcm_device, pcm_format, w->ba_pcm.channels,
-						w->ba_pcm.sampling, &buffer_time, &period_time, &tmp) != 0) {
-				warn("Couldn't open ALSA playback PCM: %s", tmp);
+			struct timespec ts;
+			gettimestamp(&ts);
+
+			if (io_worker_pcm_open(w, pcm_format, &pcm_cached) != 0) {
 				pcm_max_read_len = pcm_max_read_len_init;
 				pcm_open_retry_pcm_samples = 0;
 				pcm_open_retries++;
-				free(tmp);
 				continue;
 			}
 
-			snd_pcm_get_params(w->snd_pcm, &buffer_frames, &period_frames);
-			pcm_max_read_len = period_frames * w->ba_pcm.channels * pcm_format_size;
+			gettimestamp(&pcm_open_time);
+			timespecsub(&pcm_open_time, &ts, &pcm_open_time);
 
-			io_worker_mixer_open(w, mixer_device, mixer_elem_name, mixer_elem_index);
-			io_worker_mixer_volume_sync_setup(w);
+			snd_pcm_uframes_t buffer_frames, period_frames;
+			snd_pcm_get_params(w->snd_pcm, &buffer_frames, &period_frames);
+			pcm_max_read_len = period_frames * pcm_frame_size;
+			pcm_mmap = w->snd_pcm_access == SND_PCM_ACCESS_MMAP_INTERLEAVED;
 
 			/* reset retry counters */
 			pcm_open_retry_pcm_samples = 0;
 			pcm_open_retries = 0;
 
-			if (verbose >= 2) {
-				info("Used configuration for %s:\n"
-						"  ALSA PCM buffer time: %u us (%zu bytes)\n"
-						"  ALSA PCM period time: %u us (%zu bytes)\n"
-						"  PCM format: %s\n"
-						"  Sampling rate: %u Hz\n"
-						"  Channels: %u",
-						w->addr,
-						buffer_time, snd_pcm_frames_to_bytes(w->snd_pcm, buffer_frames),
-						period_time, snd_pcm_frames_to_bytes(w->snd_pcm, period_frames),
-						snd_pcm_format_name(pcm_format),
-						w->ba_pcm.sampling,
-						w->ba_pcm.channels);
-			}
-
-			if (verbose >= 3)
-				alsa_pcm_dump(w->snd_pcm, stderr);
-
 		}
 
 		/* mark device as active and set timeout to 500ms */
@@ -795,7 +1213,9 @@ static void *io_worker_routine(struct io_worker *w) {
 
 retry_alsa_write:
 		frames = samples / w->ba_pcm.channels;
-		if ((frames = snd_pcm_writei(w->snd_pcm, buffer.data, frames)) < 0)
+		if ((frames = pcm_mmap ?
+					snd_pcm_mmap_writei(w->snd_pcm, buffer.data, frames) :
+					snd_pcm_writei(w->snd_pcm, buffer.data, frames)) < 0)
 			switch (-frames) {
 			case EINTR:
 				goto retry_alsa_write;
@@ -811,11 +1231,36 @@ retry_alsa_write:
 		/* move leftovers to the beginning and reposition tail */
 		ffb_shift(&buffer, frames * w->ba_pcm.channels);
 
+		if (first_sample_pending) {
+			/* Time from the reception of the first samples until they were
+			 * handed over to ALSA. It includes the PCM open time and failed
+			 * open attempts, if any. */
+			struct timespec ts_ttfs;
+			snd_pcm_sframes_t delay = 0;
+			gettimestamp(&ts_ttfs);
+			timespecsub(&ts_ttfs, &ts_first_sample, &ts_ttfs);
+			snd_pcm_delay(w->snd_pcm, &delay);
+			if (verbose >= 1)
+				info("Time to first sample for %s: %ld ms (ALSA PCM %s: %ld ms, delay: %ld ms)",
+						w->addr, (long)timespec2ms(&ts_ttfs),
+						pcm_open_time.tv_sec || pcm_open_time.tv_nsec ?
+							(pcm_cached ? "standby" : "open") : "ready",
+						(long)timespec2ms(&pcm_open_time),
+						(long)(delay * 1000 / w->ba_pcm.sampling));
+			first_sample_pending = false;
+		}
+
+		/* With the mmap access, subsequent reads bypass the buffer,
+		 * so all leftovers have to be written right away. */
+		if (pcm_mmap && (samples = ffb_len_out(&buffer)) >= w->ba_pcm.channels)
+			goto retry_alsa_write;
+
 		continue;
 
 close_alsa:
 		ffb_rewind(&buffer);
 		pcm_max_read_len = pcm_max_read_len_init;
+		pcm_mmap = false;
 		if (w->snd_pcm != NULL) {
 			snd_pcm_close(w->snd_pcm);
 			w->snd_pcm = NULL;
@@ -855,6 +1300,9 @@ static void io_worker_stop(size_t index) {
 	pthread_cancel(workers[index].thread);
 	pthread_join(workers[index].thread, NULL);
 
+	if (workers[index].mix_src != NULL)
+		mix_source_remove(workers[index].mix_src);
+
 	pthread_rwlock_wrlock(&workers_lock);
 
 	if (index != --workers_count)
@@ -903,12 +1351,28 @@ static struct io_worker *supervise_io_worker_start(const struct ba_pcm *ba_pcm)
 	worker->snd_mixer = NULL;
 	worker->snd_mixer_elem = NULL;
 	worker->mixer_has_mute_switch = false;
+	worker->mix_src = NULL;
 	worker->active = false;
 
+	/* The mixer source is owned by the main thread, so it can
+	 * be safely updated when the BlueALSA PCM volume changes. */
+	if (mix != NULL) {
+		if ((worker->mix_src = mix_source_add(mix, bluealsa_get_snd_pcm_format(ba_pcm),
+						ba_pcm->channels, ba_pcm->sampling)) == NULL) {
+			error("Couldn't create mixer source %s: %s", worker->addr, strerror(errno));
+			workers_count--;
+			pthread_rwlock_unlock(&workers_lock);
+			return NULL;
+		}
+		io_worker_mix_src_sync_gain(worker, ba_pcm);
+	}
+
 	debug("Creating IO worker %s", worker->addr);
 	if ((errno = pthread_create(&worker->thread, NULL,
 					PTHREAD_FUNC(io_worker_routine), worker)) != 0) {
 		error("Couldn't create IO worker %s: %s", worker->addr, strerror(errno));
+		if (worker->mix_src != NULL)
+			mix_source_remove(worker->mix_src);
 		workers_count--;
 		worker = NULL;
 	}
@@ -1027,8 +1491,10 @@ static DBusHandlerResult dbus_signal_handler(DBusConnection *conn, DBusMessage *
 		dbus_message_iter_next(&iter);
 		if (!dbus_message_iter_get_ba_pcm_props(&iter, NULL, pcm))
 			goto fail;
-		if ((worker = supervise_io_worker(pcm)) != NULL)
+		if ((worker = supervise_io_worker(pcm)) != NULL) {
 			io_worker_mixer_volume_sync_snd_mixer_elem(worker, pcm);
+			io_worker_mix_src_sync_gain(worker, pcm);
+		}
 		return DBUS_HANDLER_RESULT_HANDLED;
 	}
 
@@ -1052,6 +1518,7 @@ int main(int argc, char *argv[]) {
 		{ "pcm", required_argument, NULL, 'D' },
 		{ "pcm-buffer-time", required_argument, NULL, 3 },
 		{ "pcm-period-time", required_argument, NULL, 4 },
+		{ "pcm-standby", no_argument, NULL, 11 },
 		{ "volume", required_argument, NULL, '8' },
 		{ "mixer-device", required_argument, NULL, 'M' },
 		{ "mixer-name", required_argument, NULL, 6 },
@@ -1059,6 +1526,7 @@ int main(int argc, char *argv[]) {
 		{ "profile-a2dp", no_argument, NULL, 1 },
 		{ "profile-sco", no_argument, NULL, 2 },
 		{ "single-audio", no_argument, NULL, 5 },
+		{ "mix", no_argument, NULL, 10 },
 		{ 0, 0, 0, 0 },
 	};
 
@@ -1086,6 +1554,7 @@ int main(int argc, char *argv[]) {
 					"  -D, --pcm=NAME\t\tplayback PCM device to use\n"
 					"  --pcm-buffer-time=INT\t\tplayback PCM buffer time\n"
 					"  --pcm-period-time=INT\t\tplayback PCM period time\n"
+					"  --pcm-standby\t\t\tkeep playback PCM ready\n"
 					"  --volume=TYPE\t\t\tvolume control type [auto|mixer|none|software]\n"
 					"  -M, --mixer-device=NAME\tmixer device to use\n"
 					"  --mixer-name=NAME\t\tmixer element name\n"
@@ -1093,6 +1562,7 @@ int main(int argc, char *argv[]) {
 					"  --profile-a2dp\t\tuse A2DP profile (default)\n"
 					"  --profile-sco\t\t\tuse SCO profile\n"
 					"  --single-audio\t\tsingle audio mode\n"
+					"  --mix\t\t\t\tmix all audio into one PCM\n"
 					"\nNote:\n"
 					"If one wants to receive audio from more than one Bluetooth device, it is\n"
 					"possible to specify more than one MAC address. By specifying any/empty MAC\n"
@@ -1173,6 +1643,9 @@ int main(int argc, char *argv[]) {
 		case 4 /* --pcm-period-time=INT */ :
 			pcm_period_time = atoi(optarg);
 			break;
+		case 11 /* --pcm-standby */ :
+			pcm_standby = true;
+			break;
 
 		case '8' /* --volume */ : {
 
@@ -1216,12 +1689,20 @@ int main(int argc, char *argv[]) {
 		case 5 /* --single-audio */ :
 			force_single_playback = true;
 			break;
+		case 10 /* --mix */ :
+			mix_playback = true;
+			break;
 
 		default:
 			fprintf(stderr, "Try '%s --help' for more information.\n", argv[0]);
 			return EXIT_FAILURE;
 		}
 
+	if (force_single_playback && mix_playback) {
+		error("Options --single-audio and --mix are mutually exclusive");
+		return EXIT_FAILURE;
+	}
+
 	if ((main_loop_quit_event_fd = eventfd(0, EFD_CLOEXEC)) == -1) {
 		error("Couldn't create quit event: %s", strerror(errno));
 		return EXIT_FAILURE;
@@ -1256,7 +1737,10 @@ int main(int argc, char *argv[]) {
 		return EXIT_FAILURE;
 	}
 
-	if (volume_type == VOL_TYPE_NONE || volume_type == VOL_TYPE_SOFTWARE)
+	/* With the software mixer, the volume of each stream is applied as
+	 * the gain of its mixer source, so the ALSA mixer is not used. */
+	if (volume_type == VOL_TYPE_NONE || volume_type == VOL_TYPE_SOFTWARE ||
+			mix_playback)
 		mixer_device = NULL;
 
 	if (verbose >= 1) {
@@ -1297,6 +1781,13 @@ int main(int argc, char *argv[]) {
 		free(ba_str);
 	}
 
+	if (mix_playback &&
+			(mix = mix_create(pcm_device, pcm_buffer_time, pcm_period_time,
+					pcm_standby, verbose)) == NULL) {
+		error("Couldn't create software mixer: %s", strerror(errno));
+		return EXIT_FAILURE;
+	}
+
 	ba_dbus_connection_signal_match_add(&dbus_ctx,
 			dbus_ba_service, NULL, DBUS_INTERFACE_OBJECT_MANAGER, "InterfacesAdded",
 			"path_namespace='/org/bluealsa'");
@@ -1355,6 +1846,10 @@ int main(int argc, char *argv[]) {
 		io_worker_stop(i - 1);
 	free(workers);
 
+	if (mix != NULL)
+		mix_destroy(mix);
+	standby_pcm_flush();
+
 	ba_dbus_connection_ctx_free(&dbus_ctx);
 	return EXIT_SUCCESS;
 }
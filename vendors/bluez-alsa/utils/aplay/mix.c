@@ -0,0 +1,687 @@
+/*
+ * BlueALSA - mix.c
+ * Copyright (c) 2016-2024 Arkadiusz Bokowy
+ *
+ * This file is a part of bluez-alsa.
+ *
+ * This project is licensed under the terms of the MIT license.
+ *
+ */
+
+#include "mix.h"
+
+#include <endian.h>
+#include <errno.h>
+#include <math.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/param.h>
+#include <time.h>
+
+#include "shared/defs.h"
+#include "shared/log.h"
+#include "alsa-pcm.h"
+
+/* Relative queue fill error which is tolerated without any correction. */
+#define MIX_DRIFT_DEADBAND 0.25
+/* Playback rate correction per unit of the queue fill error. */
+#define MIX_DRIFT_GAIN 0.005
+/* Maximum playback rate correction, about 9 cents of pitch. */
+#define MIX_DRIFT_MAX 0.005
+
+struct mix_source {
+
+	struct mix *mix;
+	struct mix_source *next;
+
+	snd_pcm_format_t format;
+	unsigned int channels;
+	unsigned int rate;
+
+	/* Single-producer single-consumer queue of decoded frames. The worker
+	 * thread advances the head, the mixer thread advances the tail. Both
+	 * positions are in frames and wrap by the (power of 2) queue size. */
+	float *queue;
+	size_t queue_frames;
+	atomic_size_t head;
+	atomic_size_t tail;
+
+	/* linear gain applied while mixing */
+	_Atomic float gain;
+
+	/* number of queued frames needed to start playback */
+	size_t target;
+
+	/* state owned by the mixer thread */
+	bool playing;
+	double fill;
+	double frac;
+
+};
+
+struct mix {
+
+	pthread_t thread;
+	pthread_mutex_t mutex;
+	pthread_cond_t ready;
+
+	/* list of registered sources, guarded by the mutex */
+	struct mix_source *sources;
+
+	/* mixer thread waits for a source to become ready */
+	atomic_bool idle;
+	bool quit;
+
+	const char *pcm_name;
+	unsigned int buffer_time;
+	unsigned int period_time;
+	bool standby;
+	unsigned int verbose;
+
+	/* opened playback PCM device */
+	snd_pcm_t *pcm;
+	snd_pcm_format_t format;
+	unsigned int channels;
+	unsigned int rate;
+	snd_pcm_uframes_t period_frames;
+
+	/* one period of mixed, resampled and output samples */
+	float *acc;
+	float *tmp;
+	void *out;
+
+};
+
+/**
+ * Convert PCM samples to float in the range [-1, 1). */
+static void mix_samples_to_float(float *dst, const void *src,
+		size_t samples, snd_pcm_format_t format) {
+	size_t i;
+	switch (format) {
+	case SND_PCM_FORMAT_U8: {
+		const uint8_t *s = src;
+		for (i = 0; i < samples; i++)
+			dst[i] = ((int)s[i] - 0x80) * (1.0f / 0x80);
+	} break;
+	case SND_PCM_FORMAT_S16_LE: {
+		const int16_t *s = src;
+		for (i = 0; i < samples; i++)
+			dst[i] = (int16_t)le16toh(s[i]) * (1.0f / 0x8000);
+	} break;
+	case SND_PCM_FORMAT_S24_3LE: {
+		const uint8_t *s = src;
+		for (i = 0; i < samples; i++, s += 3) {
+			const uint32_t v = s[0] | s[1] << 8 | (uint32_t)s[2] << 16;
+			dst[i] = ((int32_t)(v << 8) >> 8) * (1.0f / 0x800000);
+		}
+	} break;
+	case SND_PCM_FORMAT_S24_LE: {
+		const int32_t *s = src;
+		for (i = 0; i < samples; i++)
+			dst[i] = ((int32_t)(le32toh(s[i]) << 8) >> 8) * (1.0f / 0x800000);
+	} break;
+	case SND_PCM_FORMAT_S32_LE: {
+		const int32_t *s = src;
+		for (i = 0; i < samples; i++)
+			dst[i] = (int32_t)le32toh(s[i]) * (1.0f / 2147483648.0f);
+	} break;
+	default:
+		memset(dst, 0, samples * sizeof(*dst));
+	}
+}
+
+/**
+ * Convert float samples to PCM format with saturation. */
+static void mix_float_to_samples(void *dst, const float *src,
+		size_t samples, snd_pcm_format_t format) {
+	size_t i;
+	switch (format) {
+	case SND_PCM_FORMAT_U8: {
+		uint8_t *d = dst;
+		for (i = 0; i < samples; i++)
+			d[i] = 0x80 + (int)fminf(fmaxf(src[i] * 0x80, -0x80), 0x7F);
+	} break;
+	case SND_PCM_FORMAT_S16_LE: {
+		int16_t *d = dst;
+		for (i = 0; i < samples; i++)
+			d[i] = htole16((int16_t)fminf(fmaxf(src[i] * 0x8000, -0x8000), 0x7FFF));
+	} break;
+	case SND_PCM_FORMAT_S24_3LE: {
+		uint8_t *d = dst;
+		for (i = 0; i < samples; i++, d += 3) {
+			const int32_t v = fminf(fmaxf(src[i] * 0x800000, -0x800000), 0x7FFFFF);
+			d[0] = v;
+			d[1] = v >> 8;
+			d[2] = v >> 16;
+		}
+	} break;
+	case SND_PCM_FORMAT_S24_LE: {
+		int32_t *d = dst;
+		for (i = 0; i < samples; i++)
+			d[i] = htole32((int32_t)fminf(fmaxf(src[i] * 0x800000, -0x800000), 0x7FFFFF));
+	} break;
+	case SND_PCM_FORMAT_S32_LE: {
+		int32_t *d = dst;
+		/* the largest float below 2^31 is 2^31 - 128 */
+		for (i = 0; i < samples; i++)
+			d[i] = htole32((int32_t)fminf(fmaxf(src[i] * 2147483648.0f, -2147483648.0f), 0x7FFFFF80));
+	} break;
+	default:
+		break;
+	}
+}
+
+typedef float mix_v4sf __attribute__ ((vector_size (16)));
+
+/**
+ * Add scaled samples to the accumulator.
+ *
+ * This loop is the hot spot of the mixer. The vector extension maps to
+ * SSE or NEON instructions, so four samples are mixed at once even with
+ * the default optimization level. */
+static void mix_accumulate(float *acc, const float *src,
+		size_t samples, float gain) {
+
+	const mix_v4sf g = { gain, gain, gain, gain };
+	size_t i = 0;
+
+	for (; i + 4 <= samples; i += 4) {
+		mix_v4sf a, s;
+		memcpy(&a, &acc[i], sizeof(a));
+		memcpy(&s, &src[i], sizeof(s));
+		a += s * g;
+		memcpy(&acc[i], &a, sizeof(a));
+	}
+
+	for (; i < samples; i++)
+		acc[i] += src[i] * gain;
+
+}
+
+/**
+ * Map a single frame to the output channel layout. */
+static void mix_channel_map(float *dst, unsigned int dst_channels,
+		const float *src, unsigned int src_channels) {
+	unsigned int i;
+	if (src_channels == dst_channels)
+		memcpy(dst, src, dst_channels * sizeof(*dst));
+	else if (src_channels == 1)
+		for (i = 0; i < dst_channels; i++)
+			dst[i] = src[0];
+	else if (dst_channels == 1) {
+		float sum = 0;
+		for (i = 0; i < src_channels; i++)
+			sum += src[i];
+		dst[0] = sum / src_channels;
+	}
+	else
+		for (i = 0; i < dst_channels; i++)
+			dst[i] = i < src_channels ? src[i] : 0;
+}
+
+/**
+ * Read one period of the source, resampled to the output rate.
+ *
+ * The source starts playing once it has queued the target number of frames.
+ * Afterwards, the playback rate is nudged so that the average queue fill is
+ * kept around the target. This compensates the drift between the clock of
+ * the Bluetooth device and the clock of the output device.
+ *
+ * @return This function returns true if the source contributed to the
+ *   output, false otherwise. */
+static bool mix_source_read(struct mix_source *src, float *dst,
+		size_t frames, unsigned int channels, unsigned int rate) {
+
+	const size_t mask = src->queue_frames - 1;
+	const size_t head = atomic_load(&src->head);
+	size_t tail = atomic_load_explicit(&src->tail, memory_order_relaxed);
+	size_t avail = head - tail;
+
+	if (!src->playing) {
+		if (avail < src->target)
+			return false;
+		src->playing = true;
+		src->fill = src->target;
+		src->frac = 0;
+	}
+
+	/* Drop stale frames queued while nothing was consuming them, e.g.
+	 * when the output was not available. Otherwise, it would take ages
+	 * for the drift compensation to catch up. */
+	if (avail > 3 * src->target) {
+		tail = head - src->target;
+		avail = src->target;
+		src->fill = avail;
+	}
+
+	src->fill += (avail - src->fill) / 16;
+	double drift = (src->fill - src->target) / src->target;
+	if (fabs(drift) < MIX_DRIFT_DEADBAND)
+		drift = 0;
+	else
+		drift -= copysign(MIX_DRIFT_DEADBAND, drift);
+	const double step = (double)src->rate / rate *
+		(1 + fmax(fmin(drift * MIX_DRIFT_GAIN, MIX_DRIFT_MAX), -MIX_DRIFT_MAX));
+
+	size_t i;
+	for (i = 0; i < frames; i++) {
+
+		if (head - tail < 2) {
+			debug("Mixer source underrun: %zu frames", frames - i);
+			src->playing = false;
+			break;
+		}
+
+		const float *a = &src->queue[(tail & mask) * src->channels];
+		const float *b = &src->queue[((tail + 1) & mask) * src->channels];
+		const float frac = src->frac;
+		float frame[MIX_CHANNELS_MAX];
+
+		for (unsigned int c = 0; c < src->channels; c++)
+			frame[c] = a[c] + (b[c] - a[c]) * frac;
+		mix_channel_map(&dst[i * channels], channels, frame, src->channels);
+
+		src->frac += step;
+		const size_t n = src->frac;
+		src->frac -= n;
+		tail += MIN(n, head - tail);
+
+	}
+
+	memset(&dst[i * channels], 0, (frames - i) * channels * sizeof(*dst));
+	atomic_store_explicit(&src->tail, tail, memory_order_release);
+	return true;
+}
+
+static struct mix_source *mix_get_ready_source(struct mix *mix) {
+	for (struct mix_source *src = mix->sources; src != NULL; src = src->next)
+		if (atomic_load(&src->head) - atomic_load(&src->tail) >= src->target)
+			return src;
+	return NULL;
+}
+
+static void mix_pcm_close(struct mix *mix) {
+	if (mix->pcm == NULL)
+		return;
+	debug("Closing mixer ALSA playback PCM");
+	snd_pcm_close(mix->pcm);
+	mix->pcm = NULL;
+}
+
+/**
+ * Open the playback PCM with the hardware parameters of the given source. */
+static int mix_pcm_open(struct mix *mix, const struct mix_source *src) {
+
+	unsigned int buffer_time = mix->buffer_time;
+	unsigned int period_time = mix->period_time;
+	snd_pcm_uframes_t buffer_frames;
+	snd_pcm_uframes_t period_frames;
+	snd_pcm_access_t access = SND_PCM_ACCESS_RW_INTERLEAVED;
+	char *msg;
+
+	debug("Opening mixer ALSA playback PCM: name=%s channels=%u rate=%u",
+			mix->pcm_name, src->channels, src->rate);
+	if (alsa_pcm_open(&mix->pcm, mix->pcm_name, &access, src->format, src->channels,
+				src->rate, &buffer_time, &period_time, &msg) != 0) {
+		warn("Couldn't open ALSA playback PCM: %s", msg);
+		free(msg);
+		return -1;
+	}
+
+	snd_pcm_get_params(mix->pcm, &buffer_frames, &period_frames);
+	const size_t samples = period_frames * src->channels;
+
+	float *acc, *tmp;
+	void *out;
+	if ((acc = realloc(mix->acc, samples * sizeof(*acc))) != NULL)
+		mix->acc = acc;
+	if ((tmp = realloc(mix->tmp, samples * sizeof(*tmp))) != NULL)
+		mix->tmp = tmp;
+	if ((out = realloc(mix->out, snd_pcm_frames_to_bytes(mix->pcm, period_frames))) != NULL)
+		mix->out = out;
+	if (acc == NULL || tmp == NULL || out == NULL) {
+		error("Couldn't create mixer buffer: %s", strerror(ENOMEM));
+		mix_pcm_close(mix);
+		return -1;
+	}
+
+	mix->format = src->format;
+	mix->channels = src->channels;
+	mix->rate = src->rate;
+	mix->period_frames = period_frames;
+
+	if (mix->verbose >= 2) {
+		info("Used configuration for mixer:\n"
+				"  ALSA PCM buffer time: %u us (%zu bytes)\n"
+				"  ALSA PCM period time: %u us (%zu bytes)\n"
+				"  PCM format: %s\n"
+				"  Sampling rate: %u Hz\n"
+				"  Channels: %u",
+				buffer_time, snd_pcm_frames_to_bytes(mix->pcm, buffer_frames),
+				period_time, snd_pcm_frames_to_bytes(mix->pcm, period_frames),
+				snd_pcm_format_name(mix->format),
+				mix->rate,
+				mix->channels);
+	}
+
+	if (mix->verbose >= 3)
+		alsa_pcm_dump(mix->pcm, stderr);
+
+	return 0;
+}
+
+static int mix_pcm_write(struct mix *mix) {
+
+	snd_pcm_uframes_t offset = 0;
+	while (offset < mix->period_frames) {
+
+		const void *data = (uint8_t *)mix->out + snd_pcm_frames_to_bytes(mix->pcm, offset);
+		snd_pcm_sframes_t frames;
+
+		if ((frames = snd_pcm_writei(mix->pcm, data, mix->period_frames - offset)) < 0)
+			switch (-frames) {
+			case EINTR:
+				continue;
+			case EPIPE:
+				debug("ALSA playback PCM underrun");
+				snd_pcm_prepare(mix->pcm);
+				continue;
+			default:
+				error("ALSA playback PCM write error: %s", snd_strerror(frames));
+				return -1;
+			}
+
+		offset += frames;
+	}
+
+	return 0;
+}
+
+/**
+ * Wait for the given number of seconds unless the mixer is being destroyed.
+ *
+ * Note: The caller must hold the mixer mutex. */
+static void mix_wait_retry(struct mix *mix, unsigned int interval) {
+	struct timespec ts;
+	clock_gettime(CLOCK_REALTIME, &ts);
+	ts.tv_sec += interval;
+	while (!mix->quit &&
+			pthread_cond_timedwait(&mix->ready, &mix->mutex, &ts) != ETIMEDOUT)
+		continue;
+}
+
+static void mix_thread_cleanup(struct mix *mix) {
+	mix_pcm_close(mix);
+	free(mix->acc);
+	free(mix->tmp);
+	free(mix->out);
+}
+
+static void *mix_thread(struct mix *mix) {
+
+	/* Intervals in seconds between consecutive PCM open retry attempts. */
+	const unsigned int pcm_open_retry_intervals[] = { 1, 1, 2, 3, 5 };
+	size_t pcm_open_retries = 0;
+
+	/* number of output frames without any source playing */
+	size_t idle_frames = 0;
+
+	pthread_mutex_lock(&mix->mutex);
+
+	debug("Starting mixer loop");
+	while (!mix->quit) {
+
+		struct mix_source *src = NULL;
+
+		if (mix->pcm == NULL) {
+
+			/* The idle flag has to be set before checking the sources, so the
+			 * worker which has just filled its queue will not miss it. */
+			atomic_store(&mix->idle, true);
+			while (!mix->quit && (src = mix_get_ready_source(mix)) == NULL)
+				pthread_cond_wait(&mix->ready, &mix->mutex);
+			atomic_store(&mix->idle, false);
+
+			if (mix->quit)
+				break;
+
+			if (pcm_open_retries > 0) {
+				mix_wait_retry(mix, pcm_open_retries > ARRAYSIZE(pcm_open_retry_intervals) ?
+						pcm_open_retry_intervals[ARRAYSIZE(pcm_open_retry_intervals) - 1] :
+						pcm_open_retry_intervals[pcm_open_retries - 1]);
+				/* the source might have been removed in the meantime */
+				if (mix->quit || (src = mix_get_ready_source(mix)) == NULL)
+					continue;
+			}
+
+			if (mix_pcm_open(mix, src) != 0) {
+				pcm_open_retries++;
+				continue;
+			}
+
+			pcm_open_retries = 0;
+			idle_frames = 0;
+
+		}
+
+		const size_t samples = mix->period_frames * mix->channels;
+		bool active = false;
+
+		memset(mix->acc, 0, samples * sizeof(*mix->acc));
+		for (src = mix->sources; src != NULL; src = src->next)
+			if (mix_source_read(src, mix->tmp, mix->period_frames, mix->channels, mix->rate)) {
+				mix_accumulate(mix->acc, mix->tmp, samples,
+						atomic_load_explicit(&src->gain, memory_order_relaxed));
+				active = true;
+			}
+
+		idle_frames = active ? 0 : idle_frames + mix->period_frames;
+
+		/* Do not block workers and the main thread while
+		 * waiting for the space in the playback buffer. */
+		pthread_mutex_unlock(&mix->mutex);
+		mix_float_to_samples(mix->out, mix->acc, samples, mix->format);
+		int rv = mix_pcm_write(mix);
+		pthread_mutex_lock(&mix->mutex);
+
+		/* release the device after 500 ms of silence */
+		if (rv != 0 || (!mix->standby && idle_frames >= mix->rate / 2))
+			mix_pcm_close(mix);
+
+	}
+
+	mix_thread_cleanup(mix);
+	pthread_mutex_unlock(&mix->mutex);
+
+	debug("Exiting mixer loop");
+	return NULL;
+}
+
+/**
+ * Create software mixer which plays all sources into one ALSA PCM.
+ *
+ * The playback PCM is opened when the first source starts playing and it
+ * uses the hardware parameters of that source. All other sources are
+ * converted to these parameters. Unless in the standby mode, the PCM is
+ * closed when there are no playing sources.
+ *
+ * @param pcm_name The name of the ALSA playback PCM device.
+ * @param buffer_time The playback PCM buffer time in microseconds.
+ * @param period_time The playback PCM period time in microseconds. The
+ *   sources queue two periods of audio before they start playing.
+ * @param standby If true, the playback PCM is not closed when there are
+ *   no playing sources.
+ * @param verbose The verbosity level for the used configuration dump.
+ * @return On success this function returns the mixer. Otherwise, NULL is
+ *   returned and errno is set appropriately. */
+struct mix *mix_create(const char *pcm_name,
+		unsigned int buffer_time, unsigned int period_time,
+		bool standby, unsigned int verbose) {
+
+	struct mix *mix;
+	if ((mix = calloc(1, sizeof(*mix))) == NULL)
+		return NULL;
+
+	pthread_mutex_init(&mix->mutex, NULL);
+	pthread_cond_init(&mix->ready, NULL);
+	mix->pcm_name = pcm_name;
+	mix->buffer_time = buffer_time;
+	mix->period_time = period_time;
+	mix->standby = standby;
+	mix->verbose = verbose;
+
+	if ((errno = pthread_create(&mix->thread, NULL,
+					PTHREAD_FUNC(mix_thread), mix)) != 0) {
+		pthread_cond_destroy(&mix->ready);
+		pthread_mutex_destroy(&mix->mutex);
+		free(mix);
+		return NULL;
+	}
+
+	return mix;
+}
+
+/**
+ * Stop the mixer thread and free resources.
+ *
+ * All sources have to be removed before calling this function. */
+void mix_destroy(struct mix *mix) {
+
+	pthread_mutex_lock(&mix->mutex);
+	mix->quit = true;
+	pthread_cond_signal(&mix->ready);
+	pthread_mutex_unlock(&mix->mutex);
+
+	pthread_join(mix->thread, NULL);
+
+	pthread_cond_destroy(&mix->ready);
+	pthread_mutex_destroy(&mix->mutex);
+	free(mix);
+
+}
+
+/**
+ * Register new source in the mixer.
+ *
+ * @param mix The software mixer.
+ * @param format The PCM format of the source samples.
+ * @param channels The number of source channels.
+ * @param rate The source sampling rate.
+ * @return On success this function returns the source with unity gain.
+ *   Otherwise, NULL is returned and errno is set appropriately. */
+struct mix_source *mix_source_add(struct mix *mix,
+		snd_pcm_format_t format, unsigned int channels, unsigned int rate) {
+
+	switch (format) {
+	case SND_PCM_FORMAT_U8:
+	case SND_PCM_FORMAT_S16_LE:
+	case SND_PCM_FORMAT_S24_3LE:
+	case SND_PCM_FORMAT_S24_LE:
+	case SND_PCM_FORMAT_S32_LE:
+		break;
+	default:
+		errno = ENOTSUP;
+		return NULL;
+	}
+
+	if (channels == 0 || channels > MIX_CHANNELS_MAX || rate == 0) {
+		errno = EINVAL;
+		return NULL;
+	}
+
+	struct mix_source *src;
+	if ((src = calloc(1, sizeof(*src))) == NULL)
+		return NULL;
+
+	src->mix = mix;
+	src->format = format;
+	src->channels = channels;
+	src->rate = rate;
+	src->gain = 1.0f;
+
+	/* Queue two periods before starting the playback and allow four
+	 * times as much, so the queue can absorb Bluetooth bursts. */
+	src->target = MAX((uint64_t)rate * mix->period_time * 2 / 1000000, 2);
+	for (src->queue_frames = 1024; src->queue_frames < 4 * src->target; )
+		src->queue_frames *= 2;
+
+	if ((src->queue = malloc(src->queue_frames * channels * sizeof(*src->queue))) == NULL) {
+		free(src);
+		return NULL;
+	}
+
+	pthread_mutex_lock(&mix->mutex);
+	src->next = mix->sources;
+	mix->sources = src;
+	pthread_mutex_unlock(&mix->mutex);
+
+	return src;
+}
+
+/**
+ * Unregister the source and free its resources. */
+void mix_source_remove(struct mix_source *src) {
+
+	struct mix *mix = src->mix;
+	struct mix_source **p;
+
+	pthread_mutex_lock(&mix->mutex);
+	for (p = &mix->sources; *p != NULL; p = &(*p)->next)
+		if (*p == src) {
+			*p = src->next;
+			break;
+		}
+	pthread_mutex_unlock(&mix->mutex);
+
+	free(src->queue);
+	free(src);
+
+}
+
+/**
+ * Queue PCM samples for mixing.
+ *
+ * This function shall be called by one thread only. It never blocks; in
+ * case when the queue is full, surplus samples are dropped.
+ *
+ * @param src The mixer source.
+ * @param data The buffer with interleaved samples in the source format.
+ * @param samples The number of samples in the buffer.
+ * @return This function returns the number of queued samples. */
+size_t mix_source_write(struct mix_source *src, const void *data, size_t samples) {
+
+	const size_t mask = src->queue_frames - 1;
+	const size_t head = atomic_load_explicit(&src->head, memory_order_relaxed);
+	const size_t tail = atomic_load_explicit(&src->tail, memory_order_acquire);
+	const size_t frames = MIN(samples / src->channels, src->queue_frames - (head - tail));
+	const size_t frame_size = snd_pcm_format_size(src->format, src->channels);
+
+	/* copy up to the end of the queue and wrap the rest */
+	const size_t n = MIN(frames, src->queue_frames - (head & mask));
+	mix_samples_to_float(&src->queue[(head & mask) * src->channels], data,
+			n * src->channels, src->format);
+	mix_samples_to_float(src->queue, (const uint8_t *)data + n * frame_size,
+			(frames - n) * src->channels, src->format);
+
+	atomic_store(&src->head, head + frames);
+
+	/* wake up the mixer thread if it waits for this source */
+	if (atomic_load(&src->mix->idle) && head + frames - tail >= src->target) {
+		pthread_mutex_lock(&src->mix->mutex);
+		pthread_cond_signal(&src->mix->ready);
+		pthread_mutex_unlock(&src->mix->mutex);
+	}
+
+	return frames * src->channels;
+}
+
+/**
+ * Set the linear gain applied to the source while mixing. */
+void mix_source_set_gain(struct mix_source *src, float gain) {
+	atomic_store_explicit(&src->gain, gain, memory_order_relaxed);
+}
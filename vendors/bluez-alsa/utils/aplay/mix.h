@@ -0,0 +1,38 @@
+/*
+ * BlueALSA - mix.h
+ * Copyright (c) 2016-2024 Arkadiusz Bokowy
+ *
+ * This file is a part of bluez-alsa.
+ *
+ * This project is licensed under the terms of the MIT license.
+ *
+ */
+
+#pragma once
+#ifndef BLUEALSA_APLAY_MIX_H_
+#define BLUEALSA_APLAY_MIX_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+
+#include <alsa/asoundlib.h>
+
+/* maximum number of channels of a mixed stream */
+#define MIX_CHANNELS_MAX 8
+
+struct mix;
+struct mix_source;
+
+struct mix *mix_create(const char *pcm_name,
+		unsigned int buffer_time, unsigned int period_time,
+		bool standby, unsigned int verbose);
+void mix_destroy(struct mix *mix);
+
+struct mix_source *mix_source_add(struct mix *mix,
+		snd_pcm_format_t format, unsigned int channels, unsigned int rate);
+void mix_source_remove(struct mix_source *src);
+
+size_t mix_source_write(struct mix_source *src, const void *data, size_t samples);
+void mix_source_set_gain(struct mix_source *src, float gain);
+
+#endif
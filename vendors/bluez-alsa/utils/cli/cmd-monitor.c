@@ -8,12 +8,20 @@
  *
  */
 
+#if HAVE_CONFIG_H
+# include <config.h>
+#endif
+
+#include <errno.h>
 #include <getopt.h>
+#include <poll.h>
 #include <stdbool.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <strings.h>
+#include <time.h>
 
 #include <dbus/dbus.h>
 
@@ -25,6 +33,7 @@
 
 enum {
 	PROPERTY_CODEC,
+	PROPERTY_DELAY,
 	PROPERTY_RUNNING,
 	PROPERTY_SOFTVOL,
 	PROPERTY_VOLUME,
@@ -35,14 +44,34 @@ struct property {
 	bool enabled;
 };
 
+/**
+ * Latest values of monitored PCM properties. */
+struct monitor_pcm {
+	char *path;
+	/* bit mask of properties changed since the last flush */
+	unsigned int changed;
+	char codec[32];
+	dbus_uint16_t delay;
+	dbus_bool_t running;
+	dbus_bool_t softvol;
+	dbus_uint16_t volume;
+};
+
 static bool monitor_properties = false;
 static struct property monitor_properties_set[] = {
 	[PROPERTY_CODEC] = { "Codec", false },
+	[PROPERTY_DELAY] = { "Delay", false },
 	[PROPERTY_RUNNING] = { "Running", false },
 	[PROPERTY_SOFTVOL] = { "SoftVolume", false },
 	[PROPERTY_VOLUME] = { "Volume", false },
 };
 
+static bool monitor_json = false;
+static unsigned int monitor_interval_ms = 0;
+
+static struct monitor_pcm *monitor_pcms = NULL;
+static size_t monitor_pcms_len = 0;
+
 static bool test_bluealsa_service(const char *name, void *data) {
 	bool *result = data;
 	if (strcmp(name, BLUEALSA_SERVICE) == 0) {
@@ -53,9 +82,120 @@ static bool test_bluealsa_service(const char *name, void *data) {
 	return true;
 }
 
+/**
+ * Print string value as a JSON string literal. */
+static void monitor_print_json_string(const char *str) {
+	putchar('"');
+	for (; *str != '\0'; str++) {
+		const unsigned char c = *str;
+		if (c == '"' || c == '\\')
+			printf("\\%c", c);
+		else if (c < 0x20)
+			printf("\\u%04x", c);
+		else
+			putchar(c);
+	}
+	putchar('"');
+}
+
+/**
+ * Print event which is not related to PCM properties. */
+static void monitor_print_event(const char *event, const char *key, const char *value) {
+	if (!monitor_json) {
+		printf("%s %s\n", event, value);
+		return;
+	}
+	printf("{\"event\":");
+	monitor_print_json_string(event);
+	printf(",\"%s\":", key);
+	monitor_print_json_string(value);
+	printf("}\n");
+}
+
+static struct monitor_pcm *monitor_pcm_lookup(const char *path, bool create) {
+
+	for (size_t i = 0; i < monitor_pcms_len; i++)
+		if (strcmp(monitor_pcms[i].path, path) == 0)
+			return &monitor_pcms[i];
+
+	if (!create)
+		return NULL;
+
+	struct monitor_pcm *tmp;
+	if ((tmp = realloc(monitor_pcms, (monitor_pcms_len + 1) * sizeof(*tmp))) == NULL)
+		return NULL;
+	monitor_pcms = tmp;
+
+	struct monitor_pcm *pcm = &monitor_pcms[monitor_pcms_len];
+	memset(pcm, 0, sizeof(*pcm));
+	if ((pcm->path = strdup(path)) == NULL)
+		return NULL;
+
+	monitor_pcms_len++;
+	return pcm;
+}
+
+static void monitor_pcm_remove(struct monitor_pcm *pcm) {
+	free(pcm->path);
+	*pcm = monitor_pcms[--monitor_pcms_len];
+}
+
+/**
+ * Print properties changed since the last flush.
+ *
+ * In the JSON mode all changes are printed as a single record. Otherwise,
+ * every property is printed in a separate line. */
+static void monitor_pcm_flush(struct monitor_pcm *pcm) {
+
+	if (pcm->changed == 0)
+		return;
+
+	if (monitor_json) {
+
+		printf("{\"event\":\"PropertiesChanged\",\"path\":");
+		monitor_print_json_string(pcm->path);
+		if (pcm->changed & (1 << PROPERTY_CODEC)) {
+			printf(",\"Codec\":");
+			monitor_print_json_string(pcm->codec);
+		}
+		if (pcm->changed & (1 << PROPERTY_DELAY))
+			printf(",\"Delay\":%u", pcm->delay);
+		if (pcm->changed & (1 << PROPERTY_RUNNING))
+			printf(",\"Running\":%s", pcm->running ? "true" : "false");
+		if (pcm->changed & (1 << PROPERTY_SOFTVOL))
+			printf(",\"SoftVolume\":%s", pcm->softvol ? "true" : "false");
+		if (pcm->changed & (1 << PROPERTY_VOLUME))
+			printf(",\"Volume\":%u", pcm->volume);
+		printf("}\n");
+
+	}
+	else {
+
+		if (pcm->changed & (1 << PROPERTY_CODEC))
+			printf("PropertyChanged %s Codec %s\n", pcm->path, pcm->codec);
+		if (pcm->changed & (1 << PROPERTY_DELAY))
+			printf("PropertyChanged %s Delay %u\n", pcm->path, pcm->delay);
+		if (pcm->changed & (1 << PROPERTY_RUNNING))
+			printf("PropertyChanged %s Running %s\n", pcm->path, pcm->running ? "true" : "false");
+		if (pcm->changed & (1 << PROPERTY_SOFTVOL))
+			printf("PropertyChanged %s SoftVolume %s\n", pcm->path, pcm->softvol ? "true" : "false");
+		if (pcm->changed & (1 << PROPERTY_VOLUME))
+			printf("PropertyChanged %s Volume 0x%.4X\n", pcm->path, pcm->volume);
+
+	}
+
+	pcm->changed = 0;
+
+}
+
+static void monitor_pcm_flush_all(void) {
+	for (size_t i = 0; i < monitor_pcms_len; i++)
+		monitor_pcm_flush(&monitor_pcms[i]);
+}
+
 static dbus_bool_t monitor_dbus_message_iter_get_pcm_props_cb(const char *key,
 		DBusMessageIter *value, void *userdata, DBusError *error) {
-	const char *path = userdata;
+	struct monitor_pcm *pcm = userdata;
 
 	char type;
 	if ((type = dbus_message_iter_get_arg_type(value)) != DBUS_TYPE_VARIANT) {
@@ -75,31 +215,36 @@ static dbus_bool_t monitor_dbus_message_iter_get_pcm_props_cb(const char *key,
 			goto fail;
 		const char *codec;
 		dbus_message_iter_get_basic(&variant, &codec);
-		printf("PropertyChanged %s Codec %s\n", path, codec);
+		strncpy(pcm->codec, codec, sizeof(pcm->codec) - 1);
+		pcm->changed |= 1 << PROPERTY_CODEC;
+	}
+	else if (monitor_properties_set[PROPERTY_DELAY].enabled &&
+			strcmp(key, monitor_properties_set[PROPERTY_DELAY].name) == 0) {
+		if (type != (type_expected = DBUS_TYPE_UINT16))
+			goto fail;
+		dbus_message_iter_get_basic(&variant, &pcm->delay);
+		pcm->changed |= 1 << PROPERTY_DELAY;
 	}
 	else if (monitor_properties_set[PROPERTY_RUNNING].enabled &&
 			strcmp(key, monitor_properties_set[PROPERTY_RUNNING].name) == 0) {
 		if (type != (type_expected = DBUS_TYPE_BOOLEAN))
 			goto fail;
-		dbus_bool_t running;
-		dbus_message_iter_get_basic(&variant, &running);
-		printf("PropertyChanged %s Running %s\n", path, running ? "true" : "false");
+		dbus_message_iter_get_basic(&variant, &pcm->running);
+		pcm->changed |= 1 << PROPERTY_RUNNING;
 	}
 	else if (monitor_properties_set[PROPERTY_SOFTVOL].enabled &&
 			strcmp(key, monitor_properties_set[PROPERTY_SOFTVOL].name) == 0) {
 		if (type != (type_expected = DBUS_TYPE_BOOLEAN))
 			goto fail;
-		dbus_bool_t softvol;
-		dbus_message_iter_get_basic(&variant, &softvol);
-		printf("PropertyChanged %s SoftVolume %s\n", path, softvol ? "true" : "false");
+		dbus_message_iter_get_basic(&variant, &pcm->softvol);
+		pcm->changed |= 1 << PROPERTY_SOFTVOL;
 	}
 	else if (monitor_properties_set[PROPERTY_VOLUME].enabled &&
 			strcmp(key, monitor_properties_set[PROPERTY_VOLUME].name) == 0) {
 		if (type != (type_expected = DBUS_TYPE_UINT16))
 			goto fail;
-		dbus_uint16_t volume;
-		dbus_message_iter_get_basic(&variant, &volume);
-		printf("PropertyChanged %s Volume 0x%.4X\n", path, volume);
+		dbus_message_iter_get_basic(&variant, &pcm->volume);
+		pcm->changed |= 1 << PROPERTY_VOLUME;
 	}
 
 	return TRUE;
@@ -153,9 +298,12 @@ static DBusHandlerResult dbus_signal_handler(DBusConnection *conn, DBusMessage *
 
 				if (strcmp(iface, BLUEALSA_INTERFACE_PCM) == 0) {
 
-					printf("PCMAdded %s\n", path);
+					monitor_print_event("PCMAdded", "path", path);
 
-					if (config.verbose) {
+					/* PCM properties are not printed in the JSON mode,
+					 * because they would break the one-record-per-line
+					 * output format. */
+					if (config.verbose && !monitor_json) {
 
 						DBusMessageIter iter2;
 						if (!dbus_message_iter_init(message, &iter2))
@@ -176,7 +324,7 @@ static DBusHandlerResult dbus_signal_handler(DBusConnection *conn, DBusMessage *
 
 				}
 				else if (strcmp(iface, BLUEALSA_INTERFACE_RFCOMM) == 0) {
-					printf("RFCOMMAdded %s\n", path);
+					monitor_print_event("RFCOMMAdded", "path", path);
 				}
 
 			}
@@ -195,10 +343,17 @@ static DBusHandlerResult dbus_signal_handler(DBusConnection *conn, DBusMessage *
 					goto fail;
 				dbus_message_iter_get_basic(&iter_ifaces, &iface);
 
-				if (strcmp(iface, BLUEALSA_INTERFACE_PCM) == 0)
-					printf("PCMRemoved %s\n", path);
+				if (strcmp(iface, BLUEALSA_INTERFACE_PCM) == 0) {
+					struct monitor_pcm *pcm;
+					/* print pending changes before the removal event */
+					if ((pcm = monitor_pcm_lookup(path, false)) != NULL) {
+						monitor_pcm_flush(pcm);
+						monitor_pcm_remove(pcm);
+					}
+					monitor_print_event("PCMRemoved", "path", path);
+				}
 				else if (strcmp(iface, BLUEALSA_INTERFACE_RFCOMM) == 0)
-					printf("RFCOMMRemoved %s\n", path);
+					monitor_print_event("RFCOMMRemoved", "path", path);
 
 			}
 
@@ -230,9 +385,13 @@ static DBusHandlerResult dbus_signal_handler(DBusConnection *conn, DBusMessage *
 				goto fail;
 
 			if (strlen(arg1) == 0)
-				printf("ServiceRunning %s\n", config.dbus.ba_service);
-			else if (strlen(arg2) == 0)
-				printf("ServiceStopped %s\n", config.dbus.ba_service);
+				monitor_print_event("ServiceRunning", "service", config.dbus.ba_service);
+			else if (strlen(arg2) == 0) {
+				monitor_pcm_flush_all();
+				while (monitor_pcms_len > 0)
+					monitor_pcm_remove(&monitor_pcms[0]);
+				monitor_print_event("ServiceStopped", "service", config.dbus.ba_service);
+			}
 			else
 				goto fail;
 
@@ -248,15 +407,25 @@ static DBusHandlerResult dbus_signal_handler(DBusConnection *conn, DBusMessage *
 
 		if (strcmp(updated_interface, BLUEALSA_INTERFACE_PCM) == 0) {
 
-			DBusError err = DBUS_ERROR_INIT;
+			struct monitor_pcm *pcm;
 			const char *path = dbus_message_get_path(message);
+			if ((pcm = monitor_pcm_lookup(path, true)) == NULL) {
+				error("Couldn't allocate PCM: %s", strerror(errno));
+				goto fail;
+			}
+
+			DBusError err = DBUS_ERROR_INIT;
 			if (!dbus_message_iter_dict(&iter, &err,
-						monitor_dbus_message_iter_get_pcm_props_cb, (void *)path)) {
+						monitor_dbus_message_iter_get_pcm_props_cb, pcm)) {
 				error("Unexpected D-Bus signal: %s", err.message);
 				dbus_error_free(&err);
 				goto fail;
 			}
 
+			/* without the interval every change is printed immediately */
+			if (monitor_interval_ms == 0)
+				monitor_pcm_flush(pcm);
+
 			return DBUS_HANDLER_RESULT_HANDLED;
 		}
 	}
@@ -300,22 +469,84 @@ static void usage(const char *command) {
 	cli_print_usage("%s [OPTION]...", command);
 	printf("\nOptions:\n"
 			"  -h, --help\t\t\tShow this message and exit\n"
+			"  -i, --interval=MS\t\tCoalesce property changes over MS milliseconds\n"
+			"  -j, --json\t\t\tPrint events as JSON records\n"
 			"  -p, --properties[=PROPS]\tShow PCM property changes\n"
 	);
 }
 
+/**
+ * Dispatch all D-Bus messages queued since the last call.
+ *
+ * @return This function returns false if the D-Bus connection was closed. */
+static bool monitor_dispatch_pending(void) {
+
+	struct pollfd fds[8];
+	nfds_t nfds;
+
+	/* Messages might have been already read from the socket by libdbus, in
+	 * which case poll() will not report them. Hence, always dispatch at least
+	 * once, and then continue as long as there is more data to read. */
+	do {
+		ba_dbus_connection_dispatch(&config.dbus);
+		if (!dbus_connection_get_is_connected(config.dbus.conn))
+			return false;
+		nfds = ARRAYSIZE(fds);
+		ba_dbus_connection_poll_fds(&config.dbus, fds, &nfds);
+	} while (poll(fds, nfds, 0) > 0);
+
+	return true;
+}
+
+/**
+ * Main loop of the coalescing mode.
+ *
+ * Instead of waking up for every D-Bus signal, the process sleeps for the
+ * whole interval and then processes all signals queued on the D-Bus socket
+ * in a single batch. Only the latest value of every property is printed. */
+static void monitor_interval_loop(void) {
+
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	for (;;) {
+
+		ts.tv_sec += monitor_interval_ms / 1000;
+		ts.tv_nsec += (monitor_interval_ms % 1000) * 1000000;
+		if (ts.tv_nsec >= 1000000000) {
+			ts.tv_nsec -= 1000000000;
+			ts.tv_sec++;
+		}
+
+		while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL) == EINTR)
+			continue;
+
+		bool connected = monitor_dispatch_pending();
+		monitor_pcm_flush_all();
+		if (!connected)
+			break;
+
+	}
+
+}
+
 static int cmd_monitor_func(int argc, char *argv[]) {
 
 	int opt;
-	const char *opts = "hqvp::";
+	const char *opts = "hqvi:jp::";
 	const struct option longopts[] = {
 		{ "help", no_argument, NULL, 'h' },
 		{ "quiet", no_argument, NULL, 'q' },
 		{ "verbose", no_argument, NULL, 'v' },
+		{ "interval", required_argument, NULL, 'i' },
+		{ "json", no_argument, NULL, 'j' },
 		{ "properties", optional_argument, NULL, 'p' },
 		{ 0 },
 	};
 
+	char *endptr;
+	unsigned long interval;
+
 	opterr = 0;
 	while ((opt = getopt_long(argc, argv, opts, longopts, NULL)) != -1) {
 		if (cli_parse_common_options(opt))
@@ -324,6 +555,17 @@ static int cmd_monitor_func(int argc, char *argv[]) {
 		case 'h' /* --help */ :
 			usage(argv[0]);
 			return EXIT_SUCCESS;
+		case 'i' /* --interval=MS */ :
+			interval = strtoul(optarg, &endptr, 10);
+			if (*optarg == '\0' || *endptr != '\0' || interval > 3600 * 1000) {
+				cmd_print_error("Invalid interval '%s'", optarg);
+				return EXIT_FAILURE;
+			}
+			monitor_interval_ms = interval;
+			break;
+		case 'j' /* --json */ :
+			monitor_json = true;
+			break;
 		case 'p' /* --properties[=PROPS] */ :
 			monitor_properties = true;
 			if (!parse_property_list(argv, optarg))
@@ -378,12 +620,15 @@ static int cmd_monitor_func(int argc, char *argv[]) {
 	}
 
 	if (running)
-		printf("ServiceRunning %s\n", config.dbus.ba_service);
+		monitor_print_event("ServiceRunning", "service", config.dbus.ba_service);
 	else
-		printf("ServiceStopped %s\n", config.dbus.ba_service);
+		monitor_print_event("ServiceStopped", "service", config.dbus.ba_service);
 
-	while (dbus_connection_read_write_dispatch(config.dbus.conn, -1))
-		continue;
+	if (monitor_interval_ms > 0)
+		monitor_interval_loop();
+	else
+		while (dbus_connection_read_write_dispatch(config.dbus.conn, -1))
+			continue;
 
 	return EXIT_SUCCESS;
 }
@@ -8,13 +8,19 @@
  *
  */
 
+#if HAVE_CONFIG_H
+# include <config.h>
+#endif
+
 #include <errno.h>
+#include <fcntl.h>
 #include <getopt.h>
 #include <stdbool.h>
 #include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <time.h>
 #include <unistd.h>
 
 #include <dbus/dbus.h>
@@ -23,30 +29,154 @@
 #include "shared/dbus-client-pcm.h"
 #include "shared/hex.h"
 
+struct transfer_stats {
+	/* time of the first transfer */
+	struct timespec ts0;
+	/* total number of transferred bytes */
+	size_t bytes;
+	/* number of transfer calls */
+	size_t transfers;
+	/* the longest time spent in a single transfer call */
+	uint64_t max_wait_ns;
+};
+
 static void usage(const char *command) {
 	printf("Transfer raw PCM data via stdin or stdout.\n\n");
 	cli_print_usage("%s [OPTION]... PCM-PATH", command);
 	printf("\nOptions:\n"
 			"  -h, --help\t\tShow this message and exit\n"
+			"  -s, --splice\t\tTransfer data with zero-copy splice()\n"
 			"  -x, --hex\t\tTransfer data in hexadecimal format\n"
 			"\nPositional arguments:\n"
 			"  PCM-PATH\tBlueALSA PCM D-Bus object path\n"
 	);
 }
 
+static uint64_t timestamp_ns(void) {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+/**
+ * Transfer data with read() and write() calls.
+ *
+ * @param argv Command arguments, used for error messages only.
+ * @return On end of input this function returns 0. If the output can not
+ *   be written any more, -1 is returned. */
+static int transfer_copy(char *argv[], int fd_input, int fd_output, bool hex) {
+
+	uint8_t buffer[4096];
+	uint8_t buffer_hex[sizeof(buffer) * 2 + 1];
+	ssize_t count;
+
+	while ((count = read(fd_input, buffer, sizeof(buffer))) > 0) {
+
+		const uint8_t *pos = buffer;
+		ssize_t written = 0;
+
+		if (hex) {
+
+			if (fd_input == STDIN_FILENO) {
+				if ((count = hex2bin((const char *)buffer, buffer, count)) == -1) {
+					cmd_print_error("Couldn't decode hex string: %s", strerror(errno));
+					continue;
+				}
+			}
+
+			if (fd_output == STDOUT_FILENO) {
+				count = bin2hex(buffer, (char *)buffer_hex, count);
+				pos = buffer_hex;
+			}
+
+		}
+
+		while (written < count) {
+			ssize_t res = write(fd_output, pos, count - written);
+			if (res <= 0) {
+				/* Cannot write any more, so just terminate */
+				return -1;
+			}
+			written += res;
+			pos += res;
+		}
+
+	}
+
+	return 0;
+}
+
+/**
+ * Transfer data with splice() calls.
+ *
+ * One of the descriptors is always the PCM FIFO, so the data can be moved
+ * between descriptors by the kernel without copying it to the user space.
+ *
+ * @return On end of input this function returns 0. Otherwise, -1 is returned
+ *   and errno is set to indicate the error. */
+static int transfer_splice(int fd_input, int fd_output, struct transfer_stats *stats) {
+
+	clock_gettime(CLOCK_MONOTONIC, &stats->ts0);
+
+	for (;;) {
+
+		const uint64_t t0 = timestamp_ns();
+		ssize_t ret;
+
+		if ((ret = splice(fd_input, NULL, fd_output, NULL, 64 * 1024,
+						SPLICE_F_MOVE | SPLICE_F_MORE)) == -1) {
+			if (errno == EINTR)
+				continue;
+			return -1;
+		}
+
+		if (ret == 0)
+			return 0;
+
+		const uint64_t wait = timestamp_ns() - t0;
+		if (wait > stats->max_wait_ns)
+			stats->max_wait_ns = wait;
+
+		stats->bytes += ret;
+		stats->transfers++;
+
+	}
+
+}
+
+static void print_transfer_stats(const struct transfer_stats *stats) {
+
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	const double duration = (ts.tv_sec - stats->ts0.tv_sec) +
+		(ts.tv_nsec - stats->ts0.tv_nsec) / 1e9;
+	const double throughput = duration > 0 ? stats->bytes / duration / 1024 : 0;
+	const double interval = stats->transfers > 0 ? duration * 1000 / stats->transfers : 0;
+
+	/* standard output might be used for audio data */
+	fprintf(stderr, "Transferred: %zu bytes in %.3f s (%.1f KiB/s)\n",
+			stats->bytes, duration, throughput);
+	fprintf(stderr, "Transfers: %zu, average interval: %.3f ms, max wait: %.3f ms\n",
+			stats->transfers, interval, stats->max_wait_ns / 1e6);
+
+}
+
 static int cmd_open_func(int argc, char *argv[]) {
 
 	int opt;
-	const char *opts = "hqvx";
+	const char *opts = "hqvsx";
 	const struct option longopts[] = {
 		{ "help", no_argument, NULL, 'h' },
 		{ "quiet", no_argument, NULL, 'q' },
 		{ "verbose", no_argument, NULL, 'v' },
+		{ "splice", no_argument, NULL, 's' },
 		{ "hex", no_argument, NULL, 'x' },
 		{ 0 },
 	};
 
 	bool hex = false;
+	bool use_splice = false;
 
 	opterr = 0;
 	while ((opt = getopt_long(argc, argv, opts, longopts, NULL)) != -1) {
@@ -56,6 +186,9 @@ static int cmd_open_func(int argc, char *argv[]) {
 		case 'h' /* --help */ :
 			usage(argv[0]);
 			return EXIT_SUCCESS;
+		case 's' /* --splice */ :
+			use_splice = true;
+			break;
 		case 'x' /* --hex */ :
 			hex = true;
 			break;
@@ -99,47 +232,31 @@ static int cmd_open_func(int argc, char *argv[]) {
 		fd_output = fd_pcm;
 	}
 
-	uint8_t buffer[4096];
-	uint8_t buffer_hex[sizeof(buffer) * 2 + 1];
-	ssize_t count;
-
-	while ((count = read(fd_input, buffer, sizeof(buffer))) > 0) {
-
-		const uint8_t *pos = buffer;
-		ssize_t written = 0;
-
-		if (hex) {
-
-			if (fd_input == STDIN_FILENO) {
-				if ((count = hex2bin((const char *)buffer, buffer, count)) == -1) {
-					cmd_print_error("Couldn't decode hex string: %s", strerror(errno));
-					continue;
-				}
-			}
-
-			if (fd_output == STDOUT_FILENO) {
-				count = bin2hex(buffer, (char *)buffer_hex, count);
-				pos = buffer_hex;
-			}
-
-		}
-
-		while (written < count) {
-			ssize_t res = write(fd_output, pos, count - written);
-			if (res <= 0) {
-				/* Cannot write any more, so just terminate */
-				goto finish;
-			}
-			written += res;
-			pos += res;
-		}
+	struct transfer_stats stats = { 0 };
+	bool spliced = false;
 
+	/* Hexadecimal conversion requires data in the user space, so in such
+	 * case the splice mode is ignored. It is also not possible to splice
+	 * to or from some file types (e.g. terminal), so we will fall back to
+	 * the copy mode if the very first splice() call fails with EINVAL. */
+	if (use_splice && !hex) {
+		int rv = transfer_splice(fd_input, fd_output, &stats);
+		if (rv == 0 || stats.transfers > 0 || errno != EINVAL)
+			spliced = true;
+		/* cannot transfer any more, so just terminate */
+		if (spliced && rv == -1)
+			goto finish;
 	}
 
+	if (!spliced && transfer_copy(argv, fd_input, fd_output, hex) == -1)
+		goto finish;
+
 	if (fd_output == fd_pcm)
 		ba_dbus_pcm_ctrl_send_drain(fd_pcm_ctrl, &err);
 
 finish:
+	if (spliced && !config.quiet)
+		print_transfer_stats(&stats);
 	close(fd_pcm);
 	close(fd_pcm_ctrl);
 	return EXIT_SUCCESS;
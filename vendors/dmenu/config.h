@@ -5,6 +5,7 @@
 static int topbar = 1;                      /* -b  option; if 0, dmenu appears at bottom     */
 static int centered = 1;                    /* -c option; centers dmenu on screen */
 static int min_width = 750;                    /* minimum width when centered */
+static int fuzzy = 0;                       /* -F option; fuzzy matching, best matches first */
 /* -fn option overrides fonts[0]; default X11 font or font set */
 static const char *fonts[] = {
 	"FiraMono Nerd Font:style=Regular:size:10",
@@ -1,6 +1,15 @@
 /* See LICENSE file for copyright and license details. */
+#include <sys/mman.h>
+#include <sys/stat.h>
+
 #include <ctype.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
 #include <locale.h>
+#include <poll.h>
+#include <pthread.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -15,14 +24,21 @@
 #include <X11/extensions/Xinerama.h>
 #endif
 #include <X11/Xft/Xft.h>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
 
 #include "drw.h"
+#include "index.h"
 #include "util.h"
 
 /* macros */
 #define INTERSECT(x,y,w,h,r)  (MAX(0, MIN((x)+(w),(r).x_org+(r).width)  - MAX((x),(r).x_org)) \
                              * MAX(0, MIN((y)+(h),(r).y_org+(r).height) - MAX((y),(r).y_org)))
 #define TEXTW(X)              (drw_fontset_getwidth(drw, (X)) + lrpad)
+#define MAXJOBS               16      /* threads filtering the items */
+#define MINJOB                8192    /* items worth a thread */
+#define RANKSTEP              128     /* fuzzy matches ranked at a time */
 
 /* enums */
 enum { SchemeNorm, SchemeSel, SchemeOut, SchemeCursor, SchemeLast }; /* color schemes */
@@ -33,6 +49,36 @@ struct item {
 	int out;
 };
 
+/* indices of the items matching a prefix of text, and their fuzzy scores */
+struct prefix {
+	size_t len;
+	size_t *v;
+	int *score;
+	size_t n;
+};
+
+/* a slice of the items filtered by one thread */
+struct job {
+	pthread_t tid;
+	const size_t *src;
+	size_t *dst;
+	int *score;
+	size_t from, to, n;
+	int tokc;
+};
+
+struct rank {
+	int score;
+	size_t i;
+};
+
+/* input lines are bump allocated in chunks and never freed one by one */
+struct chunk {
+	struct chunk *prev;
+	size_t len, siz;
+	char buf[];
+};
+
 typedef struct {
 	KeySym ksym;
 	unsigned int state;
@@ -40,13 +86,26 @@ typedef struct {
 
 static char text[BUFSIZ] = "";
 static char *embed;
+static const char *idxfile; /* -x option */
 static int bh, mw, mh;
 static int inputw = 0, promptw;
 static int lrpad; /* sum of left and right padding */
 static size_t cursor;
 static struct item *items = NULL;
+static size_t nitems, itemsiz;
+static struct chunk *arena;
+static size_t linestart; /* offset of the unterminated line in arena */
+static int inputeof;
+static char **tokv;
+static int tokn;
 static struct item *matches, *matchend;
 static struct item *prev, *curr, *next, *sel;
+static struct prefix *prefixes; /* each len is a prefix of the next one */
+static size_t nprefixes, prefixsiz;
+static char prefixtext[sizeof text]; /* text of the last prefix */
+static struct rank *rankv; /* fuzzy matches of the last prefix */
+static size_t rankn, ranksiz, ranktaken;
+static int njobs = 1;
 static int mon = -1, screen;
 static unsigned int using_vi_mode = 0;
 
@@ -83,6 +142,8 @@ appenditem(struct item *item, struct item **list, struct item **last)
 	*last = item;
 }
 
+static void rankmore(size_t k);
+
 static void
 calcoffsets(void)
 {
@@ -93,9 +154,12 @@ calcoffsets(void)
 	else
 		n = mw - (promptw + inputw + TEXTW("<") + TEXTW(">"));
 	/* calculate which items will begin the next page and previous page */
-	for (i = 0, next = curr; next; next = next->right)
+	for (i = 0, next = curr; next; next = next->right) {
+		if (!next->right)
+			rankmore(RANKSTEP);
 		if ((i += (lines > 0) ? bh : textw_clamp(next->text, n)) > n)
 			break;
+	}
 	for (i = 0, prev = curr; prev && prev->left; prev = prev->left)
 		if ((i += (lines > 0) ? bh : textw_clamp(prev->left->text, n)) > n)
 			break;
@@ -114,36 +178,99 @@ static void
 cleanup(void)
 {
 	size_t i;
+	struct chunk *c;
 
 	XUngrabKey(dpy, AnyKey, AnyModifier, root);
 	for (i = 0; i < SchemeLast; i++)
 		free(scheme[i]);
-	for (i = 0; items && items[i].text; ++i)
-		free(items[i].text);
+	while (arena) {
+		c = arena->prev;
+		free(arena);
+		arena = c;
+	}
 	free(items);
+	for (i = 0; i < nprefixes; i++) {
+		free(prefixes[i].v);
+		free(prefixes[i].score);
+	}
+	free(prefixes);
+	free(rankv);
 	drw_free(drw);
 	XSync(dpy, False);
 	XCloseDisplay(dpy);
 }
 
+/*
+ * find n in h, comparing ASCII letters case-insensitively if fold is set.
+ * candidates are the positions where the first and last byte of n match,
+ * found 16 at a time with SSE2 when available.
+ */
 static char *
-cistrstr(const char *h, const char *n)
+memfind(const char *h, size_t hlen, const char *n, size_t nlen, int fold)
 {
-	size_t i;
+	size_t i = 0, j, last;
+	unsigned char f, l, fm = 0, lm = 0;
+#ifdef __SSE2__
+	__m128i vf, vl, vfm, vlm, eq;
+	unsigned int mask;
+#endif
 
-	if (!n[0])
+	if (!nlen)
 		return (char *)h;
-
-	for (; *h; ++h) {
-		for (i = 0; n[i] && tolower((unsigned char)n[i]) ==
-		            tolower((unsigned char)h[i]); ++i)
-			;
-		if (n[i] == '\0')
-			return (char *)h;
+	if (nlen > hlen)
+		return NULL;
+	last = hlen - nlen;
+
+	/* or-ing 0x20 maps an upper case letter to its lower case */
+	f = n[0];
+	l = n[nlen - 1];
+	if (fold && isalpha(f))
+		f |= fm = 0x20;
+	if (fold && isalpha(l))
+		l |= lm = 0x20;
+
+#ifdef __SSE2__
+	vf = _mm_set1_epi8(f);
+	vl = _mm_set1_epi8(l);
+	vfm = _mm_set1_epi8(fm);
+	vlm = _mm_set1_epi8(lm);
+	for (; last >= 15; i += 16) {
+		if (i > last - 15)
+			i = last - 15; /* overlap the previous block, no scalar tail */
+		eq = _mm_and_si128(
+			_mm_cmpeq_epi8(_mm_or_si128(_mm_loadu_si128(
+				(const __m128i *)(h + i)), vfm), vf),
+			_mm_cmpeq_epi8(_mm_or_si128(_mm_loadu_si128(
+				(const __m128i *)(h + i + nlen - 1)), vlm), vl));
+		for (mask = _mm_movemask_epi8(eq); mask; mask &= mask - 1) {
+			j = i + __builtin_ctz(mask);
+			if (nlen <= 2 || (fold
+			    ? !strncasecmp(h + j + 1, n + 1, nlen - 2)
+			    : !memcmp(h + j + 1, n + 1, nlen - 2)))
+				return (char *)h + j;
+		}
+		if (i == last - 15)
+			return NULL;
+	}
+#endif
+	for (; i <= last; i++) {
+		if (((unsigned char)h[i] | fm) != f ||
+		    ((unsigned char)h[i + nlen - 1] | lm) != l)
+			continue;
+		if (nlen <= 2 || (fold
+		    ? !strncasecmp(h + i + 1, n + 1, nlen - 2)
+		    : !memcmp(h + i + 1, n + 1, nlen - 2)))
+			return (char *)h + i;
 	}
 	return NULL;
 }
 
+static char *
+cistrstr(const char *h, const char *n)
+{
+	return memfind(h, strlen(h), n, strlen(n), 1);
+}
+
 static int
 drawitem(struct item *item, int x, int y, int w)
 {
@@ -249,32 +376,232 @@ grabkeyboard(void)
 	die("cannot grab keyboard");
 }
 
-static void
-match(void)
+static int
+tokenize(char *buf)
 {
-	static char **tokv = NULL;
-	static int tokn = 0;
+	char *s;
+	int tokc = 0;
 
-	char buf[sizeof text], *s;
-	int i, tokc = 0;
-	size_t len, textsize;
-	struct item *item, *lprefix, *lsubstr, *prefixend, *substrend;
-
-	strcpy(buf, text);
 	/* separate input text into tokens to be matched individually */
 	for (s = strtok(buf, " "); s; tokv[tokc - 1] = s, s = strtok(NULL, " "))
 		if (++tokc > tokn && !(tokv = realloc(tokv, ++tokn * sizeof *tokv)))
 			die("cannot realloc %zu bytes:", tokn * sizeof *tokv);
-	len = tokc ? strlen(tokv[0]) : 0;
+	return tokc;
+}
 
-	matches = lprefix = lsubstr = matchend = prefixend = substrend = NULL;
-	textsize = strlen(text) + 1;
-	for (item = items; item && item->text; item++) {
-		for (i = 0; i < tokc; i++)
-			if (!fstrstr(item->text, tokv[i]))
+static int
+isdelim(int c)
+{
+	return c == '/' || c == ',' || c == ':' || c == ';' || c == '|';
+}
+
+/* bonus for matching s[k], higher at the start of words */
+static int
+bonus(const char *s, size_t k)
+{
+	int c = (unsigned char)s[k], prev = k ? (unsigned char)s[k - 1] : ' ';
+
+	if (!isalnum(c))
+		return 0;
+	if (isspace(prev))
+		return 10;
+	if (isdelim(prev))
+		return 9;
+	if (!isalnum(prev))
+		return 8;
+	if ((islower(prev) && isupper(c)) || (!isdigit(prev) && isdigit(c)))
+		return 7; /* camelCase or a number */
+	return 0;
+}
+
+/*
+ * score the shortest occurrence of the subsequence pat ending at the first
+ * place it completes, or return -1. every matched byte scores 16 plus its
+ * bonus, doubled for the first one, and runs of matched bytes keep the
+ * bonus of their first byte; gaps cost 3 for their first byte, then 1.
+ */
+static int
+fuzzyscore(const char *s, const char *pat, int fold)
+{
+	size_t k, start, end, pi, plen = strlen(pat);
+	int sc = 0, b, run = 0, gap = 0;
+
+#define EQ(a, b) ((a) == (b) || (fold && tolower((unsigned char)(a)) == tolower((unsigned char)(b))))
+	for (k = pi = 0; s[k] && pi < plen; k++)
+		if (EQ(s[k], pat[pi]))
+			pi++;
+	if (pi < plen)
+		return -1;
+	end = k;
+	for (k = end, pi = plen; pi; k--)
+		if (EQ(s[k - 1], pat[pi - 1]))
+			pi--;
+	start = k;
+	for (k = start, pi = 0; k < end; k++) {
+		if (pi < plen && EQ(s[k], pat[pi])) {
+			b = bonus(s, k);
+			if (run)
+				b = MAX(b, MAX(run, 4));
+			else
+				run = b;
+			sc += 16 + (pi++ ? b : 2 * b);
+			gap = 0;
+		} else {
+			sc -= gap ? 1 : 3;
+			gap = 1;
+			run = 0;
+		}
+	}
+#undef EQ
+	return sc;
+}
+
+static void *
+filterjob(void *arg)
+{
+	struct job *job = arg;
+	size_t j, idx;
+	int i, sc, tsc = 0, fold = fstrstr == cistrstr;
+	const char *t;
+
+	for (j = job->from; j < job->to; j++) {
+		idx = job->src ? job->src[j] : j;
+		t = items[idx].text;
+		for (i = sc = 0; i < job->tokc; i++) {
+			if (job->score ? (tsc = fuzzyscore(t, tokv[i], fold)) < 0
+			               : !fstrstr(t, tokv[i]))
 				break;
-		if (i != tokc) /* not all tokens match */
+			sc += job->score ? tsc : 0;
+		}
+		if (i < job->tokc)
 			continue;
+		if (job->score) /* all tokens match */
+			job->score[job->n] = sc;
+		job->dst[job->n++] = idx;
+	}
+	return NULL;
+}
+
+/*
+ * store the indices of the items matching all tokens in dst, with their
+ * scores if score is set. large inputs are split between threads, each
+ * filling the part of dst that matches its slice before it is compacted.
+ */
+static size_t
+filter(size_t *dst, int *score, const size_t *src, size_t from, size_t to, int tokc)
+{
+	struct job jobs[MAXJOBS];
+	size_t n, k, m = MAX(1, MIN((size_t)njobs, (to - from) / MINJOB));
+
+	for (k = 0; k < m; k++) {
+		jobs[k] = (struct job){
+			.src = src, .tokc = tokc,
+			.from = from + (to - from) * k / m,
+			.to = from + (to - from) * (k + 1) / m,
+		};
+		jobs[k].dst = dst + (jobs[k].from - from);
+		jobs[k].score = score ? score + (jobs[k].from - from) : NULL;
+		if (k && pthread_create(&jobs[k].tid, NULL, filterjob, &jobs[k]))
+			jobs[k].tid = pthread_self();
+	}
+	for (k = 0; k < m; k++) {
+		if (!k || pthread_equal(jobs[k].tid, pthread_self()))
+			filterjob(&jobs[k]);
+		else
+			pthread_join(jobs[k].tid, NULL);
+	}
+	for (k = 0, n = 0; k < m; n += jobs[k++].n) {
+		memmove(dst + n, jobs[k].dst, jobs[k].n * sizeof *dst);
+		if (score)
+			memmove(score + n, jobs[k].score, jobs[k].n * sizeof *score);
+	}
+	return n;
+}
+
+/* best scores first, then input order */
+static int
+rankcmp(const void *a, const void *b)
+{
+	const struct rank *ra = a, *rb = b;
+
+	if (ra->score != rb->score)
+		return ra->score > rb->score ? -1 : 1;
+	return (ra->i > rb->i) - (ra->i < rb->i);
+}
+
+/* move the k best of the n ranks to the front, in no particular order */
+static void
+rankselect(struct rank *r, size_t n, size_t k)
+{
+	size_t lo = 0, hi = n, i, j;
+	struct rank t;
+
+	while (hi - lo > 1) {
+		t = r[lo + (hi - lo) / 2];
+		r[lo + (hi - lo) / 2] = r[hi - 1];
+		r[hi - 1] = t;
+		for (i = j = lo; j < hi - 1; j++) {
+			if (rankcmp(&r[j], &r[hi - 1]) < 0) {
+				t = r[i];
+				r[i++] = r[j];
+				r[j] = t;
+			}
+		}
+		t = r[i];
+		r[i] = r[hi - 1];
+		r[hi - 1] = t;
+		if (i == k)
+			break;
+		else if (i < k)
+			lo = i + 1;
+		else
+			hi = i;
+	}
+}
+
+/* append the next k fuzzy matches, in order, to the list of matches */
+static void
+rankmore(size_t k)
+{
+	struct rank *r = rankv + ranktaken;
+	size_t j, n = rankn - ranktaken;
+
+	if (!(k = MIN(k, n)))
+		return;
+	if (k < n)
+		rankselect(r, n, k);
+	qsort(r, k, sizeof *r, rankcmp);
+	for (j = 0; j < k; j++)
+		appenditem(&items[r[j].i], &matches, &matchend);
+	ranktaken += k;
+}
+
+static void
+matchlist(int tokc)
+{
+	size_t j, len, textsize;
+	struct item *item, *lprefix, *lsubstr, *prefixend, *substrend;
+	struct prefix *p;
+
+	/* after match() the last prefix is text, unless it has no tokens */
+	p = tokc ? &prefixes[nprefixes - 1] : NULL;
+	len = tokc ? strlen(tokv[0]) : 0;
+	textsize = strlen(text) + 1;
+
+	matches = lprefix = lsubstr = matchend = prefixend = substrend = NULL;
+	rankn = ranktaken = 0;
+	if (fuzzy && tokc) {
+		/* only the matches that are shown get sorted */
+		if (p->n > ranksiz && !(rankv = realloc(rankv, (ranksiz = p->n) * sizeof *rankv)))
+			die("cannot realloc %zu bytes:", ranksiz * sizeof *rankv);
+		for (j = 0; j < p->n; j++)
+			rankv[j] = (struct rank){ p->score[j], p->v[j] };
+		rankn = p->n;
+		rankmore(RANKSTEP);
+		return;
+	}
+	for (j = 0; j < (p ? p->n : nitems); j++) {
+		item = &items[p ? p->v[j] : j];
 		/* exact matches go first, then prefixes, then substrings */
 		if (!tokc || !fstrncmp(text, item->text, textsize))
 			appenditem(item, &matches, &matchend);
@@ -299,10 +626,83 @@ match(void)
 			matches = lsubstr;
 		matchend = substrend;
 	}
+}
+
+static void
+match(void)
+{
+	char buf[sizeof text];
+	int tokc;
+	size_t n, textlen;
+	struct prefix *p;
+
+	strcpy(buf, text);
+	tokc = tokenize(buf);
+	textlen = strlen(text);
+
+	/*
+	 * whatever matches text also matches its prefixes, so only the
+	 * matches of the longest cached prefix need to be filtered.
+	 */
+	while (nprefixes && (prefixes[nprefixes - 1].len > textlen ||
+	       strncmp(prefixtext, text, prefixes[nprefixes - 1].len))) {
+		free(prefixes[--nprefixes].v);
+		free(prefixes[nprefixes].score);
+	}
+	p = nprefixes ? &prefixes[nprefixes - 1] : NULL;
+	if (tokc && !(p && p->len == textlen)) {
+		n = p ? p->n : nitems;
+		if (nprefixes == prefixsiz && !(prefixes = realloc(prefixes,
+		    (prefixsiz += 16) * sizeof *prefixes)))
+			die("cannot realloc %zu bytes:", prefixsiz * sizeof *prefixes);
+		p = &prefixes[nprefixes++];
+		if (!(p->v = malloc((n ? n : 1) * sizeof *p->v)))
+			die("cannot malloc %zu bytes:", n * sizeof *p->v);
+		p->score = NULL;
+		if (fuzzy && !(p->score = malloc((n ? n : 1) * sizeof *p->score)))
+			die("cannot malloc %zu bytes:", n * sizeof *p->score);
+		p->n = nprefixes > 1
+		     ? filter(p->v, p->score, p[-1].v, 0, p[-1].n, tokc)
+		     : filter(p->v, p->score, NULL, 0, nitems, tokc);
+		p->len = textlen;
+		strcpy(prefixtext, text);
+	}
+
+	matchlist(tokc);
 	curr = sel = matches;
 	calcoffsets();
 }
 
+/* match the items from index from on, which arrived after match() */
+static void
+matchnew(size_t from)
+{
+	char buf[sizeof text];
+	int tokc;
+	size_t k, a = from, b = nitems, n;
+	struct prefix *p;
+
+	for (k = 0; k < nprefixes; k++) {
+		p = &prefixes[k];
+		memcpy(buf, prefixtext, p->len);
+		buf[p->len] = '\0';
+		tokc = tokenize(buf);
+		/* new matches of a prefix are among the new matches of the one before */
+		n = p->n;
+		if (b > a && !(p->v = realloc(p->v, (n + b - a) * sizeof *p->v)))
+			die("cannot realloc %zu bytes:", (n + b - a) * sizeof *p->v);
+		if (b > a && p->score && !(p->score = realloc(p->score, (n + b - a) * sizeof *p->score)))
+			die("cannot realloc %zu bytes:", (n + b - a) * sizeof *p->score);
+		p->n += k ? filter(p->v + n, p->score ? p->score + n : NULL, p[-1].v, a, b, tokc)
+		          : filter(p->v + n, p->score ? p->score + n : NULL, NULL, a, b, tokc);
+		a = n;
+		b = p->n;
+	}
+
+	strcpy(buf, text);
+	matchlist(tokenize(buf));
+}
+
 static void
 insert(const char *str, ssize_t n)
 {
@@ -407,6 +807,7 @@ vi_keypress(KeySym ksym, const XKeyEvent *ev)
 		calcoffsets();
 		break;
 	case XK_G:
+		rankmore(SIZE_MAX);
 		if (next) {
 			/* jump to end of list and position items in reverse */
 			curr = matchend;
@@ -644,6 +1045,7 @@ insert:
 			cursor = strlen(text);
 			break;
 		}
+		rankmore(SIZE_MAX);
 		if (next) {
 			/* jump to end of list and position items in reverse */
 			curr = matchend;
@@ -757,39 +1159,175 @@ paste(void)
 	drawmenu();
 }
 
+static void
+additem(char *text)
+{
+	if (nitems + 1 >= itemsiz) {
+		itemsiz = itemsiz ? itemsiz * 2 : 256;
+		if (!(items = realloc(items, itemsiz * sizeof(*items))))
+			die("cannot realloc %zu bytes:", itemsiz * sizeof(*items));
+	}
+	items[nitems].text = text;
+	items[nitems].out = 0;
+	items[++nitems].text = NULL;
+}
+
+/* start a new chunk, taking along the unterminated line */
+static void
+growarena(void)
+{
+	struct chunk *c;
+	size_t part = arena ? arena->len - linestart : 0;
+	size_t siz = MAX(1 << 16, 2 * part);
+
+	if (!(c = malloc(sizeof(*c) + siz)))
+		die("cannot malloc %zu bytes:", sizeof(*c) + siz);
+	c->prev = arena;
+	c->siz = siz;
+	c->len = part;
+	if (arena) {
+		memcpy(c->buf, arena->buf + linestart, part);
+		arena->len = linestart;
+		if (!linestart) { /* no line ended in it */
+			c->prev = arena->prev;
+			free(arena);
+		}
+	}
+	arena = c;
+	linestart = 0;
+}
+
+/*
+ * read the lines available on stdin, or up to 1 MiB of them to keep
+ * the menu responsive. only a tty blocks.
+ */
 static void
 readstdin(void)
 {
-	char *line = NULL;
-	size_t i, itemsiz = 0, linesiz = 0;
-	ssize_t len;
-
-	/* read each line from stdin and add it to the item list */
-	for (i = 0; (len = getline(&line, &linesiz, stdin)) != -1; i++) {
-		if (i + 1 >= itemsiz) {
-			itemsiz += 256;
-			if (!(items = realloc(items, itemsiz * sizeof(*items))))
-				die("cannot realloc %zu bytes:", itemsiz * sizeof(*items));
+	char *p, *e;
+	ssize_t n;
+	size_t total = 0;
+
+	while (!inputeof && total < 1 << 20) {
+		if (!arena || arena->len == arena->siz)
+			growarena();
+		n = read(STDIN_FILENO, arena->buf + arena->len, arena->siz - arena->len);
+		if (n < 0 && errno == EINTR)
+			continue;
+		if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+			break;
+		if (n < 0)
+			die("read:");
+		if (n == 0) {
+			inputeof = 1;
+			if (arena->len == linestart)
+				break;
+			/* the last line has no newline */
+			if (arena->len == arena->siz)
+				growarena();
+			arena->buf[arena->len++] = '\0';
+			additem(arena->buf + linestart);
+			linestart = arena->len;
+			break;
+		}
+		p = arena->buf + arena->len;
+		e = p + n;
+		arena->len += n;
+		total += n;
+		for (; (p = memchr(p, '\n', e - p)); p++) {
+			*p = '\0';
+			additem(arena->buf + linestart);
+			linestart = p + 1 - arena->buf;
 		}
-		if (line[len - 1] == '\n')
-			line[len - 1] = '\0';
-		if (!(items[i].text = strdup(line)))
-			die("strdup:");
+	}
+}
+
+/* take the items from an index written by stest -i, without copying them */
+static void
+readindex(void)
+{
+	const struct idxent *e;
+	const char *p;
+	size_t i, len;
+
+	if (!(p = idxmap(idxfile, &len)))
+		die("%s: not an index written by stest -i", idxfile);
+	e = IDXENTS(p);
+	for (i = 0; i < IDXHDR(p)->nent; i++)
+		if (!i || e[i].name != e[i - 1].name)
+			additem((char *)p + e[i].name);
+	inputeof = 1;
+}
+
+/* read enough lines to know the height of the menu */
+static void
+readlines(void)
+{
+	struct pollfd pfd = { .fd = STDIN_FILENO, .events = POLLIN };
+
+	readstdin();
+	while (!inputeof && (isatty(0) || (lines > 0 && nitems < (size_t)lines))) {
+		if (poll(&pfd, 1, -1) < 0 && errno != EINTR)
+			die("poll:");
+		readstdin();
+	}
+	if (lines > 0 && nitems < (size_t)lines)
+		lines = nitems;
+}
 
-		items[i].out = 0;
+/* read more of stdin while the menu is shown and update the matches */
+static void
+streamstdin(void)
+{
+	struct item *item;
+	ptrdiff_t s = sel ? sel - items : -1, c = curr ? curr - items : -1;
+	size_t from = nitems;
+
+	readstdin();
+	if (nitems == from)
+		return;
+	/* items may have moved, the lists are rebuilt by matchnew() */
+	matchnew(from);
+	sel = s >= 0 ? &items[s] : matches;
+	curr = c >= 0 ? &items[c] : matches;
+	if (rankn) {
+		/* the ranking changed, only the selection is kept */
+		for (item = matches; item && item != sel; item = item->right)
+			if (!item->right)
+				rankmore(RANKSTEP);
+		curr = sel;
 	}
-	free(line);
-	if (items)
-		items[i].text = NULL;
-	lines = MIN(lines, i);
+	calcoffsets();
+	for (item = curr; item && item != next && item != sel; item = item->right)
+		;
+	if (item != sel) {
+		curr = sel;
+		calcoffsets();
+	}
+	drawmenu();
 }
 
 static void
 run(void)
 {
 	XEvent ev;
-
-	while (!XNextEvent(dpy, &ev)) {
+	struct pollfd pfd[] = {
+		{ .fd = ConnectionNumber(dpy), .events = POLLIN },
+		{ .fd = STDIN_FILENO, .events = POLLIN },
+	};
+
+	for (;;) {
+		/* keep reading stdin until EOF, between X events */
+		if (!inputeof && !XPending(dpy)) {
+			if (poll(pfd, LENGTH(pfd), -1) < 0 && errno != EINTR)
+				die("poll:");
+			if (pfd[1].revents)
+				streamstdin();
+			if (!XPending(dpy))
+				continue;
+		}
+		if (XNextEvent(dpy, &ev))
+			break;
 		if (XFilterEvent(&ev, win))
 			continue;
 		switch(ev.type) {
@@ -944,8 +1482,9 @@ setup(void)
 static void
 usage(void)
 {
-	die("usage: dmenu [-bfiv] [-l lines] [-p prompt] [-fn font] [-m monitor]\n"
-	    "             [-nb color] [-nf color] [-sb color] [-sf color] [-w windowid]");
+	die("usage: dmenu [-bfiFv] [-l lines] [-p prompt] [-fn font] [-m monitor]\n"
+	    "             [-nb color] [-nf color] [-sb color] [-sf color] [-w windowid]\n"
+	    "             [-x index]");
 }
 
 int
@@ -965,6 +1504,8 @@ main(int argc, char *argv[])
 			fast = 1;
 		else if (!strcmp(argv[i], "-c"))   /* centers dmenu on screen */
 			centered = 1;
+		else if (!strcmp(argv[i], "-F"))   /* fuzzy matching, best matches first */
+			fuzzy = 1;
 		else if (!strcmp(argv[i], "-i")) { /* case-insensitive item matching */
 			fstrncmp = strncasecmp;
 			fstrstr = cistrstr;
@@ -992,6 +1533,8 @@ main(int argc, char *argv[])
 			colors[SchemeSel][ColBg] = argv[++i];
 		else if (!strcmp(argv[i], "-sf"))  /* selected foreground color */
 			colors[SchemeSel][ColFg] = argv[++i];
+		else if (!strcmp(argv[i], "-x"))   /* items from an stest index */
+			idxfile = argv[++i];
 		else if (!strcmp(argv[i], "-w"))   /* embedding window id */
 			embed = argv[++i];
 		else if (!strcmp(argv[i], "-bw"))
@@ -1020,11 +1563,17 @@ main(int argc, char *argv[])
 		die("pledge");
 #endif
 
+	njobs = MAX(1, MIN(MAXJOBS, sysconf(_SC_NPROCESSORS_ONLN)));
+	/* a tty is read up to EOF, a pipe as lines arrive */
+	if (idxfile)
+		readindex();
+	else if (!isatty(0) && fcntl(0, F_SETFL, fcntl(0, F_GETFL) | O_NONBLOCK) < 0)
+		die("fcntl:");
 	if (fast && !isatty(0)) {
 		grabkeyboard();
-		readstdin();
+		readlines();
 	} else {
-		readstdin();
+		readlines();
 		grabkeyboard();
 	}
 	setup();
@@ -0,0 +1,77 @@
+/* See LICENSE file for copyright and license details. */
+
+/*
+ * index of files written by stest -i and read by dmenu -x. the file is
+ * mapped as is: a header, the directories, then the entries sorted by
+ * name and directory, and the NUL-terminated strings they point to.
+ * entries with the same name share the same string.
+ */
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include <fcntl.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+
+#define IDXMAGIC "stx1"
+
+struct idxhdr {
+	char magic[4];
+	uint32_t ndir, nent, size;
+};
+
+struct idxdir {
+	int64_t sec, nsec; /* mtime of the directory when it was read, or -1 */
+	uint32_t path, pad;
+};
+
+struct idxent {
+	uint32_t name, dir;
+};
+
+#define IDXHDR(p)  ((const struct idxhdr *)(p))
+#define IDXDIRS(p) ((const struct idxdir *)((p) + sizeof(struct idxhdr)))
+#define IDXENTS(p) ((const struct idxent *)(IDXDIRS(p) + IDXHDR(p)->ndir))
+
+/* map an index read-only, or return NULL if it is missing or malformed */
+static const char *
+idxmap(const char *file, size_t *len)
+{
+	const struct idxhdr *h;
+	const struct idxdir *d;
+	const struct idxent *e;
+	struct stat st;
+	const char *p;
+	size_t i, base;
+	int fd;
+
+	if ((fd = open(file, O_RDONLY)) < 0)
+		return NULL;
+	if (fstat(fd, &st) < 0 || (size_t)st.st_size < sizeof *h ||
+	    (p = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0)) == MAP_FAILED) {
+		close(fd);
+		return NULL;
+	}
+	close(fd);
+
+	h = IDXHDR(p);
+	d = IDXDIRS(p);
+	e = IDXENTS(p);
+	base = sizeof *h + h->ndir * sizeof *d + (size_t)h->nent * sizeof *e;
+	if (memcmp(h->magic, IDXMAGIC, sizeof h->magic) || h->size != (size_t)st.st_size ||
+	    base >= h->size || p[h->size - 1] != '\0')
+		goto bad;
+	for (i = 0; i < h->ndir; i++)
+		if (d[i].path < base || d[i].path >= h->size)
+			goto bad;
+	for (i = 0; i < h->nent; i++)
+		if (e[i].name < base || e[i].name >= h->size || e[i].dir >= h->ndir)
+			goto bad;
+	*len = h->size;
+	return p;
+bad:
+	munmap((void *)p, st.st_size);
+	return NULL;
+}
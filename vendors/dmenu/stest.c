@@ -1,24 +1,51 @@
 /* See LICENSE file for copyright and license details. */
+#include <sys/mman.h>
 #include <sys/stat.h>
+#ifdef __linux__
+#include <sys/inotify.h>
+#endif
 
 #include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
 #include <limits.h>
+#include <poll.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <unistd.h>
 
 #include "arg.h"
+#include "index.h"
 char *argv0;
 
 #define FLAG(x)  (flag[(x)-'a'])
 
+/* a directory kept in the index and the names that passed in it */
+struct dir {
+	const char *path;
+	int64_t sec, nsec;
+	char **v;
+	size_t n, siz;
+};
+
+/* a name in the index being written */
+struct ent {
+	const char *name;
+	uint32_t dir;
+};
+
+static void addname(struct dir *, const char *);
 static void test(const char *, const char *);
 static void usage(void);
 
 static int match = 0;
 static int flag[26];
 static struct stat old, new;
+static const char *idxfile; /* -i option */
+static struct dir *dirs, *cur;
+static size_t ndirs;
 
 static void
 test(const char *path, const char *name)
@@ -41,18 +68,288 @@ test(const char *path, const char *name)
 	&& (!FLAG('u') || st.st_mode & S_ISUID)                       /* set-user-id flag  */
 	&& (!FLAG('w') || access(path, W_OK) == 0)                    /* writable          */
 	&& (!FLAG('x') || access(path, X_OK) == 0)) != FLAG('v')) {   /* executable        */
-		if (FLAG('q'))
+		if (cur)
+			addname(cur, name);
+		else if (FLAG('q'))
 			exit(0);
+		else
+			puts(name);
 		match = 1;
-		puts(name);
 	}
 }
 
+static void
+fail(const char *s)
+{
+	perror(s);
+	exit(2);
+}
+
+static void
+addname(struct dir *d, const char *name)
+{
+	if (d->n == d->siz && !(d->v = realloc(d->v, (d->siz = d->siz ? 2 * d->siz : 64) * sizeof *d->v)))
+		fail("realloc");
+	if (!(d->v[d->n++] = strdup(name)))
+		fail("strdup");
+}
+
+static void
+mtime(const char *path, int64_t *sec, int64_t *nsec)
+{
+	struct stat st;
+
+	if (stat(path, &st) < 0) {
+		*sec = *nsec = -1;
+	} else {
+		*sec = st.st_mtim.tv_sec;
+		*nsec = st.st_mtim.tv_nsec;
+	}
+}
+
+/* test the contents of d again */
+static void
+scan(struct dir *d)
+{
+	struct dirent *e;
+	char path[PATH_MAX];
+	DIR *dir;
+	int r;
+
+	while (d->n)
+		free(d->v[--d->n]);
+	mtime(d->path, &d->sec, &d->nsec);
+	if (!(dir = opendir(d->path)))
+		return;
+	cur = d;
+	while ((e = readdir(dir))) {
+		r = snprintf(path, sizeof path, "%s/%s", d->path, e->d_name);
+		if (r >= 0 && (size_t)r < sizeof path)
+			test(path, e->d_name);
+	}
+	cur = NULL;
+	closedir(dir);
+}
+
+/* take the names of the directories from the old index, if there is one */
+static int
+loadindex(void)
+{
+	const struct idxdir *od;
+	const struct idxent *oe;
+	const char *p;
+	size_t i, j, k, len;
+
+	if (!(p = idxmap(idxfile, &len)))
+		return 0;
+	od = IDXDIRS(p);
+	oe = IDXENTS(p);
+	for (i = 0; i < ndirs; i++) {
+		for (j = 0; j < IDXHDR(p)->ndir && strcmp(p + od[j].path, dirs[i].path); j++)
+			;
+		if (j == IDXHDR(p)->ndir)
+			continue;
+		dirs[i].sec = od[j].sec;
+		dirs[i].nsec = od[j].nsec;
+		for (k = 0; k < IDXHDR(p)->nent; k++)
+			if (oe[k].dir == j)
+				addname(&dirs[i], p + oe[k].name);
+	}
+	munmap((void *)p, len);
+	return 1;
+}
+
+/* read the directories changed since they were last read */
+static int
+update(void)
+{
+	int64_t sec, nsec;
+	size_t i;
+	int changed = 0;
+
+	for (i = 0; i < ndirs; i++) {
+		mtime(dirs[i].path, &sec, &nsec);
+		if (sec == dirs[i].sec && nsec == dirs[i].nsec)
+			continue;
+		scan(&dirs[i]);
+		changed = 1;
+	}
+	return changed;
+}
+
+static int
+entcmp(const void *a, const void *b)
+{
+	const struct ent *ea = a, *eb = b;
+	int r = strcmp(ea->name, eb->name);
+
+	return r ? r : (ea->dir > eb->dir) - (ea->dir < eb->dir);
+}
+
+/* write the index next to idxfile and move it in place */
+static void
+writeindex(void)
+{
+	struct idxhdr h;
+	struct idxdir d = { 0 };
+	struct idxent e;
+	struct ent *v;
+	size_t i, j, n = 0;
+	uint64_t off;
+	char tmp[PATH_MAX];
+	FILE *fp;
+	int fd;
+
+	for (i = 0; i < ndirs; i++)
+		n += dirs[i].n;
+	if (!(v = malloc((n ? n : 1) * sizeof *v)))
+		fail("malloc");
+	for (i = n = 0; i < ndirs; i++)
+		for (j = 0; j < dirs[i].n; j++)
+			v[n++] = (struct ent){ dirs[i].v[j], i };
+	qsort(v, n, sizeof *v, entcmp);
+
+	if (snprintf(tmp, sizeof tmp, "%s.XXXXXX", idxfile) >= (int)sizeof tmp)
+		fail(idxfile);
+	if ((fd = mkstemp(tmp)) < 0 || !(fp = fdopen(fd, "w")))
+		fail(tmp);
+	memset(&h, 0, sizeof h);
+	memcpy(h.magic, IDXMAGIC, sizeof h.magic);
+	h.ndir = ndirs;
+	h.nent = n;
+	off = sizeof h + ndirs * sizeof d + n * sizeof e;
+	for (i = 0; i < ndirs; i++)
+		off += strlen(dirs[i].path) + 1;
+	for (i = 0; i < n; i++)
+		if (!i || strcmp(v[i].name, v[i - 1].name))
+			off += strlen(v[i].name) + 1;
+	if (off > UINT32_MAX) {
+		errno = EFBIG;
+		fail(tmp);
+	}
+	h.size = off;
+	fwrite(&h, sizeof h, 1, fp);
+
+	off = sizeof h + ndirs * sizeof d + n * sizeof e;
+	for (i = 0; i < ndirs; i++) {
+		d.sec = dirs[i].sec;
+		d.nsec = dirs[i].nsec;
+		d.path = off;
+		off += strlen(dirs[i].path) + 1;
+		fwrite(&d, sizeof d, 1, fp);
+	}
+	for (i = 0; i < n; i++) {
+		if (i && strcmp(v[i].name, v[i - 1].name))
+			off += strlen(v[i - 1].name) + 1;
+		e.name = off;
+		e.dir = v[i].dir;
+		fwrite(&e, sizeof e, 1, fp);
+	}
+	for (i = 0; i < ndirs; i++)
+		fwrite(dirs[i].path, strlen(dirs[i].path) + 1, 1, fp);
+	for (i = 0; i < n; i++) {
+		if (i && !strcmp(v[i].name, v[i - 1].name))
+			continue;
+		fwrite(v[i].name, strlen(v[i].name) + 1, 1, fp);
+	}
+	if (fflush(fp) || ferror(fp) || fclose(fp) || rename(tmp, idxfile)) {
+		unlink(tmp);
+		fail(idxfile);
+	}
+	free(v);
+}
+
+/* print the names in the index, once each */
+static void
+printindex(void)
+{
+	const struct idxent *e;
+	const char *p;
+	size_t i, len;
+
+	if (!(p = idxmap(idxfile, &len))) {
+		fprintf(stderr, "%s: invalid index\n", idxfile);
+		exit(2);
+	}
+	e = IDXENTS(p);
+	for (i = 0; i < IDXHDR(p)->nent; i++)
+		if (!i || e[i].name != e[i - 1].name)
+			puts(p + e[i].name);
+	munmap((void *)p, len);
+}
+
+#ifdef __linux__
+/* rewrite the index when files are added, removed or change mode */
+static void
+watch(void)
+{
+	const uint32_t mask = IN_ATTRIB | IN_CLOSE_WRITE | IN_CREATE | IN_DELETE |
+	                      IN_MOVED_FROM | IN_MOVED_TO | IN_DELETE_SELF | IN_MOVE_SELF;
+	char buf[4096] __attribute__((aligned(__alignof__(struct inotify_event))));
+	const struct inotify_event *ev;
+	struct pollfd pfd = { .events = POLLIN };
+	char *dirty;
+	int *wd, pending = 0;
+	ssize_t n;
+	size_t i;
+
+	if ((pfd.fd = inotify_init1(IN_CLOEXEC)) < 0)
+		fail("inotify_init1");
+	if (!(wd = malloc(ndirs * sizeof *wd)) || !(dirty = calloc(ndirs, 1)))
+		fail("malloc");
+	for (i = 0; i < ndirs; i++)
+		wd[i] = inotify_add_watch(pfd.fd, dirs[i].path, mask);
+
+	for (;;) {
+		/* package updates touch many files, wait for them to settle */
+		if (poll(&pfd, 1, pending ? 200 : -1) == 0) {
+			for (i = 0; i < ndirs; i++) {
+				if (!dirty[i])
+					continue;
+				if (wd[i] < 0)
+					wd[i] = inotify_add_watch(pfd.fd, dirs[i].path, mask);
+				scan(&dirs[i]);
+				dirty[i] = 0;
+			}
+			writeindex();
+			pending = 0;
+			continue;
+		}
+		if ((n = read(pfd.fd, buf, sizeof buf)) < 0) {
+			if (errno == EINTR)
+				continue;
+			fail("read");
+		}
+		for (ev = (void *)buf; (char *)ev < buf + n;
+		     ev = (void *)((char *)ev + sizeof *ev + ev->len)) {
+			for (i = 0; i < ndirs && wd[i] != ev->wd; i++)
+				;
+			if (i == ndirs)
+				continue;
+			if (ev->mask & IN_IGNORED)
+				wd[i] = -1;
+			dirty[i] = pending = 1;
+		}
+	}
+}
+#else
+/* rewrite the index when the directories change */
+static void
+watch(void)
+{
+	for (;;) {
+		sleep(2);
+		if (update())
+			writeindex();
+	}
+}
+#endif
+
 static void
 usage(void)
 {
-	fprintf(stderr, "usage: %s [-abcdefghlpqrsuvwx] "
-	        "[-n file] [-o file] [file...]\n", argv0);
+	fprintf(stderr, "usage: %s [-abcdefghlmpqrsuvwx] "
+	        "[-i index] [-n file] [-o file] [file...]\n", argv0);
 	exit(2); /* like test(1) return > 1 on error */
 }
 
@@ -67,6 +364,9 @@ main(int argc, char *argv[])
 	int r;
 
 	ARGBEGIN {
+	case 'i': /* keep the files in an index */
+		idxfile = EARGF(usage());
+		break;
 	case 'n': /* newer than file */
 	case 'o': /* older than file */
 		file = EARGF(usage());
@@ -75,13 +375,32 @@ main(int argc, char *argv[])
 		break;
 	default:
 		/* miscellaneous operators */
-		if (strchr("abcdefghlpqrsuvwx", ARGC()))
+		if (strchr("abcdefghlmpqrsuvwx", ARGC()))
 			FLAG(ARGC()) = 1;
 		else
 			usage(); /* unknown flag */
 	} ARGEND;
 
-	if (!argc) {
+	if (idxfile) {
+		/* only directories changed since the index was written are read */
+		if (!FLAG('l') || !argc)
+			usage();
+		if (!(dirs = calloc(argc, sizeof *dirs)))
+			fail("calloc");
+		for (ndirs = 0; ndirs < (size_t)argc; ndirs++) {
+			dirs[ndirs].path = argv[ndirs];
+			dirs[ndirs].sec = dirs[ndirs].nsec = -2; /* never read */
+		}
+		r = !loadindex();
+		if (update() || r)
+			writeindex();
+		for (r = 0; r < argc; r++)
+			match |= dirs[r].n > 0;
+		if (!FLAG('q'))
+			printindex();
+		if (FLAG('m'))
+			watch();
+	} else if (!argc) {
 		/* read list from stdin */
 		while ((n = getline(&line, &linesiz, stdin)) > 0) {
 			if (line[n - 1] == '\n')
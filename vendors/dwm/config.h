@@ -48,6 +48,22 @@ static const int lockfullscreen = 1; /* 1 will force focus on the fullscreen win
 #include "vanitygaps.c"
 #include "movestack.c"
 
+/* status bar */
+static const char *volicons[] = { "", "", "", "" }; /* muted, 0, up to 75%, more */
+#include "status.c"
+
+static const char statussep[] = " | ";
+static const Block blocks[] = {
+	/* function     watch         argument                   format          interval (s) */
+	{ cpu_perc,     NULL,         NULL,                      "  %s%%",         2 },
+	{ ram_used,     NULL,         NULL,                      " %s",            5 },
+	{ disk_used,    NULL,         NULL,                      "󰋊 %s",            60 },
+	{ pkg_count,    NULL,         "/var/lib/pacman/local",   " %s",            60 },
+	{ vol_perc,     vol_watch,    "Master",                  "%s",              0 },
+	{ net_state,    net_watch,    NULL,                      "󱘖 %s",            0 },
+	{ datetime,     NULL,         "%a, %b %d %R",            "%s",              60 },
+};
+
 static const Layout layouts[] = {
 	/* symbol     arrange function */
 	{ "[]=",      tile },    /* first entry is default */
@@ -145,11 +161,11 @@ static const Key keys[] = {
     /*lock-key*/
 	{ 0,       0x1008ff2d,         spawn,       {.v = (const char*[]){ "slock", NULL }} },
     /*volume-up-key*/
-	{ 0,       0x1008ff11,         spawn,       {.v =  (const char*[]){ "/bin/sh", "-c", "amixer set Master unmute > /dev/null 2>&1 && amixer set Master 5%- > /dev/null 2>&1 && dwm-status-bar refresh", NULL }} },
+	{ 0,       0x1008ff11,         spawn,       {.v =  (const char*[]){ "/bin/sh", "-c", "amixer set Master unmute > /dev/null 2>&1 && amixer set Master 5%- > /dev/null 2>&1", NULL }} },
     /*volume-mute-key*/
-	{ 0,       0x1008ff12,         spawn,       {.v =  (const char*[]){ "/bin/sh", "-c", "amixer set Master toggle > /dev/null 2>&1 && dwm-status-bar refresh", NULL }} },
+	{ 0,       0x1008ff12,         spawn,       {.v =  (const char*[]){ "/bin/sh", "-c", "amixer set Master toggle > /dev/null 2>&1", NULL }} },
     /*volume-down-key*/
-	{ 0,       0x1008ff13,         spawn,       {.v =  (const char*[]){ "/bin/sh", "-c", "amixer set Master unmute > /dev/null 2>&1 && amixer set Master 5%+ > /dev/null 2>&1 && dwm-status-bar refresh", NULL }} },
+	{ 0,       0x1008ff13,         spawn,       {.v =  (const char*[]){ "/bin/sh", "-c", "amixer set Master unmute > /dev/null 2>&1 && amixer set Master 5%+ > /dev/null 2>&1", NULL }} },
 
 };
 
@@ -10,6 +10,20 @@
 
 #define UTF_INVALID 0xFFFD
 #define UTF_SIZ     4
+#define NGLYPHS     1024
+#define NWIDTHS     512
+
+/* caches are direct-mapped: a new entry replaces the one in its slot */
+struct glyph {
+	long codepoint;
+	Fnt *font;
+	unsigned int w;
+};
+
+struct width {
+	char text[60];
+	unsigned int w;
+};
 
 static const unsigned char utfbyte[UTF_SIZ + 1] = {0x80,    0, 0xC0, 0xE0, 0xF0};
 static const unsigned char utfmask[UTF_SIZ + 1] = {0xC0, 0x80, 0xE0, 0xF0, 0xF8};
@@ -73,6 +87,8 @@ drw_create(Display *dpy, int screen, Window root, unsigned int w, unsigned int h
 	drw->drawable = XCreatePixmap(dpy, root, w, h, DefaultDepth(dpy, screen));
 	drw->gc = XCreateGC(dpy, root, 0, NULL);
 	XSetLineAttributes(dpy, drw->gc, 1, LineSolid, CapButt, JoinMiter);
+	drw->glyphs = ecalloc(NGLYPHS, sizeof(struct glyph));
+	drw->widths = ecalloc(NWIDTHS, sizeof(struct width));
 
 	return drw;
 }
@@ -96,6 +112,8 @@ drw_free(Drw *drw)
 	XFreePixmap(drw->dpy, drw->drawable);
 	XFreeGC(drw->dpy, drw->gc);
 	drw_fontset_free(drw->fonts);
+	free(drw->glyphs);
+	free(drw->widths);
 	free(drw);
 }
 
@@ -142,6 +160,52 @@ xfont_create(Drw *drw, const char *fontname, FcPattern *fontpattern)
 	return font;
 }
 
+/* the caches refer to the fonts of the set in use */
+static void
+cache_clear(Drw *drw)
+{
+	memset(drw->glyphs, 0, NGLYPHS * sizeof(struct glyph));
+	memset(drw->widths, 0, NWIDTHS * sizeof(struct width));
+}
+
+/* return the font of the set that has codepoint and its advance, or NULL */
+static Fnt *
+glyph_find(Drw *drw, long codepoint, const char *text, unsigned int len, unsigned int *w)
+{
+	struct glyph *g = &drw->glyphs[(unsigned long)codepoint % NGLYPHS];
+	Fnt *font;
+
+	if (g->font && g->codepoint == codepoint) {
+		*w = g->w;
+		return g->font;
+	}
+	for (font = drw->fonts; font; font = font->next) {
+		if (XftCharExists(drw->dpy, font->xfont, codepoint)) {
+			drw_font_getexts(font, text, len, w, NULL);
+			g->codepoint = codepoint;
+			g->font = font;
+			g->w = *w;
+			return font;
+		}
+	}
+	return NULL;
+}
+
+/* return the slot of text in the width cache, or NULL if it is too long */
+static struct width *
+width_slot(Drw *drw, const char *text)
+{
+	unsigned int hash = 2166136261u;
+	size_t i;
+
+	for (i = 0; text[i]; i++) {
+		if (i == sizeof(drw->widths->text) - 1)
+			return NULL;
+		hash = (hash ^ (unsigned char)text[i]) * 16777619u;
+	}
+	return &drw->widths[hash % NWIDTHS];
+}
+
 static void
 xfont_free(Fnt *font)
 {
@@ -168,6 +232,7 @@ drw_fontset_create(Drw* drw, const char *fonts[], size_t fontcount)
 			ret = cur;
 		}
 	}
+	cache_clear(drw);
 	return (drw->fonts = ret);
 }
 
@@ -212,8 +277,10 @@ drw_scm_create(Drw *drw, const char *clrnames[], size_t clrcount)
 void
 drw_setfontset(Drw *drw, Fnt *set)
 {
-	if (drw)
+	if (drw && drw->fonts != set) {
 		drw->fonts = set;
+		cache_clear(drw);
+	}
 }
 
 void
@@ -239,7 +306,7 @@ int
 drw_text(Drw *drw, int x, int y, unsigned int w, unsigned int h, unsigned int lpad, const char *text, int invert)
 {
 	int i, ty, ellipsis_x = 0;
-	unsigned int tmpw, ew, ellipsis_w = 0, ellipsis_len;
+	unsigned int tmpw = 0, ew, ellipsis_w = 0, ellipsis_len;
 	XftDraw *d = NULL;
 	Fnt *usedfont, *curfont, *nextfont;
 	int utf8strlen, utf8charlen, render = x || y || w || h;
@@ -279,34 +346,36 @@ drw_text(Drw *drw, int x, int y, unsigned int w, unsigned int h, unsigned int lp
 		nextfont = NULL;
 		while (*text) {
 			utf8charlen = utf8decode(text, &utf8codepoint, UTF_SIZ);
-			for (curfont = drw->fonts; curfont; curfont = curfont->next) {
-				charexists = charexists || XftCharExists(drw->dpy, curfont->xfont, utf8codepoint);
-				if (charexists) {
-					drw_font_getexts(curfont, text, utf8charlen, &tmpw, NULL);
-					if (ew + ellipsis_width <= w) {
-						/* keep track where the ellipsis still fits */
-						ellipsis_x = x + ew;
-						ellipsis_w = w - ew;
-						ellipsis_len = utf8strlen;
-					}
-
-					if (ew + tmpw > w) {
-						overflow = 1;
-						/* called from drw_fontset_getwidth_clamp():
-						 * it wants the width AFTER the overflow
-						 */
-						if (!render)
-							x += tmpw;
-						else
-							utf8strlen = ellipsis_len;
-					} else if (curfont == usedfont) {
-						utf8strlen += utf8charlen;
-						text += utf8charlen;
-						ew += tmpw;
-					} else {
-						nextfont = curfont;
-					}
-					break;
+			if ((curfont = glyph_find(drw, utf8codepoint, text, utf8charlen, &tmpw))) {
+				charexists = 1;
+			} else if (charexists) {
+				/* no fallback font has it, draw it with the first one */
+				curfont = drw->fonts;
+				drw_font_getexts(curfont, text, utf8charlen, &tmpw, NULL);
+			}
+			if (charexists) {
+				if (ew + ellipsis_width <= w) {
+					/* keep track where the ellipsis still fits */
+					ellipsis_x = x + ew;
+					ellipsis_w = w - ew;
+					ellipsis_len = utf8strlen;
+				}
+
+				if (ew + tmpw > w) {
+					overflow = 1;
+					/* called from drw_fontset_getwidth_clamp():
+					 * it wants the width AFTER the overflow
+					 */
+					if (!render)
+						x += tmpw;
+					else
+						utf8strlen = ellipsis_len;
+				} else if (curfont == usedfont) {
+					utf8strlen += utf8charlen;
+					text += utf8charlen;
+					ew += tmpw;
+				} else {
+					nextfont = curfont;
 				}
 			}
 
@@ -397,17 +466,37 @@ drw_map(Drw *drw, Window win, int x, int y, unsigned int w, unsigned int h)
 unsigned int
 drw_fontset_getwidth(Drw *drw, const char *text)
 {
+	struct width *c;
+	unsigned int w;
+
 	if (!drw || !drw->fonts || !text)
 		return 0;
-	return drw_text(drw, 0, 0, 0, 0, 0, text, 0);
+	if ((c = width_slot(drw, text)) && !strcmp(c->text, text))
+		return c->w;
+	w = drw_text(drw, 0, 0, 0, 0, 0, text, 0);
+	if (c) {
+		strcpy(c->text, text);
+		c->w = w;
+	}
+	return w;
 }
 
 unsigned int
 drw_fontset_getwidth_clamp(Drw *drw, const char *text, unsigned int n)
 {
+	struct width *c = NULL;
 	unsigned int tmp = 0;
-	if (drw && drw->fonts && text && n)
+
+	if (drw && drw->fonts && text && n) {
+		if ((c = width_slot(drw, text)) && !strcmp(c->text, text))
+			return MIN(n, c->w);
 		tmp = drw_text(drw, 0, 0, 0, 0, 0, text, n);
+		/* a text that fits was measured whole */
+		if (c && tmp <= n) {
+			strcpy(c->text, text);
+			c->w = tmp;
+		}
+	}
 	return MIN(n, tmp);
 }
 
@@ -24,6 +24,8 @@ typedef struct {
 	GC gc;
 	Clr *scheme;
 	Fnt *fonts;
+	struct glyph *glyphs; /* cache of the font and advance of codepoints */
+	struct width *widths; /* cache of the width of short strings */
 } Drw;
 
 /* Drawable abstraction */
@@ -22,11 +22,13 @@
  */
 #include <errno.h>
 #include <locale.h>
+#include <poll.h>
 #include <signal.h>
 #include <stdarg.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <time.h>
 #include <unistd.h>
 #include <sys/types.h>
 #include <sys/wait.h>
@@ -56,6 +58,9 @@
 #define HEIGHT(X)               ((X)->h + 2 * (X)->bw)
 #define TAGMASK                 ((1 << LENGTH(tags)) - 1)
 #define TEXTW(X)                (drw_fontset_getwidth(drw, (X)) + lrpad)
+#define BLOCKFDS                4 /* descriptors a status block can watch */
+#define CLIENTHASH              8 /* log2 of the buckets mapping windows to clients */
+#define WINHASH(W)              ((unsigned int)(W) * 2654435769U >> (32 - CLIENTHASH))
 
 /* enums */
 enum { CurNormal, CurResize, CurMove, CurLast }; /* cursor */
@@ -94,10 +99,13 @@ struct Client {
 	int bw, oldbw;
 	unsigned int tags;
 	int isfixed, isfloating, isurgent, neverfocus, oldstate, isfullscreen;
+	int ishidden; /* moved off screen by showhide() */
 	Client *next;
 	Client *snext;
+	Client *hnext;
 	Monitor *mon;
 	Window win;
+	Window above; /* window restack() last put it right below, or None */
 };
 
 typedef struct {
@@ -112,6 +120,15 @@ typedef struct {
 	void (*arrange)(Monitor *);
 } Layout;
 
+typedef struct {
+	int ww, tw;           /* bar and status width */
+	int title;            /* flags of the selected client, 0 if none */
+	unsigned int tags[4]; /* viewed, occupied, urgent and focused tags */
+	char ltsymbol[16];
+	char name[256];
+	char status[256];
+} Bar;
+
 struct Monitor {
 	char ltsymbol[16];
 	float mfact;
@@ -134,6 +151,7 @@ struct Monitor {
 	Client *stack;
 	Monitor *next;
 	Window barwin;
+	Bar bar;              /* what barwin shows, see drawbar() */
 	const Layout *lt[2];
 };
 
@@ -146,18 +164,30 @@ typedef struct {
 	int monitor;
 } Rule;
 
+typedef struct {
+	const char *(*func)(const char *arg);
+	int (*watch)(const char *arg, struct pollfd *pfd, int n);
+	const char *arg;
+	const char *fmt;
+	unsigned int interval; /* seconds, 0 to update on watch events only */
+} Block;
+
 /* function declarations */
 static void applyrules(Client *c);
 static int applysizehints(Client *c, int *x, int *y, int *w, int *h, int interact);
 static void arrange(Monitor *m);
 static void arrangemon(Monitor *m);
 static void attach(Client *c);
+static void attachhash(Client *c);
 static void attachbottom(Client *c);
 static void attachstack(Client *c);
+static int blockfds(struct pollfd *pfd);
+static int blocktimeout(void);
 static void buttonpress(XEvent *e);
 static void checkotherwm(void);
 static void cleanup(void);
 static void cleanupmon(Monitor *mon);
+static int composestatus(void);
 static void clientmessage(XEvent *e);
 static void configure(Client *c);
 static void configurenotify(XEvent *e);
@@ -165,9 +195,11 @@ static void configurerequest(XEvent *e);
 static Monitor *createmon(void);
 static void destroynotify(XEvent *e);
 static void detach(Client *c);
+static void detachhash(Client *c);
 static void detachstack(Client *c);
 static Monitor *dirtomon(int dir);
 static void drawbar(Monitor *m);
+static void drawblocks(Monitor *m, int x, int w);
 static void drawbars(void);
 static void enternotify(XEvent *e);
 static void expose(XEvent *e);
@@ -195,6 +227,7 @@ static void pop(Client *c);
 static void propertynotify(XEvent *e);
 static void quit(const Arg *arg);
 static Monitor *recttomon(int x, int y, int w, int h);
+static int refreshblock(unsigned int i);
 static void resize(Client *c, int x, int y, int w, int h, int interact);
 static void resizeclient(Client *c, int x, int y, int w, int h);
 static void resizemouse(const Arg *arg);
@@ -224,6 +257,7 @@ static void unmanage(Client *c, int destroyed);
 static void unmapnotify(XEvent *e);
 static void updatebarpos(Monitor *m);
 static void updatebars(void);
+static void updateblocks(struct pollfd *pfd);
 static void updateclientlist(void);
 static int updategeom(void);
 static void updatenumlockmask(void);
@@ -273,10 +307,20 @@ static Display *dpy;
 static Drw *drw;
 static Monitor *mons, *selmon;
 static Window root, wmcheckwin;
+static Client *clienthash[1 << CLIENTHASH];
+static int unsynced; /* windows were moved or restacked since the last XSync */
 
 /* configuration, allows nested code to access above variables */
 #include "config.h"
 
+static struct {
+	char text[128];
+	int npfd, x, w;  /* watched descriptors, position and width in the bar */
+	time_t next;     /* when the block is due again */
+} blockstate[LENGTH(blocks)];
+static Monitor *blockmon; /* where the blocks were last drawn */
+static int showblocks;    /* whether stext is made of the blocks */
+
 /* compile-time check if all tags fit into an unsigned int bit array. */
 struct NumTags { char limitexceeded[LENGTH(tags) > 31 ? -1 : 1]; };
 
@@ -414,6 +458,15 @@ attach(Client *c)
 	c->mon->clients = c;
 }
 
+void
+attachhash(Client *c)
+{
+	Client **h = &clienthash[WINHASH(c->win)];
+
+	c->hnext = *h;
+	*h = c;
+}
+
 void
 attachbottom(Client *c)
 {
@@ -430,6 +483,41 @@ attachstack(Client *c)
 	c->mon->stack = c;
 }
 
+/* collect the descriptors the blocks watch, returns their number */
+int
+blockfds(struct pollfd *pfd)
+{
+	unsigned int i;
+	int j, n = 0;
+
+	for (i = 0; i < LENGTH(blocks); i++) {
+		blockstate[i].npfd = blocks[i].watch ? blocks[i].watch(blocks[i].arg, pfd + n, BLOCKFDS) : 0;
+		for (j = 0; j < blockstate[i].npfd; j++)
+			pfd[n++].revents = 0;
+	}
+	return n;
+}
+
+/* milliseconds until the next block is due, -1 if none is */
+int
+blocktimeout(void)
+{
+	struct timespec ts;
+	long long now, t = -1, d;
+	unsigned int i;
+
+	clock_gettime(CLOCK_REALTIME, &ts);
+	now = ts.tv_sec * 1000LL + ts.tv_nsec / 1000000;
+	for (i = 0; i < LENGTH(blocks); i++) {
+		if (!blocks[i].interval)
+			continue;
+		d = MAX(blockstate[i].next * 1000LL - now, 0);
+		if (t < 0 || d < t)
+			t = d;
+	}
+	return MIN(t, 86400000);
+}
+
 void
 buttonpress(XEvent *e)
 {
@@ -522,11 +610,28 @@ cleanupmon(Monitor *mon)
 		for (m = mons; m && m->next != mon; m = m->next);
 		m->next = mon->next;
 	}
+	if (blockmon == mon)
+		blockmon = NULL;
 	XUnmapWindow(dpy, mon->barwin);
 	XDestroyWindow(dpy, mon->barwin);
 	free(mon);
 }
 
+/* join the texts of the blocks into stext, returns 0 if all are empty */
+int
+composestatus(void)
+{
+	unsigned int i;
+	size_t n = 0;
+
+	stext[0] = '\0';
+	for (i = 0; i < LENGTH(blocks) && n < sizeof(stext); i++)
+		if (blockstate[i].text[0])
+			n += snprintf(stext + n, sizeof(stext) - n, "%s%s",
+			              n ? statussep : "", blockstate[i].text);
+	return n > 0;
+}
+
 void
 clientmessage(XEvent *e)
 {
@@ -641,6 +746,10 @@ configurerequest(XEvent *e)
 		wc.sibling = ev->above;
 		wc.stack_mode = ev->detail;
 		XConfigureWindow(dpy, ev->window, ev->value_mask, &wc);
+		if (ev->value_mask & CWStackMode) /* it may now be between tiled clients */
+			for (m = mons; m; m = m->next)
+				for (c = m->clients; c; c = c->next)
+					c->above = None;
 	}
 	XSync(dpy, False);
 }
@@ -685,6 +794,15 @@ detach(Client *c)
 	*tc = c->next;
 }
 
+void
+detachhash(Client *c)
+{
+	Client **tc;
+
+	for (tc = &clienthash[WINHASH(c->win)]; *tc && *tc != c; tc = &(*tc)->hnext);
+	*tc = c->hnext;
+}
+
 void
 detachstack(Client *c)
 {
@@ -717,54 +835,117 @@ dirtomon(int dir)
 void
 drawbar(Monitor *m)
 {
-	int x, w, tw = 0;
+	int x, w, tx, full;
 	int boxs = drw->fonts->h / 9;
 	int boxw = drw->fonts->h / 6 + 2;
-	unsigned int i, occ = 0, urg = 0;
+	unsigned int i;
 	Client *c;
+	Bar b = { .ww = m->ww };
 
 	if (!m->showbar)
 		return;
 
-	/* draw status first so it can be overdrawn by tags later */
+	/* describe the bar, then redraw only the parts that differ from m->bar */
 	if (m == selmon) { /* status is only drawn on selected monitor */
-		drw_setscheme(drw, scheme[SchemeNorm]);
-		tw = TEXTW(stext) - lrpad + 2; /* 2px right padding */
-		drw_text(drw, m->ww - tw, 0, tw, bh, 0, stext, 0);
+		b.tw = TEXTW(stext) - lrpad + 2; /* 2px right padding */
+		strcpy(b.status, stext);
 	}
-
+	b.tags[0] = m->tagset[m->seltags];
 	for (c = m->clients; c; c = c->next) {
-		occ |= c->tags;
+		b.tags[1] |= c->tags;
 		if (c->isurgent)
-			urg |= c->tags;
+			b.tags[2] |= c->tags;
 	}
-	x = 0;
-	for (i = 0; i < LENGTH(tags); i++) {
-		w = TEXTW(tags[i]);
-		drw_setscheme(drw, scheme[m->tagset[m->seltags] & 1 << i ? SchemeSel : SchemeNorm]);
-		drw_text(drw, x, 0, w, bh, lrpad / 2, tags[i], urg & 1 << i);
-		if (occ & 1 << i)
-			drw_rect(drw, x + boxs, boxs, boxw, boxw,
-				m == selmon && selmon->sel && selmon->sel->tags & 1 << i,
-				urg & 1 << i);
-		x += w;
+	if (m == selmon && selmon->sel)
+		b.tags[3] = selmon->sel->tags;
+	strcpy(b.ltsymbol, m->ltsymbol);
+	if (m->sel) {
+		b.title = 1 | (m == selmon) << 1 | m->sel->isfloating << 2 | m->sel->isfixed << 3;
+		strcpy(b.name, m->sel->name);
+	}
+	for (i = 0, x = 0; i < LENGTH(tags); i++)
+		x += TEXTW(tags[i]);
+	tx = x + TEXTW(m->ltsymbol);
+	if (m == blockmon && tx > m->ww - b.tw)
+		blockmon = NULL; /* the tags cover part of the blocks */
+	/* the tags overdraw the status on narrow bars, redraw all of it then */
+	full = b.ww != m->bar.ww || m->ww - b.tw - tx <= bh;
+
+	if (b.tw && (full || b.tw != m->bar.tw || strcmp(b.status, m->bar.status))) {
+		drw_setscheme(drw, scheme[SchemeNorm]);
+		if (showblocks)
+			drawblocks(m, m->ww - b.tw, b.tw);
+		else
+			drw_text(drw, m->ww - b.tw, 0, b.tw, bh, 0, stext, 0);
+		if (!full)
+			drw_map(drw, m->barwin, m->ww - b.tw, 0, b.tw, bh);
 	}
-	w = TEXTW(m->ltsymbol);
-	drw_setscheme(drw, scheme[SchemeNorm]);
-	x = drw_text(drw, x, 0, w, bh, lrpad / 2, m->ltsymbol, 0);
 
-	if ((w = m->ww - tw - x) > bh) {
+	if (full || memcmp(b.tags, m->bar.tags, sizeof(b.tags))) {
+		for (i = 0, x = 0; i < LENGTH(tags); i++) {
+			w = TEXTW(tags[i]);
+			drw_setscheme(drw, scheme[b.tags[0] & 1 << i ? SchemeSel : SchemeNorm]);
+			drw_text(drw, x, 0, w, bh, lrpad / 2, tags[i], b.tags[2] & 1 << i);
+			if (b.tags[1] & 1 << i)
+				drw_rect(drw, x + boxs, boxs, boxw, boxw,
+					b.tags[3] & 1 << i, b.tags[2] & 1 << i);
+			x += w;
+		}
+		if (!full)
+			drw_map(drw, m->barwin, 0, 0, x, bh);
+	}
+
+	x = tx - TEXTW(m->ltsymbol);
+	if (full || strcmp(b.ltsymbol, m->bar.ltsymbol)) {
+		drw_setscheme(drw, scheme[SchemeNorm]);
+		drw_text(drw, x, 0, tx - x, bh, lrpad / 2, m->ltsymbol, 0);
+		if (!full)
+			drw_map(drw, m->barwin, x, 0, tx - x, bh);
+	}
+
+	w = m->ww - b.tw - tx;
+	if (w > bh && (full || b.tw != m->bar.tw || strcmp(b.ltsymbol, m->bar.ltsymbol)
+	|| b.title != m->bar.title || strcmp(b.name, m->bar.name))) {
 		if (m->sel) {
 			drw_setscheme(drw, scheme[m == selmon ? SchemeSel : SchemeNorm]);
-			drw_text(drw, x, 0, w, bh, lrpad / 2, m->sel->name, 0);
+			drw_text(drw, tx, 0, w, bh, lrpad / 2, m->sel->name, 0);
 			if (m->sel->isfloating)
-				drw_rect(drw, x + boxs, boxs, boxw, boxw, m->sel->isfixed, 0);
+				drw_rect(drw, tx + boxs, boxs, boxw, boxw, m->sel->isfixed, 0);
 		} else {
 			drw_setscheme(drw, scheme[SchemeNorm]);
-			drw_rect(drw, x, 0, w, bh, 1, 1);
+			drw_rect(drw, tx, 0, w, bh, 1, 1);
 		}
+		if (!full)
+			drw_map(drw, m->barwin, tx, 0, w, bh);
 	}
-	drw_map(drw, m->barwin, 0, 0, m->ww, bh);
+	if (full)
+		drw_map(drw, m->barwin, 0, 0, m->ww, bh);
+	m->bar = b;
+}
+
+/* draw the blocks one by one, remembering where each one is */
+void
+drawblocks(Monitor *m, int x, int w)
+{
+	unsigned int i;
+	int sep = 0;
+
+	drw_rect(drw, x, 0, w, bh, 1, 1);
+	for (i = 0; i < LENGTH(blocks); i++) {
+		if (!blockstate[i].text[0]) {
+			blockstate[i].w = 0;
+			continue;
+		}
+		if (sep) {
+			w = TEXTW(statussep) - lrpad;
+			x = drw_text(drw, x, 0, w, bh, 0, statussep, 0);
+		}
+		blockstate[i].x = x;
+		blockstate[i].w = TEXTW(blockstate[i].text) - lrpad;
+		x = drw_text(drw, x, 0, blockstate[i].w, bh, 0, blockstate[i].text, 0);
+		sep = 1;
+	}
+	blockmon = m;
 }
 
 void
@@ -801,8 +982,10 @@ expose(XEvent *e)
 	Monitor *m;
 	XExposeEvent *ev = &e->xexpose;
 
-	if (ev->count == 0 && (m = wintomon(ev->window)))
+	if (ev->count == 0 && (m = wintomon(ev->window))) {
+		m->bar.ww = 0; /* its contents are lost */
 		drawbar(m);
+	}
 }
 
 void
@@ -1096,9 +1279,11 @@ manage(Window w, XWindowAttributes *wa)
 		XRaiseWindow(dpy, c->win);
 	attachbottom(c);
 	attachstack(c);
+	attachhash(c);
 	XChangeProperty(dpy, root, netatom[NetClientList], XA_WINDOW, 32, PropModeAppend,
 		(unsigned char *) &(c->win), 1);
 	XMoveResizeWindow(dpy, c->win, c->x + 2 * sw, c->y, c->w, c->h); /* some windows require this */
+	c->ishidden = 1;
 	setclientstate(c, NormalState);
 	if (c->mon == selmon)
 		unfocus(selmon->sel, 0);
@@ -1295,6 +1480,28 @@ recttomon(int x, int y, int w, int h)
 	return r;
 }
 
+/* read block i again, returns whether its text changed */
+int
+refreshblock(unsigned int i)
+{
+	char text[sizeof(blockstate->text)];
+	const char *s;
+	time_t now;
+
+	if (blocks[i].interval) {
+		now = time(NULL);
+		blockstate[i].next = (now / blocks[i].interval + 1) * blocks[i].interval;
+	}
+	if ((s = blocks[i].func(blocks[i].arg)))
+		snprintf(text, sizeof(text), blocks[i].fmt, s);
+	else
+		text[0] = '\0';
+	if (!strcmp(text, blockstate[i].text))
+		return 0;
+	strcpy(blockstate[i].text, text);
+	return 1;
+}
+
 void
 resize(Client *c, int x, int y, int w, int h, int interact)
 {
@@ -1314,7 +1521,8 @@ resizeclient(Client *c, int x, int y, int w, int h)
 	wc.border_width = c->bw;
 	XConfigureWindow(dpy, c->win, CWX|CWY|CWWidth|CWHeight|CWBorderWidth, &wc);
 	configure(c);
-	XSync(dpy, False);
+	c->ishidden = 0;
+	unsynced = 1;
 }
 
 void
@@ -1384,18 +1592,31 @@ restack(Monitor *m)
 	drawbar(m);
 	if (!m->sel)
 		return;
-	if (m->sel->isfloating || !m->lt[m->sellt]->arrange)
+	if (m->sel->isfloating || !m->lt[m->sellt]->arrange) {
 		XRaiseWindow(dpy, m->sel->win);
-	if (m->lt[m->sellt]->arrange) {
-		wc.stack_mode = Below;
-		wc.sibling = m->barwin;
-		for (c = m->stack; c; c = c->snext)
-			if (!c->isfloating && ISVISIBLE(c)) {
-				XConfigureWindow(dpy, c->win, CWSibling|CWStackMode, &wc);
-				wc.sibling = c->win;
-			}
+		m->sel->above = None;
+		unsynced = 1;
 	}
+	/* tiled clients stay right below the previous one, so only those
+	 * that follow another client than last time need to be moved */
+	wc.stack_mode = Below;
+	wc.sibling = m->barwin;
+	for (c = m->stack; c; c = c->snext) {
+		if (c->isfloating || !ISVISIBLE(c) || !m->lt[m->sellt]->arrange) {
+			c->above = None;
+			continue;
+		}
+		if (c->above != wc.sibling) {
+			XConfigureWindow(dpy, c->win, CWSibling|CWStackMode, &wc);
+			c->above = wc.sibling;
+			unsynced = 1;
+		}
+		wc.sibling = c->win;
+	}
+	if (!unsynced)
+		return;
 	XSync(dpy, False);
+	unsynced = 0;
 	while (XCheckMaskEvent(dpy, EnterWindowMask, &ev));
 }
 
@@ -1403,11 +1624,29 @@ void
 run(void)
 {
 	XEvent ev;
-	/* main event loop */
+	struct pollfd pfd[1 + LENGTH(blocks) * BLOCKFDS];
+	int n;
+
+	/* main event loop, waiting for X and the status blocks alike */
 	XSync(dpy, False);
-	while (running && !XNextEvent(dpy, &ev))
-		if (handler[ev.type])
-			handler[ev.type](&ev); /* call handler */
+	pfd[0].fd = ConnectionNumber(dpy);
+	pfd[0].events = POLLIN;
+	while (running) {
+		while (running && XPending(dpy)) {
+			XNextEvent(dpy, &ev);
+			if (handler[ev.type])
+				handler[ev.type](&ev); /* call handler */
+		}
+		if (!running)
+			break;
+		n = blockfds(pfd + 1);
+		if (poll(pfd, 1 + n, blocktimeout()) < 0) {
+			if (errno == EINTR)
+				continue;
+			die("poll:");
+		}
+		updateblocks(pfd + 1);
+	}
 }
 
 void
@@ -1581,6 +1820,7 @@ setup(void)
 	XSetWindowAttributes wa;
 	Atom utf8string;
 	struct sigaction sa;
+	struct pollfd pfd[LENGTH(blocks) * BLOCKFDS];
 
 	/* do not transform children into zombies when they terminate */
 	sigemptyset(&sa.sa_mask);
@@ -1625,8 +1865,11 @@ setup(void)
 	scheme = ecalloc(LENGTH(colors), sizeof(Clr *));
 	for (i = 0; i < LENGTH(colors); i++)
 		scheme[i] = drw_scm_create(drw, colors[i], 3);
-	/* init bars */
+	/* init bars, opening the watches first so the blocks can be read */
 	updatebars();
+	blockfds(pfd);
+	for (i = 0; i < LENGTH(blocks); i++)
+		refreshblock(i);
 	updatestatus();
 	/* supporting window for NetWMCheck */
 	wmcheckwin = XCreateSimpleWindow(dpy, root, 0, 0, 1, 1, 0, 0, 0);
@@ -1671,14 +1914,22 @@ showhide(Client *c)
 		return;
 	if (ISVISIBLE(c)) {
 		/* show clients top down */
-		XMoveWindow(dpy, c->win, c->x, c->y);
+		if (c->ishidden) {
+			XMoveWindow(dpy, c->win, c->x, c->y);
+			c->ishidden = 0;
+			unsynced = 1;
+		}
 		if ((!c->mon->lt[c->mon->sellt]->arrange || c->isfloating) && !c->isfullscreen)
 			resize(c, c->x, c->y, c->w, c->h, 0);
 		showhide(c->snext);
 	} else {
 		/* hide clients bottom up */
 		showhide(c->snext);
-		XMoveWindow(dpy, c->win, WIDTH(c) * -2, c->y);
+		if (!c->ishidden) {
+			XMoveWindow(dpy, c->win, WIDTH(c) * -2, c->y);
+			c->ishidden = 1;
+			unsynced = 1;
+		}
 	}
 }
 
@@ -1726,6 +1977,7 @@ void
 togglebar(const Arg *arg)
 {
 	selmon->showbar = !selmon->showbar;
+	selmon->bar.ww = 0;
 	updatebarpos(selmon);
 	XMoveResizeWindow(dpy, selmon->barwin, selmon->wx, selmon->by, selmon->ww, bh);
 	arrange(selmon);
@@ -1793,6 +2045,7 @@ unmanage(Client *c, int destroyed)
 
 	detach(c);
 	detachstack(c);
+	detachhash(c);
 	if (!destroyed) {
 		wc.border_width = c->oldbw;
 		XGrabServer(dpy); /* avoid race conditions */
@@ -1847,6 +2100,45 @@ updatebars(void)
 	}
 }
 
+/*
+ * refresh the blocks that are due or whose descriptors are ready. a block
+ * that keeps its width is redrawn in place, anything else redraws the bar.
+ */
+void
+updateblocks(struct pollfd *pfd)
+{
+	unsigned int i;
+	int j, due, n = 0, changed[LENGTH(blocks)], any = 0, inplace;
+	time_t now = time(NULL);
+
+	for (i = 0; i < LENGTH(blocks); i++) {
+		due = blocks[i].interval && now >= blockstate[i].next;
+		for (j = 0; j < blockstate[i].npfd; j++)
+			due |= pfd[n++].revents != 0;
+		any |= changed[i] = due && refreshblock(i);
+	}
+	if (!any)
+		return;
+	inplace = showblocks && blockmon == selmon && selmon->showbar;
+	for (i = 0; inplace && i < LENGTH(blocks); i++)
+		if (changed[i])
+			inplace = blockstate[i].w && blockstate[i].text[0]
+			       && TEXTW(blockstate[i].text) - lrpad == blockstate[i].w;
+	if (!inplace) {
+		updatestatus();
+		return;
+	}
+	composestatus();
+	strcpy(selmon->bar.status, stext);
+	drw_setscheme(drw, scheme[SchemeNorm]);
+	for (i = 0; i < LENGTH(blocks); i++) {
+		if (!changed[i])
+			continue;
+		drw_text(drw, blockstate[i].x, 0, blockstate[i].w, bh, 0, blockstate[i].text, 0);
+		drw_map(drw, selmon->barwin, blockstate[i].x, 0, blockstate[i].w, bh);
+	}
+}
+
 void
 updatebarpos(Monitor *m)
 {
@@ -2015,7 +2307,10 @@ updatesizehints(Client *c)
 void
 updatestatus(void)
 {
-	if (!gettextprop(root, XA_WM_NAME, stext, sizeof(stext)))
+	/* a name set on the root window, e.g. by xsetroot(1), replaces the blocks */
+	showblocks = !(gettextprop(root, XA_WM_NAME, stext, sizeof(stext)) && stext[0])
+	          && composestatus();
+	if (!showblocks && !stext[0])
 		strcpy(stext, "dwm-"VERSION);
 	drawbar(selmon);
 }
@@ -2076,13 +2371,9 @@ Client *
 wintoclient(Window w)
 {
 	Client *c;
-	Monitor *m;
 
-	for (m = mons; m; m = m->next)
-		for (c = m->clients; c; c = c->next)
-			if (c->win == w)
-				return c;
-	return NULL;
+	for (c = clienthash[WINHASH(w)]; c && c->win != w; c = c->hnext);
+	return c;
 }
 
 Monitor *
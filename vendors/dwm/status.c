@@ -0,0 +1,304 @@
+/* See LICENSE file for copyright and license details.
+ *
+ * status bar blocks, see blocks[] in config.h. each function returns the
+ * text of its block or NULL if it is unavailable. a watch function fills
+ * in the descriptors that signal a change, the block is then updated as
+ * soon as one of them is ready.
+ */
+#include <dirent.h>
+#include <ifaddrs.h>
+#include <limits.h>
+#include <net/if.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/statvfs.h>
+#ifdef __linux__
+#include <linux/netlink.h>
+#include <linux/rtnetlink.h>
+#endif
+#ifdef ALSA
+#include <alsa/asoundlib.h>
+#endif
+
+/* Blocks */
+static const char *cpu_perc(const char *unused);
+static const char *datetime(const char *fmt);
+static const char *disk_used(const char *path);
+static const char *net_state(const char *unused);
+static const char *pkg_count(const char *dbpath);
+static const char *ram_used(const char *unused);
+static const char *vol_perc(const char *ctl);
+/* Watches */
+static int net_watch(const char *unused, struct pollfd *pfd, int n);
+static int vol_watch(const char *ctl, struct pollfd *pfd, int n);
+/* Internals */
+static const char *bprintf(const char *fmt, ...);
+static void human(char *buf, size_t len, double n);
+
+static char blockbuf[128];
+
+const char *
+bprintf(const char *fmt, ...)
+{
+	va_list ap;
+
+	va_start(ap, fmt);
+	vsnprintf(blockbuf, sizeof(blockbuf), fmt, ap);
+	va_end(ap);
+	return blockbuf;
+}
+
+/* like df -h: one decimal below 10 */
+void
+human(char *buf, size_t len, double n)
+{
+	const char *u = "BKMGTP";
+
+	for (; n >= 1024 && u[1]; u++)
+		n /= 1024;
+	snprintf(buf, len, n < 10 && *u != 'B' ? "%.1f%c" : "%.0f%c", n, *u);
+}
+
+/* busy time of all CPUs since the last call, in percent */
+const char *
+cpu_perc(const char *unused)
+{
+	static unsigned long long prevbusy, prevtotal;
+	unsigned long long a[8] = { 0 }, busy, total;
+	FILE *fp;
+	int i, n;
+
+	if (!(fp = fopen("/proc/stat", "r")))
+		return NULL;
+	n = fscanf(fp, "cpu %llu %llu %llu %llu %llu %llu %llu %llu",
+	           &a[0], &a[1], &a[2], &a[3], &a[4], &a[5], &a[6], &a[7]);
+	fclose(fp);
+	if (n < 4)
+		return NULL;
+	for (i = total = 0; i < LENGTH(a); i++)
+		total += a[i];
+	busy = total - a[3] - a[4]; /* idle and iowait */
+	n = total > prevtotal ? 100 * (busy - prevbusy) / (total - prevtotal) : 0;
+	prevbusy = busy;
+	prevtotal = total;
+	return bprintf("%d", n);
+}
+
+/* memory in use, as free(1) counts it, and the total */
+const char *
+ram_used(const char *unused)
+{
+	unsigned long long total = 0, avail = 0, v;
+	char line[128], used[16], size[16];
+	FILE *fp;
+
+	if (!(fp = fopen("/proc/meminfo", "r")))
+		return NULL;
+	while (fgets(line, sizeof(line), fp)) {
+		if (sscanf(line, "MemTotal: %llu kB", &v) == 1)
+			total = v;
+		else if (sscanf(line, "MemAvailable: %llu kB", &v) == 1)
+			avail = v;
+	}
+	fclose(fp);
+	if (!total)
+		return NULL;
+	human(used, sizeof(used), (total - avail) * 1024.0);
+	human(size, sizeof(size), total * 1024.0);
+	return bprintf("%s/%s", used, size);
+}
+
+/* space used on the file system of path, $HOME if NULL, and its size */
+const char *
+disk_used(const char *path)
+{
+	struct statvfs fs;
+	char used[16], size[16];
+
+	if (!path && !(path = getenv("HOME")))
+		return NULL;
+	if (statvfs(path, &fs) < 0)
+		return NULL;
+	human(used, sizeof(used), (double)(fs.f_blocks - fs.f_bfree) * fs.f_frsize);
+	human(size, sizeof(size), (double)fs.f_blocks * fs.f_frsize);
+	return bprintf("%s/%s", used, size);
+}
+
+/*
+ * explicitly installed packages in the pacman database at dbpath. the
+ * database is only read again when its directory changes.
+ */
+const char *
+pkg_count(const char *dbpath)
+{
+	static struct timespec mtime;
+	static int count = -1;
+	struct dirent *e;
+	struct stat st;
+	char path[PATH_MAX], line[64];
+	int dep;
+	FILE *fp;
+	DIR *dir;
+
+	if (stat(dbpath, &st) < 0)
+		return NULL;
+	if (count >= 0 && st.st_mtim.tv_sec == mtime.tv_sec && st.st_mtim.tv_nsec == mtime.tv_nsec)
+		return bprintf("%d", count);
+	if (!(dir = opendir(dbpath)))
+		return NULL;
+	mtime = st.st_mtim;
+	for (count = 0; (e = readdir(dir)); ) {
+		if (e->d_name[0] == '.')
+			continue;
+		snprintf(path, sizeof(path), "%s/%s/desc", dbpath, e->d_name);
+		if (!(fp = fopen(path, "r")))
+			continue;
+		/* installed as a dependency if %REASON% is 1 */
+		for (dep = 0; !dep && fgets(line, sizeof(line), fp); )
+			if (!strcmp(line, "%REASON%\n"))
+				dep = fgets(line, sizeof(line), fp) && !strcmp(line, "1\n");
+		fclose(fp);
+		count += !dep;
+	}
+	closedir(dir);
+	return bprintf("%d", count);
+}
+
+#ifdef ALSA
+static snd_mixer_t *mixer;
+static snd_mixer_elem_t *volelem;
+
+/* the mixer of the default card signals volume changes */
+int
+vol_watch(const char *ctl, struct pollfd *pfd, int n)
+{
+	static int failed;
+	snd_mixer_selem_id_t *sid;
+
+	if (!mixer && !failed) {
+		if (snd_mixer_open(&mixer, 0) < 0) {
+			failed = 1;
+			return 0;
+		}
+		if (snd_mixer_attach(mixer, "default") < 0 ||
+		    snd_mixer_selem_register(mixer, NULL, NULL) < 0 ||
+		    snd_mixer_load(mixer) < 0) {
+			snd_mixer_close(mixer);
+			mixer = NULL;
+			failed = 1;
+			return 0;
+		}
+		snd_mixer_selem_id_alloca(&sid);
+		snd_mixer_selem_id_set_index(sid, 0);
+		snd_mixer_selem_id_set_name(sid, ctl);
+		volelem = snd_mixer_find_selem(mixer, sid);
+	}
+	if (!mixer || (n = snd_mixer_poll_descriptors(mixer, pfd, n)) < 0)
+		return 0;
+	return n;
+}
+
+/* playback volume of the mixer control ctl, with an icon from volicons */
+const char *
+vol_perc(const char *ctl)
+{
+	long min, max, v;
+	int on = 1, perc;
+
+	if (!mixer)
+		return NULL;
+	snd_mixer_handle_events(mixer);
+	if (!volelem ||
+	    snd_mixer_selem_get_playback_volume_range(volelem, &min, &max) < 0 ||
+	    snd_mixer_selem_get_playback_volume(volelem, SND_MIXER_SCHN_FRONT_LEFT, &v) < 0)
+		return NULL;
+	if (snd_mixer_selem_has_playback_switch(volelem))
+		snd_mixer_selem_get_playback_switch(volelem, SND_MIXER_SCHN_FRONT_LEFT, &on);
+	perc = max > min ? ((v - min) * 100 + (max - min) / 2) / (max - min) : 0;
+	return bprintf("%s %d%%", volicons[!on ? 0 : !perc ? 1 : perc <= 75 ? 2 : 3], perc);
+}
+#else
+int
+vol_watch(const char *ctl, struct pollfd *pfd, int n)
+{
+	return 0;
+}
+
+const char *
+vol_perc(const char *ctl)
+{
+	(void)volicons;
+	return NULL;
+}
+#endif /* ALSA */
+
+#ifdef __linux__
+static int nlfd = -1;
+
+/* rtnetlink signals links going up or down and addresses changing */
+int
+net_watch(const char *unused, struct pollfd *pfd, int n)
+{
+	struct sockaddr_nl sa = {
+		.nl_family = AF_NETLINK,
+		.nl_groups = RTMGRP_LINK | RTMGRP_IPV4_IFADDR | RTMGRP_IPV6_IFADDR,
+	};
+
+	if (nlfd < 0) {
+		if ((nlfd = socket(AF_NETLINK, SOCK_RAW | SOCK_NONBLOCK | SOCK_CLOEXEC,
+		                   NETLINK_ROUTE)) < 0)
+			return 0;
+		if (bind(nlfd, (struct sockaddr *)&sa, sizeof(sa)) < 0) {
+			close(nlfd);
+			nlfd = -1;
+			return 0;
+		}
+	}
+	if (n < 1)
+		return 0;
+	pfd->fd = nlfd;
+	pfd->events = POLLIN;
+	return 1;
+}
+#else
+int
+net_watch(const char *unused, struct pollfd *pfd, int n)
+{
+	return 0;
+}
+#endif /* __linux__ */
+
+/* "on" if an interface other than loopback is running and has an address */
+const char *
+net_state(const char *unused)
+{
+	struct ifaddrs *ifas, *ifa;
+	int on = 0;
+#ifdef __linux__
+	char buf[4096];
+
+	/* the events only say that something changed */
+	while (nlfd >= 0 && recv(nlfd, buf, sizeof(buf), MSG_DONTWAIT) > 0)
+		;
+#endif
+	if (getifaddrs(&ifas) < 0)
+		return NULL;
+	for (ifa = ifas; ifa && !on; ifa = ifa->ifa_next)
+		on = ifa->ifa_addr
+		  && (ifa->ifa_addr->sa_family == AF_INET || ifa->ifa_addr->sa_family == AF_INET6)
+		  && (ifa->ifa_flags & (IFF_UP | IFF_RUNNING | IFF_LOOPBACK)) == (IFF_UP | IFF_RUNNING);
+	freeifaddrs(ifas);
+	return on ? "on" : "off";
+}
+
+/* local time formatted with strftime(3) */
+const char *
+datetime(const char *fmt)
+{
+	time_t t = time(NULL);
+	struct tm *tm;
+
+	if (!(tm = localtime(&t)) || !strftime(blockbuf, sizeof(blockbuf), fmt, tm))
+		return NULL;
+	return blockbuf;
+}
@@ -1,6 +1,8 @@
 /* See LICENSE file for license details. */
 #define _XOPEN_SOURCE   500
 #define LENGTH(X)       (sizeof X / sizeof X[0])
+#define MAX(A, B)       ((A) > (B) ? (A) : (B))
+#define MIN(A, B)       ((A) < (B) ? (A) : (B))
 #if HAVE_SHADOW_H
 #include <shadow.h>
 #endif
@@ -42,17 +44,24 @@ enum {
 
 #include "config.h"
 
+/* a monitor of a screen, with its logo drawn over the background in each color */
+struct output {
+	int x, y;
+	Pixmap logo[NUMCOLS];
+};
+
 struct lock {
 	int screen;
 	Window root, win;
 	Pixmap pmap;
 	Pixmap bgmap;
+	Cursor invisible;
 	unsigned long colors[NUMCOLS];
 	unsigned int x, y;
-	unsigned int xoff, yoff, mw, mh;
-	Drawable drawable;
+	unsigned int bgw, bgh;
+	struct output *outputs;
+	int noutputs, color;
 	GC gc;
-	XRectangle rectangles[LENGTH(rectangles)];
 };
 
 struct xrandr {
@@ -142,31 +151,91 @@ gethash(void)
 }
 
 static void
-resizerectangles(struct lock *lock)
+freeoutputs(Display *dpy, struct lock *lock)
 {
-	int i;
+	int i, j;
+
+	for (i = 0; i < lock->noutputs; i++)
+		for (j = 0; j < NUMCOLS; j++)
+			XFreePixmap(dpy, lock->outputs[i].logo[j]);
+	free(lock->outputs);
+	lock->outputs = NULL;
+	lock->noutputs = 0;
+}
+
+/* find the monitors of the screen and render their logo in every color */
+static void
+updateoutputs(Display *dpy, struct lock *lock)
+{
+	XRectangle rects[LENGTH(rectangles)], mon = { 0, 0, lock->x, lock->y }, *mons = &mon;
+	unsigned int w = logow * logosize, h = logoh * logosize;
+	int i, j, n = 1, sx, sy, dx, dy;
+	struct output *o;
+#ifdef XINERAMA
+	XineramaScreenInfo *info = NULL;
+
+	if (XineramaIsActive(dpy) && (info = XineramaQueryScreens(dpy, &n)) && n > 0) {
+		if (!(mons = calloc(n, sizeof(*mons))))
+			die("slock: out of memory\n");
+		for (i = 0; i < n; i++) {
+			mons[i].x = info[i].x_org;
+			mons[i].y = info[i].y_org;
+			mons[i].width = info[i].width;
+			mons[i].height = info[i].height;
+		}
+	} else
+		n = 1;
+	if (info)
+		XFree(info);
+#endif
 
-	for (i = 0; i < LENGTH(rectangles); i++){
-		lock->rectangles[i].x = (rectangles[i].x * logosize)
-                                + lock->xoff + ((lock->mw) / 2) - (logow / 2 * logosize);
-		lock->rectangles[i].y = (rectangles[i].y * logosize)
-                                + lock->yoff + ((lock->mh) / 2) - (logoh / 2 * logosize);
-		lock->rectangles[i].width = rectangles[i].width * logosize;
-		lock->rectangles[i].height = rectangles[i].height * logosize;
+	freeoutputs(dpy, lock);
+	if (!(lock->outputs = calloc(n, sizeof(struct output))))
+		die("slock: out of memory\n");
+	lock->noutputs = n;
+
+	for (i = 0; i < LENGTH(rectangles); i++) {
+		rects[i].x = rectangles[i].x * logosize;
+		rects[i].y = rectangles[i].y * logosize;
+		rects[i].width = rectangles[i].width * logosize;
+		rects[i].height = rectangles[i].height * logosize;
+	}
+	for (i = 0; i < n; i++) {
+		o = &lock->outputs[i];
+		o->x = mons[i].x + mons[i].width / 2 - (logow / 2 * logosize);
+		o->y = mons[i].y + mons[i].height / 2 - (logoh / 2 * logosize);
+		for (j = 0; j < NUMCOLS; j++) {
+			o->logo[j] = XCreatePixmap(dpy, lock->root, w, h,
+			                           DefaultDepth(dpy, lock->screen));
+			XSetForeground(dpy, lock->gc, BlackPixel(dpy, lock->screen));
+			XFillRectangle(dpy, o->logo[j], lock->gc, 0, 0, w, h);
+			/* the background keeps its size across screen changes,
+			 * only copy the part of it the logo overlaps */
+			sx = MAX(o->x, 0);
+			sy = MAX(o->y, 0);
+			dx = MIN(o->x + (int)w, (int)lock->bgw) - sx;
+			dy = MIN(o->y + (int)h, (int)lock->bgh) - sy;
+			if (lock->bgmap && dx > 0 && dy > 0)
+				XCopyArea(dpy, lock->bgmap, o->logo[j], lock->gc,
+				          sx, sy, dx, dy, sx - o->x, sy - o->y);
+			XSetForeground(dpy, lock->gc, lock->colors[j]);
+			XFillRectangles(dpy, o->logo[j], lock->gc, rects, LENGTH(rects));
+		}
 	}
+	if (mons != &mon)
+		free(mons);
 }
 
 static void
 drawlogo(Display *dpy, struct lock *lock, int color)
 {
-	/* 
-	XSetForeground(dpy, lock->gc, lock->colors[BACKGROUND]);
-	XFillRectangle(dpy, lock->drawable, lock->gc, 0, 0, lock->x, lock->y); */
-	lock->drawable = lock->bgmap;
-	XSetForeground(dpy, lock->gc, lock->colors[color]);
-	XFillRectangles(dpy, lock->drawable, lock->gc, lock->rectangles, LENGTH(rectangles));
-	XCopyArea(dpy, lock->drawable, lock->win, lock->gc, 0, 0, lock->x, lock->y, 0, 0);
-	XSync(dpy, False);
+	int i;
+
+	for (i = 0; i < lock->noutputs; i++)
+		XCopyArea(dpy, lock->outputs[i].logo[color], lock->win, lock->gc,
+		          0, 0, logow * logosize, logoh * logosize,
+		          lock->outputs[i].x, lock->outputs[i].y);
+	lock->color = color;
 }
 
 static void
@@ -240,18 +309,30 @@ readpw(Display *dpy, struct xrandr *rr, struct lock **locks, int nscreens,
 				}
 				oldc = color;
 			}
+		} else if (ev.type == Expose) {
+			for (screen = 0; screen < nscreens; screen++) {
+				if (locks[screen]->win == ev.xexpose.window && !ev.xexpose.count) {
+					drawlogo(dpy, locks[screen], locks[screen]->color);
+					break;
+				}
+			}
 		} else if (rr->active && ev.type == rr->evbase + RRScreenChangeNotify) {
 			rre = (XRRScreenChangeNotifyEvent*)&ev;
 			for (screen = 0; screen < nscreens; screen++) {
 				if (locks[screen]->win == rre->window) {
 					if (rre->rotation == RR_Rotate_90 ||
-					    rre->rotation == RR_Rotate_270)
-						XResizeWindow(dpy, locks[screen]->win,
-						              rre->height, rre->width);
-					else
-						XResizeWindow(dpy, locks[screen]->win,
-						              rre->width, rre->height);
+					    rre->rotation == RR_Rotate_270) {
+						locks[screen]->x = rre->height;
+						locks[screen]->y = rre->width;
+					} else {
+						locks[screen]->x = rre->width;
+						locks[screen]->y = rre->height;
+					}
+					XResizeWindow(dpy, locks[screen]->win,
+					              locks[screen]->x, locks[screen]->y);
 					XClearWindow(dpy, locks[screen]->win);
+					updateoutputs(dpy, locks[screen]);
+					drawlogo(dpy, locks[screen], locks[screen]->color);
 					break;
 				}
 			}
@@ -263,20 +344,15 @@ readpw(Display *dpy, struct xrandr *rr, struct lock **locks, int nscreens,
 }
 
 static struct lock *
-lockscreen(Display *dpy, struct xrandr *rr, int screen)
+lockscreen(Display *dpy, int screen)
 {
 	char curs[] = {0, 0, 0, 0, 0, 0, 0, 0};
-	int i, ptgrab, kbgrab;
+	int i;
 	struct lock *lock;
 	XColor color, dummy;
 	XSetWindowAttributes wa;
-	Cursor invisible;
-#ifdef XINERAMA
-	XineramaScreenInfo *info;
-	int n;
-#endif
 
-	if (dpy == NULL || screen < 0 || !(lock = malloc(sizeof(struct lock))))
+	if (dpy == NULL || screen < 0 || !(lock = calloc(1, sizeof(struct lock))))
 		return NULL;
 
 	lock->screen = screen;
@@ -284,14 +360,15 @@ lockscreen(Display *dpy, struct xrandr *rr, int screen)
 
     if(image) 
     {
-        lock->bgmap = XCreatePixmap(dpy, lock->root, DisplayWidth(dpy, lock->screen), DisplayHeight(dpy, lock->screen), DefaultDepth(dpy, lock->screen));
+        lock->bgw = DisplayWidth(dpy, lock->screen);
+        lock->bgh = DisplayHeight(dpy, lock->screen);
+        lock->bgmap = XCreatePixmap(dpy, lock->root, lock->bgw, lock->bgh, DefaultDepth(dpy, lock->screen));
         imlib_context_set_image(image);
         imlib_context_set_display(dpy);
         imlib_context_set_visual(DefaultVisual(dpy, lock->screen));
         imlib_context_set_colormap(DefaultColormap(dpy, lock->screen));
         imlib_context_set_drawable(lock->bgmap);
         imlib_render_image_on_drawable(0, 0);
-        imlib_free_image();
     }
 	for (i = 0; i < NUMCOLS; i++) {
 		XAllocNamedColor(dpy, DefaultColormap(dpy, lock->screen),
@@ -301,26 +378,13 @@ lockscreen(Display *dpy, struct xrandr *rr, int screen)
 
 	lock->x = DisplayWidth(dpy, lock->screen);
 	lock->y = DisplayHeight(dpy, lock->screen);
-#ifdef XINERAMA
-	if ((info = XineramaQueryScreens(dpy, &n))) {
-		lock->xoff = info[0].x_org;
-		lock->yoff = info[0].y_org;
-		lock->mw = info[0].width;
-		lock->mh = info[0].height;
-	} else
-#endif
-	{
-		lock->xoff = lock->yoff = 0;
-		lock->mw = lock->x;
-		lock->mh = lock->y;
-	}
-	lock->drawable = XCreatePixmap(dpy, lock->root,
-            lock->x, lock->y, DefaultDepth(dpy, screen));
 	lock->gc = XCreateGC(dpy, lock->root, 0, NULL);
 	XSetLineAttributes(dpy, lock->gc, 1, LineSolid, CapButt, JoinMiter);
+	XSetGraphicsExposures(dpy, lock->gc, False);
 
 	/* init */
 	wa.override_redirect = 1;
+	wa.background_pixel = BlackPixel(dpy, lock->screen);
 	lock->win = XCreateWindow(dpy, lock->root, 0, 0,
 	                          lock->x, lock->y,
 	                          0, DefaultDepth(dpy, lock->screen),
@@ -331,35 +395,49 @@ lockscreen(Display *dpy, struct xrandr *rr, int screen)
         XSetWindowBackgroundPixmap(dpy, lock->win, lock->bgmap);
 	}
 	lock->pmap = XCreateBitmapFromData(dpy, lock->win, curs, 8, 8);
-	invisible = XCreatePixmapCursor(dpy, lock->pmap, lock->pmap,
-	                                &color, &color, 0, 0);
-	XDefineCursor(dpy, lock->win, invisible);
+	lock->invisible = XCreatePixmapCursor(dpy, lock->pmap, lock->pmap,
+	                                      &color, &color, 0, 0);
+	XDefineCursor(dpy, lock->win, lock->invisible);
 
-	resizerectangles(lock);
+	updateoutputs(dpy, lock);
+	lock->color = INIT;
+	return lock;
+}
+
+/*
+ * grab the pointer and keyboard once for all screens, then show all lock
+ * windows together. the requests are only flushed by the grabs.
+ */
+static int
+grabinput(Display *dpy, struct xrandr *rr, struct lock **locks, int nscreens)
+{
+	int i, s, ptgrab, kbgrab;
 
 	/* Try to grab mouse pointer *and* keyboard for 600ms, else fail the lock */
 	for (i = 0, ptgrab = kbgrab = -1; i < 6; i++) {
 		if (ptgrab != GrabSuccess) {
-			ptgrab = XGrabPointer(dpy, lock->root, False,
+			ptgrab = XGrabPointer(dpy, locks[0]->root, False,
 			                      ButtonPressMask | ButtonReleaseMask |
 			                      PointerMotionMask, GrabModeAsync,
-			                      GrabModeAsync, None, invisible, CurrentTime);
+			                      GrabModeAsync, None, locks[0]->invisible, CurrentTime);
 		}
 		if (kbgrab != GrabSuccess) {
-			kbgrab = XGrabKeyboard(dpy, lock->root, True,
+			kbgrab = XGrabKeyboard(dpy, locks[0]->root, True,
 			                       GrabModeAsync, GrabModeAsync, CurrentTime);
 		}
 
-		/* input is grabbed: we can lock the screen */
+		/* input is grabbed: we can lock the screens */
 		if (ptgrab == GrabSuccess && kbgrab == GrabSuccess) {
-			XMapRaised(dpy, lock->win);
-			if (rr->active)
-				XRRSelectInput(dpy, lock->win, RRScreenChangeNotifyMask);
-
-			XSelectInput(dpy, lock->root, SubstructureNotifyMask);
+			for (s = 0; s < nscreens; s++) {
+				XMapRaised(dpy, locks[s]->win);
+				if (rr->active)
+					XRRSelectInput(dpy, locks[s]->win, RRScreenChangeNotifyMask);
+				XSelectInput(dpy, locks[s]->win, ExposureMask);
+				XSelectInput(dpy, locks[s]->root, SubstructureNotifyMask);
+				drawlogo(dpy, locks[s], INIT);
+			}
 			locktime = time(NULL);
-			drawlogo(dpy, lock, INIT);
-			return lock;
+			return 1;
 		}
 
 		/* retry on AlreadyGrabbed but fail on other errors */
@@ -372,12 +450,10 @@ lockscreen(Display *dpy, struct xrandr *rr, int screen)
 
 	/* we couldn't grab all input: fail out */
 	if (ptgrab != GrabSuccess)
-		fprintf(stderr, "slock: unable to grab mouse pointer for screen %d\n",
-		        screen);
+		fprintf(stderr, "slock: unable to grab mouse pointer\n");
 	if (kbgrab != GrabSuccess)
-		fprintf(stderr, "slock: unable to grab keyboard for screen %d\n",
-		        screen);
-	return NULL;
+		fprintf(stderr, "slock: unable to grab keyboard\n");
+	return 0;
 }
 
 static void
@@ -500,16 +576,20 @@ main(int argc, char **argv) {
 	if (!(locks = calloc(nscreens, sizeof(struct lock *))))
 		die("slock: out of memory\n");
 	for (nlocks = 0, s = 0; s < nscreens; s++) {
-		if ((locks[s] = lockscreen(dpy, &rr, s)) != NULL)
+		if ((locks[s] = lockscreen(dpy, s)) != NULL)
 			nlocks++;
 		else
 			break;
 	}
-	XSync(dpy, 0);
+	if (image) {
+		imlib_context_set_image(image);
+		imlib_free_image();
+	}
 
 	/* did we manage to lock everything? */
-	if (nlocks != nscreens)
+	if (nlocks != nscreens || !grabinput(dpy, &rr, locks, nscreens))
 		return 1;
+	XSync(dpy, 0);
 
 	/* run post-lock command */
 	if (argc > 0) {
@@ -529,7 +609,7 @@ main(int argc, char **argv) {
 	readpw(dpy, &rr, locks, nscreens, hash);
 
 	for (nlocks = 0, s = 0; s < nscreens; s++) {
-		XFreePixmap(dpy, locks[s]->drawable);
+		freeoutputs(dpy, locks[s]);
 		XFreeGC(dpy, locks[s]->gc);
 	}
 
@@ -53,13 +53,27 @@ int allowwindowops = 0;
 
 /*
  * draw latency range in ms - from new content/keypress/etc until drawing.
- * within this range, st draws when content stops arriving (idle). mostly it's
- * near minlatency, but it waits longer for slow updates to avoid partial draw.
+ * within this range, st draws when content stops arriving (idle). the idle
+ * time is learned from the gaps between reads of the output, it is at least
+ * minlatency and at most one frame, so bursts are drawn whole.
  * low minlatency will tear/flicker more, as it can "detect" idle too early.
+ * the echo of a keypress is drawn as soon as it arrives.
  */
 static double minlatency = 2;
 static double maxlatency = 33;
 
+/*
+ * refresh rate of the screen in Hz, st draws at most once per refresh. when
+ * built with XRandR (see config.mk) the rate of the screen is used instead.
+ */
+static double refreshrate = 60;
+
+/*
+ * print the keypress to draw latency in frames to stderr after this many
+ * echoed keypresses, 0 disables it
+ */
+static unsigned int latencyreport = 0;
+
 /*
  * blinking timeout (set to 0 to disable blinking) for the terminal blinking
  * attribute.
@@ -201,6 +215,8 @@ static Shortcut shortcuts[] = {
 	{ TERMMOD,              XK_Num_Lock,    numlock,        {.i =  0} },
 	{ ShiftMask,            XK_Page_Up,     kscrollup,      {.i = -1} },
 	{ ShiftMask,            XK_Page_Down,   kscrolldown,    {.i = -1} },
+	{ TERMMOD,              XK_F,           searchstart,    {.i =  0} },
+	{ TERMMOD,              XK_R,           searchstart,    {.i =  1} },
 };
 
 /*
@@ -4,6 +4,7 @@
 #include <fcntl.h>
 #include <limits.h>
 #include <pwd.h>
+#include <regex.h>
 #include <stdarg.h>
 #include <stdio.h>
 #include <stdlib.h>
@@ -36,7 +37,7 @@
 #define STR_BUF_SIZ   ESC_BUF_SIZ
 #define STR_ARG_SIZ   ESC_ARG_SIZ
 #define HISTSIZE      2000
-#define RESIZEBUFFER  1000
+#define REFLOWMARGIN  200
 
 /* macros */
 #define IS_SET(flag)		((term.mode & (flag)) != 0)
@@ -49,8 +50,9 @@
 	               : term.line[(y) - term.scr] \
 )
 #define TLINEABS(y) ( \
-	(y) < 0 ? term.hist[(term.histi + (y) + 1 + HISTSIZE) % HISTSIZE] : term.line[(y)] \
+	(y) < 0 ? term.hist[HISTSLOT(y)] : term.line[(y)] \
 )
+#define HISTSLOT(y)		((term.histi + (y) + 1 + HISTSIZE) % HISTSIZE)
 #define UPDATEWRAPNEXT(alt, col) do { \
 	if ((term.c.state & CURSOR_WRAPNEXT) && term.c.x + term.wrapcwidth[alt] < col) { \
 		term.c.x += term.wrapcwidth[alt]; \
@@ -130,14 +132,41 @@ typedef struct {
 	int alt;
 } Selection;
 
+typedef struct {
+	struct {
+		int x, y;
+	} b, e;
+} Match;
+
+typedef struct {
+	int mode;
+	int regex;
+	int narrow;   /* pattern was only extended, rescan matched lines */
+	char pat[ESC_BUF_SIZ];
+	size_t len;
+	size_t skip[256]; /* Boyer-Moore-Horspool shifts */
+	regex_t re;
+	int recomp;   /* re is compiled */
+	Match *match; /* absolute coordinates, in screen order */
+	int nmatch;
+	int matchsiz;
+	int cur;      /* current match */
+	int *lines;   /* first absolute row of the matched logical lines */
+	int nlines;
+	int linesiz;
+	int stale;    /* the tty wrote to the screen since the last match */
+} Search;
+
 /* Internal representation of the screen */
 typedef struct {
 	int row;      /* nb row */
 	int col;      /* nb col */
 	Line *line;   /* screen */
 	Line hist[HISTSIZE]; /* history buffer */
+	int histw[HISTSIZE]; /* nb col each history line is laid out for */
 	int histi;           /* history index */
 	int histf;           /* nb history available */
+	int histr;           /* nb newest history lines reflowed to col */
 	int scr;             /* scroll back */
 	int wrapcwidth[2];   /* used in updating WRAPNEXT when resizing */
 	int *dirty;   /* dirtyness of lines */
@@ -206,6 +235,7 @@ static void tdeleteline(int);
 static void tinsertblank(int);
 static void tinsertblankline(int);
 static int tlinelen(Line len);
+static int tlinelenw(Line, int);
 static int tiswrapped(Line line);
 static char *tgetglyphs(char *, const Glyph *, const Glyph *);
 static size_t tgetline(char *, const Glyph *);
@@ -218,6 +248,9 @@ static void treset(void);
 static void tscrollup(int, int, int, int);
 static void tscrolldown(int, int);
 static void treflow(int, int);
+static void treflowhist(int);
+static Line thistline(int, int *);
+static void thistsplice(int, int, Line *, int, int);
 static void rscrolldown(int);
 static void tresizedef(int, int);
 static void tresizealt(int, int);
@@ -235,6 +268,10 @@ static void tcontrolcode(uchar );
 static void tdectest(char );
 static void tdefutf8(char);
 static int32_t tdefcolor(const int *, int *, int);
+static uint32_t tinterncolor(uint32_t);
+static void tmarkcolors(const Glyph *, int);
+static void tsweepcolors(void);
+static void tresetcolors(void);
 static void tdeftran(char);
 static void tstrsequence(uchar);
 
@@ -247,6 +284,14 @@ static void selremove(void);
 static int regionselected(int, int, int, int);
 static void selsnap(int *, int *, int);
 
+static void tsearch(void);
+static int tsearchline(int, int *);
+static const char *tsearchmem(const char *, size_t);
+static void searchmove(int);
+static void searchscreen(void);
+static void searchtitle(void);
+static void searchshow(void);
+
 static size_t utf8decode(const char *, Rune *, size_t);
 static Rune utf8decodebyte(char, size_t *);
 static char utf8encodebyte(Rune, size_t);
@@ -260,12 +305,25 @@ static ssize_t xwrite(int, const char *, size_t);
 /* Globals */
 static Term term;
 static Selection sel;
+static Search search;
 static CSIEscape csiescseq;
 static STREscape strescseq;
 static int iofd = 1;
 static int cmdfd;
 static pid_t pid;
 
+/* truecolors are interned, glyphs store their index in truecol */
+static uint32_t truecol[TRUECOLSIZE];
+static ushort truehash[1 << 16]; /* open addressing, 0 is empty */
+static int ntruecol;
+static uchar trueused[TRUECOLSIZE]; /* referenced by a glyph, see tsweepcolors() */
+static ushort truefree[TRUECOLSIZE]; /* reclaimed truecol indices */
+static int ntruefree;
+static int truemiss; /* quantized colors to go before the next sweep */
+
+/* saved cursors of the main and the alternate screen */
+static TCursor savedc[2];
+
 static const uchar utfbyte[UTF_SIZ + 1] = {0x80,    0, 0xC0, 0xE0, 0xF0};
 static const uchar utfmask[UTF_SIZ + 1] = {0xC0, 0x80, 0xE0, 0xF0, 0xF8};
 static const Rune utfmin[UTF_SIZ + 1] = {       0,    0,  0x80,  0x800,  0x10000};
@@ -446,7 +504,13 @@ selinit(void)
 int
 tlinelen(Line line)
 {
-	int i = term.col - 1;
+	return tlinelenw(line, term.col);
+}
+
+int
+tlinelenw(Line line, int col)
+{
+	int i = col - 1;
 
 	for (; i >= 0 && !(line[i].mode & (ATTR_SET | ATTR_WRAP)); i--);
 	return i + 1;
@@ -590,7 +654,7 @@ selsnap(int *x, int *y, int direction)
 	const Glyph *gp, *prevgp;
 
 	if (!IS_SET(MODE_ALTSCREEN))
-		rtop += -term.histf + term.scr, rbot += term.scr;
+		rtop += -term.histr + term.scr, rbot += term.scr;
 
 	switch (sel.snap) {
 	case SNAP_WORD:
@@ -720,6 +784,373 @@ selremove(void)
 	sel.ob.x = -1;
 }
 
+void
+searchstart(const Arg *arg)
+{
+	if (search.mode)
+		searchstop();
+	search.mode = SEARCH_EDIT;
+	search.regex = arg->i;
+	search.len = 0;
+	search.pat[0] = '\0';
+	tsearch();
+}
+
+void
+searchstop(void)
+{
+	if (!search.mode)
+		return;
+	if (search.recomp)
+		regfree(&search.re);
+	search.recomp = 0;
+	search.mode = SEARCH_IDLE;
+	search.nmatch = search.nlines = 0;
+	resettitle();
+	tfulldirt();
+}
+
+int
+searchmode(void)
+{
+	return search.mode;
+}
+
+void
+searchinput(const char *s, size_t n)
+{
+	if (search.mode != SEARCH_EDIT || search.len + n >= sizeof(search.pat))
+		return;
+	memcpy(search.pat + search.len, s, n);
+	search.len += n;
+	search.pat[search.len] = '\0';
+	search.narrow = !search.regex;
+	tsearch();
+}
+
+void
+searchdelete(void)
+{
+	if (search.mode != SEARCH_EDIT || !search.len)
+		return;
+	/* drop the last UTF-8 sequence */
+	while (--search.len > 0 && (search.pat[search.len] & 0xC0) == 0x80)
+		;
+	search.pat[search.len] = '\0';
+	tsearch();
+}
+
+void
+searchcommit(void)
+{
+	if (!search.nmatch)
+		searchstop();
+	else
+		search.mode = SEARCH_NAV;
+}
+
+void
+searchnext(int dir)
+{
+	if (!search.nmatch)
+		return;
+	/* dir > 0 moves up, towards older lines */
+	search.cur = (search.cur - dir + search.nmatch) % search.nmatch;
+	searchshow();
+}
+
+/*
+ * Returns 2 if (x, y) is in the current match, 1 if it is in any other
+ * match. y is in screen coordinates like for selected().
+ */
+int
+searched(int x, int y)
+{
+	int lo = 0, hi = search.nmatch - 1, mid;
+	Match *m;
+
+	if (!search.mode || !search.nmatch)
+		return 0;
+	y -= term.scr;
+	/* last match starting before or at (x, y) */
+	while (lo < hi) {
+		mid = (lo + hi + 1) / 2;
+		m = &search.match[mid];
+		if (m->b.y < y || (m->b.y == y && m->b.x <= x))
+			lo = mid;
+		else
+			hi = mid - 1;
+	}
+	m = &search.match[lo];
+	if ((m->b.y > y || (m->b.y == y && m->b.x > x)) ||
+	    (m->e.y < y || (m->e.y == y && m->e.x < x)))
+		return 0;
+	return lo == search.cur ? 2 : 1;
+}
+
+const char *
+tsearchmem(const char *s, size_t n)
+{
+	const char *end, *p = search.pat;
+	size_t i, m = search.len;
+
+	if (m > n)
+		return NULL;
+	if (m < 4) {
+		/* too short for skipping to pay off, memchr is vectorized */
+		for (end = s + n - m; (s = memchr(s, p[0], end - s + 1)); s++) {
+			if (!memcmp(s, p, m))
+				return s;
+		}
+		return NULL;
+	}
+	for (i = 0; i <= n - m; i += search.skip[(uchar)s[i + m - 1]]) {
+		if (s[i + m - 1] == p[m - 1] && !memcmp(s + i, p, m - 1))
+			return s + i;
+	}
+	return NULL;
+}
+
+/*
+ * Add the matches in the logical line starting at absolute row y0 and set
+ * *y1 to the row following it. Returns the nb of matches found.
+ */
+int
+tsearchline(int y0, int *y1)
+{
+	static char *buf;
+	static int *pos, siz;
+	const char *s;
+	regmatch_t rm;
+	Line line;
+	Match *m;
+	int x, y, len, n = 0, found = 0, b, e, l, i;
+
+	y = y0;
+	do {
+		line = TLINEABS(y);
+		len = tlinelen(line);
+		for (x = 0; x < len; x++) {
+			if (line[x].mode & ATTR_WDUMMY)
+				continue;
+			if (n + UTF_SIZ + 1 > siz) {
+				siz = MAX(2 * siz, 1024);
+				buf = xrealloc(buf, siz);
+				pos = xrealloc(pos, siz * sizeof(*pos));
+			}
+			l = utf8encode(line[x].u, buf + n);
+			for (i = 0; i < l; i++)
+				pos[n + i] = (y - y0) * term.col + x;
+			n += l;
+		}
+	} while (tiswrapped(line) && ++y < term.row);
+	*y1 = y + 1;
+	if (!n)
+		return 0;
+	buf[n] = '\0';
+
+	for (b = 0; b < n; b = MAX(e, b + 1)) {
+		if (search.regex) {
+			if (regexec(&search.re, buf + b, 1, &rm,
+			            b ? REG_NOTBOL : 0))
+				break;
+			e = b + rm.rm_eo;
+			b += rm.rm_so;
+			if (e == b)
+				continue; /* skip empty matches */
+		} else {
+			if (!(s = tsearchmem(buf + b, n - b)))
+				break;
+			b = s - buf;
+			e = b + search.len;
+		}
+		if (search.nmatch == search.matchsiz) {
+			search.matchsiz = MAX(2 * search.matchsiz, 64);
+			search.match = xrealloc(search.match,
+			                        search.matchsiz * sizeof(Match));
+		}
+		m = &search.match[search.nmatch++];
+		m->b.x = pos[b] % term.col, m->b.y = y0 + pos[b] / term.col;
+		m->e.x = pos[e - 1] % term.col, m->e.y = y0 + pos[e - 1] / term.col;
+		found++;
+	}
+	return found;
+}
+
+void
+tsearch(void)
+{
+	int i, y, next, bot, top, nlines = search.nlines, *lines = NULL;
+
+	search.nmatch = search.nlines = 0;
+	search.stale = 0;
+	if (search.recomp)
+		regfree(&search.re);
+	search.recomp = 0;
+
+	if (search.len && search.regex) {
+		search.recomp = !regcomp(&search.re, search.pat,
+		                         REG_EXTENDED | REG_NEWLINE);
+	} else if (search.len) {
+		for (i = 0; i < LEN(search.skip); i++)
+			search.skip[i] = search.len;
+		for (i = 0; i < search.len - 1; i++)
+			search.skip[(uchar)search.pat[i]] = search.len - 1 - i;
+	}
+
+	if (search.len && (!search.regex || search.recomp)) {
+		top = IS_SET(MODE_ALTSCREEN) ? 0 : -term.histf;
+		/* the whole history has to be laid out to be searched */
+		if (!IS_SET(MODE_ALTSCREEN))
+			treflowhist(term.histf);
+		/* a longer pattern only matches where the shorter one did */
+		if (search.narrow && nlines) {
+			lines = xmalloc(nlines * sizeof(*lines));
+			memcpy(lines, search.lines, nlines * sizeof(*lines));
+		}
+		for (i = 0, y = top; lines ? i < nlines : y < term.row; i++) {
+			if (lines)
+				y = lines[i];
+			if (!tsearchline(y, &next)) {
+				y = next;
+				continue;
+			}
+			if (search.nlines == search.linesiz) {
+				search.linesiz = MAX(2 * search.linesiz, 64);
+				search.lines = xrealloc(search.lines,
+				        search.linesiz * sizeof(*search.lines));
+			}
+			search.lines[search.nlines++] = y;
+			y = next;
+		}
+		free(lines);
+	}
+	search.narrow = 0;
+
+	/* start at the last match above the bottom of the view */
+	bot = term.row - 1 - term.scr;
+	for (search.cur = search.nmatch - 1; search.cur > 0 &&
+	     search.match[search.cur].b.y > bot; search.cur--)
+		;
+	if (search.nmatch) {
+		searchshow();
+		return;
+	}
+	searchtitle();
+	tfulldirt();
+}
+
+/* scroll the current match into view */
+void
+searchshow(void)
+{
+	int y = search.match[search.cur].b.y, scr = term.scr;
+
+	if (y + term.scr < 0 || y + term.scr >= term.row) {
+		scr = term.row / 2 - y;
+		LIMIT(scr, 0, term.histf);
+	}
+	if (scr > term.scr)
+		kscrollup(&((Arg){ .i = scr - term.scr }));
+	else if (scr < term.scr)
+		kscrolldown(&((Arg){ .i = term.scr - scr }));
+	searchtitle();
+	tfulldirt();
+}
+
+void
+searchtitle(void)
+{
+	static char title[ESC_BUF_SIZ + 32];
+
+	if (search.nmatch) {
+		snprintf(title, sizeof(title), "%s: %s [%d/%d]",
+		         search.regex ? "regex" : "search", search.pat,
+		         search.nmatch - search.cur, search.nmatch);
+	} else {
+		snprintf(title, sizeof(title), "%s: %s%s",
+		         search.regex ? "regex" : "search", search.pat,
+		         search.regex && search.len && !search.recomp ?
+		         " (invalid)" : "");
+	}
+	xsettitle(title);
+}
+
+/* keep matches in place when lines move into the history */
+void
+searchmove(int n)
+{
+	int i, j;
+
+	search.nlines = 0;
+	for (i = j = 0; i < search.nmatch; i++) {
+		search.match[i].b.y += n;
+		search.match[i].e.y += n;
+		if (search.match[i].b.y >= -term.histf)
+			search.match[j++] = search.match[i];
+	}
+	search.cur = MAX(search.cur - (i - j), 0);
+	search.nmatch = j;
+	if (!j && search.mode == SEARCH_NAV)
+		searchstop();
+}
+
+/*
+ * The tty may have rewritten the screen under the search: match its
+ * logical lines again. The history only moves, searchmove() tracks that.
+ */
+void
+searchscreen(void)
+{
+	int i, y, y0, next, n, valid, onmatch = search.nmatch, ocur = search.cur;
+	Match *m;
+
+	search.stale = 0;
+	if (!search.len || (search.regex && !search.recomp))
+		return;
+	/* first row of the logical line the screen starts in */
+	y0 = 0;
+	if (!IS_SET(MODE_ALTSCREEN)) {
+		while (y0 > -term.histf && tiswrapped(TLINEABS(y0 - 1)))
+			y0--;
+	}
+
+	/* matches are in screen order, drop the ones from y0 on */
+	for (n = search.nmatch; n > 0 && search.match[n - 1].b.y >= y0; n--)
+		;
+	/* searchmove() drops the matched lines, don't narrow on a part */
+	valid = search.nlines || !search.nmatch;
+	while (search.nlines > 0 && search.lines[search.nlines - 1] >= y0)
+		search.nlines--;
+
+	/* redraw where highlights go away and where they appear */
+	for (i = n; i < search.nmatch; i++) {
+		m = &search.match[i];
+		tsetdirt(m->b.y + term.scr, m->e.y + term.scr);
+	}
+	search.nmatch = n;
+	for (y = y0; y < term.row; y = next) {
+		if (!tsearchline(y, &next) || !valid)
+			continue;
+		if (search.nlines == search.linesiz) {
+			search.linesiz = MAX(2 * search.linesiz, 64);
+			search.lines = xrealloc(search.lines,
+			        search.linesiz * sizeof(*search.lines));
+		}
+		search.lines[search.nlines++] = y;
+	}
+	for (i = n; i < search.nmatch; i++) {
+		m = &search.match[i];
+		tsetdirt(m->b.y + term.scr, m->e.y + term.scr);
+	}
+
+	LIMIT(search.cur, 0, MAX(search.nmatch - 1, 0));
+	if (!search.nmatch && search.mode == SEARCH_NAV)
+		searchstop();
+	else if (search.nmatch != onmatch || search.cur != ocur)
+		searchtitle();
+}
+
 void
 die(const char *errstr, ...)
 {
@@ -1073,14 +1504,13 @@ tfulldirt(void)
 void
 tcursor(int mode)
 {
-	static TCursor c[2];
 	int alt = IS_SET(MODE_ALTSCREEN);
 
 	if (mode == CURSOR_SAVE) {
-		c[alt] = term.c;
+		savedc[alt] = term.c;
 	} else if (mode == CURSOR_LOAD) {
-		term.c = c[alt];
-		tmoveto(c[alt].x, c[alt].y);
+		term.c = savedc[alt];
+		tmoveto(savedc[alt].x, savedc[alt].y);
 	}
 }
 
@@ -1106,11 +1536,14 @@ treset(void)
 		term.tabs[i] = 1;
 	term.top = 0;
 	term.histf = 0;
+	term.histr = 0;
 	term.scr = 0;
 	term.bot = term.row - 1;
 	term.mode = MODE_WRAP|MODE_UTF8;
 	memset(term.trantbl, CS_USA, sizeof(term.trantbl));
 	term.charset = 0;
+	/* every glyph and cursor is cleared below */
+	tresetcolors();
 
 	selremove();
 	for (i = 0; i < 2; i++) {
@@ -1137,8 +1570,10 @@ tnew(int col, int row)
 	}
 	term.dirty = xmalloc(row * sizeof(*term.dirty));
 	term.tabs = xmalloc(col * sizeof(*term.tabs));
-	for (i = 0; i < HISTSIZE; i++)
+	for (i = 0; i < HISTSIZE; i++) {
 		term.hist[i] = xmalloc(col * sizeof(Glyph));
+		term.histw[i] = col;
+	}
 	treset();
 }
 
@@ -1231,6 +1666,8 @@ kscrollup(const Arg* a)
 	if (n < 0)
 		n = MAX(term.row / -n, 1);
 
+	/* history beyond the reflowed part is only laid out once reached */
+	treflowhist(term.scr + n);
 	if (term.scr + n <= term.histf) {
 		term.scr += n;
 	} else {
@@ -1282,12 +1719,18 @@ tscrollup(int top, int bot, int n, int mode)
 		for (i = 0; i < n; i++) {
 			term.histi = (term.histi + 1) % HISTSIZE;
 			temp = term.hist[term.histi];
+			if (term.histw[term.histi] != term.col)
+				temp = xrealloc(temp, term.col * sizeof(Glyph));
 			for (j = 0; j < term.col; j++)
 				tclearglyph(&temp[j], 1);
 			term.hist[term.histi] = term.line[i];
+			term.histw[term.histi] = term.col;
 			term.line[i] = temp;
 		}
 		term.histf = MIN(term.histf + n, HISTSIZE);
+		term.histr = MIN(term.histr + n, term.histf);
+		if (search.nmatch)
+			searchmove(-n);
 		s = n;
 		if (term.scr) {
 			j = term.scr;
@@ -1554,7 +1997,7 @@ tdefcolor(const int *attr, int *npar, int l)
 			fprintf(stderr, "erresc: bad rgb color (%u,%u,%u)\n",
 				r, g, b);
 		else
-			idx = TRUECOLOR(r, g, b);
+			idx = tinterncolor(TRUECOLOR(r, g, b));
 		break;
 	case 5: /* indexed color */
 		if (*npar + 2 >= l) {
@@ -1582,6 +2025,113 @@ tdefcolor(const int *attr, int *npar, int l)
 	return idx;
 }
 
+uint32_t
+tinterncolor(uint32_t rgb)
+{
+	uint32_t h, r, g, b;
+	int idx;
+
+	for (h = rgb * 2654435761u >> 16; truehash[h];
+	     h = (h + 1) % LEN(truehash)) {
+		if (truecol[truehash[h] - TRUECOLBASE] == rgb)
+			return truehash[h];
+	}
+
+	if (ntruecol < TRUECOLSIZE) {
+		truecol[ntruecol] = rgb;
+		return truehash[h] = TRUECOLBASE + ntruecol++;
+	}
+
+	if (!ntruefree && truemiss-- <= 0) {
+		tsweepcolors();
+		/* sweeping is slow, do not retry soon if nothing was freed */
+		truemiss = ntruefree ? 0 : TRUECOLSIZE / 16;
+		/* the sweep rebuilt the hash, find the free bucket again */
+		for (h = rgb * 2654435761u >> 16; truehash[h];
+		     h = (h + 1) % LEN(truehash))
+			;
+	}
+	if (ntruefree) {
+		idx = truefree[--ntruefree];
+		truecol[idx] = rgb;
+		return truehash[h] = TRUECOLBASE + idx;
+	}
+
+	/* table is full, fall back to the 6x6x6 color cube */
+	r = ((rgb >> 16 & 0xff) * 5 + 127) / 255;
+	g = ((rgb >> 8 & 0xff) * 5 + 127) / 255;
+	b = ((rgb & 0xff) * 5 + 127) / 255;
+	return 16 + r * 36 + g * 6 + b;
+}
+
+void
+tmarkcolors(const Glyph *gp, int n)
+{
+	for (; n-- > 0; gp++) {
+		if (IS_TRUECOL(gp->fg))
+			trueused[gp->fg - TRUECOLBASE] = 1;
+		if (IS_TRUECOL(gp->bg))
+			trueused[gp->bg - TRUECOLBASE] = 1;
+	}
+}
+
+/*
+ * Reclaim the truecolors no glyph refers to any more: mark the colors of
+ * both screens, the history and the cursors, then rebuild the hash from
+ * the marked ones and put the rest on the free list.  A frame still being
+ * rendered is not marked: xdrawline() copies the RGB of its truecolors,
+ * so the freed indices can be reused right away.
+ */
+void
+tsweepcolors(void)
+{
+	int i, y, w;
+	uint32_t h;
+	Line line;
+
+	memset(trueused, 0, sizeof(trueused));
+	for (i = 0; i < 2; i++) {
+		for (y = 0; y < term.row; y++)
+			tmarkcolors(term.line[y], term.col);
+		tswapscreen();
+	}
+	for (y = -term.histf; y < 0; y++) {
+		line = thistline(y, &w);
+		tmarkcolors(line, w);
+	}
+	tmarkcolors(&term.c.attr, 1);
+	tmarkcolors(&savedc[0].attr, 1);
+	tmarkcolors(&savedc[1].attr, 1);
+
+	memset(truehash, 0, sizeof(truehash));
+	ntruefree = 0;
+	for (i = ntruecol - 1; i >= 0; i--) {
+		if (!trueused[i]) {
+			truefree[ntruefree++] = i;
+			continue;
+		}
+		for (h = truecol[i] * 2654435761u >> 16; truehash[h];
+		     h = (h + 1) % LEN(truehash))
+			;
+		truehash[h] = TRUECOLBASE + i;
+	}
+}
+
+void
+tresetcolors(void)
+{
+	memset(truehash, 0, sizeof(truehash));
+	ntruecol = 0;
+	ntruefree = 0;
+	truemiss = 0;
+}
+
+uint32_t
+tcolorrgb(uint32_t idx)
+{
+	return truecol[idx - TRUECOLBASE];
+}
+
 void
 tsetattr(const int *attr, int l)
 {
@@ -2774,6 +3324,8 @@ twrite(const char *buf, int buflen, int show_ctrl)
 		}
 		tputc(u);
 	}
+	if (n && search.mode)
+		search.stale = 1;
 	return n;
 }
 
@@ -2787,6 +3339,7 @@ rscrolldown(int n)
        if (IS_SET(MODE_ALTSCREEN))
        return; */
 
+    treflowhist(n);
     if ((n = MIN(n, term.histf)) <= 0)
         return;
 
@@ -2803,6 +3356,7 @@ rscrolldown(int n)
     }
     term.c.y += n;
     term.histf -= n;
+    term.histr -= n;
     if ((i = term.scr - n) >= 0) {
         term.scr = i;
     } else {
@@ -2840,6 +3394,9 @@ tresize(int col, int row)
 		tresizealt(col, row);
 	else
 		tresizedef(col, row);
+	/* match coordinates are meaningless after a reflow */
+	if (search.mode)
+		tsearch();
 }
 
 
@@ -2945,9 +3502,9 @@ tresizealt(int col, int row)
 void
 treflow(int col, int row)
 {
-    int i, j;
+    int i, j, k, w, nl, nc;
     int oce, nce, bot, scr;
-    int ox = 0, oy = -term.histf, nx = 0, ny = -1, len;
+    int ox = 0, oy, nx = 0, ny = -1, len;
     int cy = -1; /* proxy for new y coordinate of cursor */
     int nlines;
     Line *buf, line;
@@ -2956,23 +3513,34 @@ treflow(int col, int row)
     for (oce = term.c.y; oce < term.row - 1 &&
             tiswrapped(term.line[oce]); oce++);
 
-    nlines = term.histf + oce + 1;
-    if (col < term.col) {
-        /* each line can take this many lines after reflow */
-        j = (term.col + col - 1) / col;
-        nlines = j * nlines;
-        if (nlines > HISTSIZE + RESIZEBUFFER + row) {
-            nlines = HISTSIZE + RESIZEBUFFER + row;
-            oy = -(nlines / j - oce - 1);
+    /*
+     * Only the screen and a margin of history are reflowed now, extended
+     * to the start of a logical line. Older lines keep their width until
+     * treflowhist() reaches them, so the cost does not depend on HISTSIZE.
+     */
+    for (k = nl = nc = 0; k < term.histf; k++) {
+        line = thistline(-k - 1, &w);
+        if (!(line[w - 1].mode & ATTR_WRAP)) {
+            /* both are lower bounds of the nb of reflowed lines */
+            if (MAX(nl, nc / col) >= term.scr + row + REFLOWMARGIN)
+                break;
+            nl++;
         }
+        nc += tlinelenw(line, w);
+    }
+
+    for (nlines = 0, oy = -k; oy <= oce; oy++) {
+        thistline(oy, &w);
+        nlines += DIVCEIL(w, col);
     }
     buf = xmalloc(nlines * sizeof(Line));
+    oy = -k;
     do {
         if (!nx)
             buf[++ny] = xmalloc(col * sizeof(Glyph));
         if (!ox) {
-            line = TLINEABS(oy);
-            len = tlinelen(line);
+            line = thistline(oy, &w);
+            len = tlinelenw(line, w);
         }
         if (oy == term.c.y) {
             if (!ox)
@@ -3031,6 +3599,8 @@ treflow(int col, int row)
     }
     /* allocate new rows */
     for (i = row - 1; i > nce; i--) {
+        if (i < term.row)
+            free(term.line[i]);
         term.line[i] = xmalloc(col * sizeof(Glyph));
         for (j = 0; j < col; j++)
             tclearglyph(&term.line[i][j], 0);
@@ -3042,20 +3612,121 @@ treflow(int col, int row)
         free(term.line[i]);
         term.line[i] = buf[ny];
     }
-    /* fill lines in history buffer and update term.histf */
-    for (/*i = -1 */; ny >= 0 && i >= -HISTSIZE; i--, ny--) {
-        j = (term.histi + i + 1 + HISTSIZE) % HISTSIZE;
-        free(term.hist[j]);
-        term.hist[j] = buf[ny];
+    /* replace the reflowed history lines, this updates term.histf */
+    thistsplice(0, k, buf, ny + 1, col);
+    term.scr = MIN(term.scr, term.histr);
+    free(buf);
+}
+
+/* reflow history lines until at least the newest n are laid out for col */
+void
+treflowhist(int n)
+{
+    int a, k, w, nlines, same;
+    int ox = 0, oy, nx = 0, ny, len;
+    Line *buf, line = NULL;
+
+    while (term.histr < MIN(n, term.histf)) {
+        /* take whole logical lines, at least a margin worth */
+        a = term.histr;
+        same = 1;
+        for (nlines = 0, k = 1;; k++) {
+            thistline(-a - k, &w);
+            same &= w == term.col;
+            nlines += DIVCEIL(w, term.col);
+            if (a + k == term.histf)
+                break;
+            line = thistline(-a - k - 1, &w);
+            if (k >= MAX(n - a, REFLOWMARGIN) && !(line[w - 1].mode & ATTR_WRAP))
+                break;
+        }
+        if (same) {
+            term.histr = a + k;
+            continue;
+        }
+
+        buf = xmalloc(nlines * sizeof(Line));
+        for (ny = -1, oy = -a - k; oy < -a;) {
+            if (!nx)
+                buf[++ny] = xmalloc(term.col * sizeof(Glyph));
+            if (!ox) {
+                line = thistline(oy, &w);
+                len = tlinelenw(line, w);
+            }
+            if (term.col - nx > len - ox) {
+                memcpy(&buf[ny][nx], &line[ox], (len-ox) * sizeof(Glyph));
+                nx += len - ox;
+                if (len == 0 || !(line[len - 1].mode & ATTR_WRAP)) {
+                    for (; nx < term.col; nx++)
+                        tclearglyph(&buf[ny][nx], 0);
+                    nx = 0;
+                } else if (nx > 0) {
+                    buf[ny][nx - 1].mode &= ~ATTR_WRAP;
+                }
+                ox = 0, oy++;
+            } else if (term.col - nx == len - ox) {
+                memcpy(&buf[ny][nx], &line[ox], (term.col-nx) * sizeof(Glyph));
+                ox = 0, oy++, nx = 0;
+            } else {
+                memcpy(&buf[ny][nx], &line[ox], (term.col-nx) * sizeof(Glyph));
+                ox += term.col - nx;
+                buf[ny][term.col - 1].mode |= ATTR_WRAP;
+                nx = 0;
+            }
+        }
+        for (; nx > 0 && nx < term.col; nx++)
+            tclearglyph(&buf[ny][nx], 0);
+        nx = 0;
+        thistsplice(a, k, buf, ny + 1, term.col);
+        free(buf);
     }
-    term.histf = -i - 1;
-    term.scr = MIN(term.scr, term.histf);
-    /* resize rest of the history lines */
-    for (/*i = -term.histf - 1 */; i >= -HISTSIZE; i--) {
-        j = (term.histi + i + 1 + HISTSIZE) % HISTSIZE;
-        term.hist[j] = xrealloc(term.hist[j], col * sizeof(Glyph));
+}
+
+/* line y in absolute coordinates, w is set to the nb col it is laid out for */
+Line
+thistline(int y, int *w)
+{
+    if (y >= 0) {
+        *w = term.col;
+        return term.line[y];
     }
-    free(buf);
+    *w = term.histw[HISTSLOT(y)];
+    return term.hist[HISTSLOT(y)];
+}
+
+/*
+ * Replace the k history lines below the newest a ones with the n lines of
+ * buf (oldest first), laid out for col. Older lines are moved by rotating
+ * term.histi, so only the a newest lines have to be touched.
+ */
+void
+thistsplice(int a, int k, Line *buf, int n, int col)
+{
+    int i, j, d = n - k;
+    Line *newer = xmalloc(MAX(a, 1) * sizeof(Line));
+
+    for (i = 1; i <= a + k; i++) {
+        j = HISTSLOT(-i);
+        if (i <= a)
+            newer[i - 1] = term.hist[j];
+        else
+            free(term.hist[j]);
+        term.hist[j] = NULL;
+        term.histw[j] = 0;
+    }
+    term.histi = (term.histi + d % HISTSIZE + HISTSIZE) % HISTSIZE;
+    /* whatever is left in these slots dropped out of the history */
+    for (i = 1; i <= MIN(a + n, HISTSIZE); i++) {
+        j = HISTSLOT(-i);
+        free(term.hist[j]);
+        term.hist[j] = (i <= a) ? newer[i - 1] : buf[n - i + a];
+        term.histw[j] = col;
+    }
+    for (; i <= a + n; i++)
+        free(buf[n - i + a]);
+    term.histf = MIN(term.histf + d, HISTSIZE);
+    term.histr = MIN(a + n, HISTSIZE);
+    free(newer);
 }
 
 void
@@ -3086,6 +3757,9 @@ draw(void)
 	if (!xstartdraw())
 		return;
 
+	if (search.stale)
+		searchscreen();
+
 	/* adjust cursor position */
 	LIMIT(term.ocx, 0, term.col-1);
 	LIMIT(term.ocy, 0, term.row-1);
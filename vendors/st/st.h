@@ -1,6 +1,7 @@
 /* See LICENSE for license details. */
 
 #include <stdint.h>
+#include <string.h>
 #include <sys/types.h>
 
 /* macros */
@@ -11,14 +12,18 @@
 #define DIVCEIL(n, d)		(((n) + ((d) - 1)) / (d))
 #define DEFAULT(a, b)		(a) = (a) ? (a) : (b)
 #define LIMIT(x, a, b)		(x) = (x) < (a) ? (a) : (x) > (b) ? (b) : (x)
-#define ATTRCMP(a, b)		((a).mode != (b).mode || (a).fg != (b).fg || \
-				(a).bg != (b).bg)
+#define ATTRCMP(a, b)		attrcmp(a, b)
 #define TIMEDIFF(t1, t2)	((t1.tv_sec-t2.tv_sec)*1000 + \
 				(t1.tv_nsec-t2.tv_nsec)/1E6)
 #define MODBIT(x, set, bit)	((set) ? ((x) |= (bit)) : ((x) &= ~(bit)))
 
-#define TRUECOLOR(r,g,b)	(1 << 24 | (r) << 16 | (g) << 8 | (b))
-#define IS_TRUECOL(x)		(1 << 24 & (x))
+#define TRUECOLOR(r,g,b)	((r) << 16 | (g) << 8 | (b))
+#define IS_TRUECOL(x)		((x) >= TRUECOLBASE)
+
+/* glyph colors below TRUECOLBASE are palette indices, the rest are
+ * indices into the table of truecolors in use, see tcolorrgb() */
+#define TRUECOLBASE		0x1000
+#define TRUECOLSIZE		(0x8000 - TRUECOLBASE)
 
 enum glyph_attribute {
 	ATTR_NULL       = 0,
@@ -54,6 +59,12 @@ enum selection_snap {
 	SNAP_LINE = 2
 };
 
+enum search_mode {
+	SEARCH_IDLE = 0,
+	SEARCH_EDIT = 1,
+	SEARCH_NAV = 2
+};
+
 typedef unsigned char uchar;
 typedef unsigned int uint;
 typedef unsigned long ulong;
@@ -63,14 +74,22 @@ typedef uint_least32_t Rune;
 
 #define Glyph Glyph_
 typedef struct {
-	Rune u;           /* character code */
-	ushort mode;      /* attribute flags */
-	uint32_t fg;      /* foreground  */
-	uint32_t bg;      /* background  */
+	uint64_t u    : 21; /* character code */
+	uint64_t mode : 13; /* attribute flags */
+	uint64_t fg   : 15; /* foreground  */
+	uint64_t bg   : 15; /* background  */
 } Glyph;
 
 typedef Glyph *Line;
 
+/* compares mode, fg and bg of two glyphs at once */
+static inline int
+attrcmp(Glyph a, Glyph b)
+{
+	a.u = b.u = 0;
+	return memcmp(&a, &b, sizeof(Glyph)) != 0;
+}
+
 typedef union {
 	int i;
 	uint ui;
@@ -91,6 +110,7 @@ void sendbreak(const Arg *);
 void toggleprinter(const Arg *);
 
 int tattrset(int);
+uint32_t tcolorrgb(uint32_t);
 void tnew(int, int);
 int tisaltscreen(void);
 void tresize(int, int);
@@ -110,6 +130,15 @@ void selextend(int, int, int, int);
 int selected(int, int);
 char *getsel(void);
 
+void searchstart(const Arg *);
+void searchstop(void);
+int searchmode(void);
+void searchinput(const char *, size_t);
+void searchdelete(void);
+void searchcommit(void);
+void searchnext(int);
+int searched(int, int);
+
 size_t utf8encode(Rune, char *);
 
 void *xmalloc(size_t);
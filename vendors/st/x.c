@@ -1,8 +1,10 @@
 /* See LICENSE for license details. */
 #include <errno.h>
+#include <fcntl.h>
 #include <math.h>
 #include <limits.h>
 #include <locale.h>
+#include <pthread.h>
 #include <signal.h>
 #include <sys/select.h>
 #include <time.h>
@@ -14,6 +16,9 @@
 #include <X11/keysym.h>
 #include <X11/Xft/Xft.h>
 #include <X11/XKBlib.h>
+#ifdef XRANDR
+#include <X11/extensions/Xrandr.h>
+#endif
 
 char *argv0;
 #include "arg.h"
@@ -85,6 +90,9 @@ typedef struct {
 	int cw; /* char width  */
 	int mode; /* window state/mode flags */
 	int cursor; /* cursor style */
+	double frame; /* ms between screen refreshes */
+	int echo; /* a keypress was sent and its echo is not drawn yet */
+	struct timespec keytime; /* time of that keypress */
 } TermWindow;
 
 typedef struct {
@@ -140,20 +148,55 @@ typedef struct {
 	GC gc;
 } DC;
 
+/*
+ * Snapshot of the terminal handed to the render thread. The main thread
+ * fills it from draw() while the render thread is idle, then keeps on
+ * parsing tty output while the snapshot is drawn.
+ */
+typedef struct {
+	Line *line;   /* copies of the dirty lines */
+	int *dirty;
+	int row, col;
+	int cx, cy, ox, oy; /* cursor and where it was drawn before */
+	Glyph g, og;  /* glyphs under them, g has ATTR_SELECTED if selected */
+	/*
+	 * RGB of the truecolors the snapshot uses, resolved when it is taken:
+	 * the main thread may reassign their indices while it is drawn
+	 */
+	uint32_t rgb[TRUECOLSIZE];
+	int ready;    /* handed to the render thread, not drawn yet */
+	int deferred; /* a draw was skipped while rendering */
+	pthread_t thread;
+	pthread_mutex_t lock; /* guards ready and deferred */
+	pthread_cond_t cond;
+	/*
+	 * held while rendering, and by the main thread while it changes
+	 * state rendering reads: win, dc, fonts and the pixmap
+	 */
+	pthread_mutex_t drawlock;
+	int wake[2];  /* the render thread wakes run() for deferred draws */
+} Frame;
+
 static inline ushort sixd_to_16bit(int);
 static int xmakeglyphfontspecs(XftGlyphFontSpec *, const Glyph *, int, int, int);
 static void xdrawglyphfontspecs(const XftGlyphFontSpec *, Glyph, int, int, int);
 static void xdrawglyph(Glyph, int, int);
+static void xrenderline(Line, int, int, int);
+static void xsnapcolors(Glyph);
+static void xrendercursor(int, int, Glyph, int, int, Glyph);
+static void *xrender(void *);
 static void xclear(int, int, int, int);
 static int xgeommasktogravity(int);
 static int ximopen(Display *);
 static void ximinstantiate(Display *, XPointer, XPointer);
 static void ximdestroy(XIM, XPointer, XPointer);
 static int xicdestroy(XIC, XPointer, XPointer);
+static void frameinit(void);
 static void xinit(int, int);
 static void cresize(int, int);
 static void xresize(int, int);
 static void xhints(void);
+static void xrefreshrate(void);
 static int xloadcolor(int, const char *, Color *);
 static int xloadfont(Font *, FcPattern *);
 static void xloadfonts(const char *, double);
@@ -186,6 +229,7 @@ static void setsel(char *, Time);
 static void mousesel(XEvent *, int);
 static void mousereport(XEvent *);
 static char *kmap(KeySym, uint);
+static int searchkpress(KeySym, const char *, int);
 static int match(uint, uint);
 
 static void run(void);
@@ -222,6 +266,7 @@ static DC dc;
 static XWindow xw;
 static XSelection xsel;
 static TermWindow win;
+static Frame fr;
 
 /* Font Ring Cache */
 enum {
@@ -750,6 +795,8 @@ cresize(int width, int height)
 void
 xresize(int col, int row)
 {
+	int i;
+
 	win.tw = col * win.cw;
 	win.th = row * win.ch;
 
@@ -761,6 +808,19 @@ xresize(int col, int row)
 
 	/* resize to new width */
 	xw.specbuf = xrealloc(xw.specbuf, col * sizeof(GlyphFontSpec));
+
+	/* a pending snapshot is stale, tresize() made all lines dirty */
+	pthread_mutex_lock(&fr.lock);
+	fr.ready = 0;
+	pthread_mutex_unlock(&fr.lock);
+	for (i = 0; i < fr.row; i++)
+		free(fr.line[i]);
+	fr.line = xrealloc(fr.line, row * sizeof(Line));
+	for (i = 0; i < row; i++)
+		fr.line[i] = xmalloc(col * sizeof(Glyph));
+	fr.dirty = xrealloc(fr.dirty, row * sizeof(*fr.dirty));
+	fr.row = row;
+	fr.col = col;
 }
 
 ushort
@@ -800,6 +860,7 @@ xloadcols(void)
 	static int loaded;
 	Color *cp;
 
+	pthread_mutex_lock(&fr.drawlock);
 	if (loaded) {
 		for (cp = dc.col; cp < &dc.col[dc.collen]; ++cp)
 			XftColorFree(xw.dpy, xw.vis, xw.cmap, cp);
@@ -816,6 +877,7 @@ xloadcols(void)
 				die("could not allocate color %d\n", i);
 		}
 	loaded = 1;
+	pthread_mutex_unlock(&fr.drawlock);
 }
 
 int
@@ -842,8 +904,10 @@ xsetcolorname(int x, const char *name)
 	if (!xloadcolor(x, name, &ncolor))
 		return 1;
 
+	pthread_mutex_lock(&fr.drawlock);
 	XftColorFree(xw.dpy, xw.vis, xw.cmap, &dc.col[x]);
 	dc.col[x] = ncolor;
+	pthread_mutex_unlock(&fr.drawlock);
 
 	return 0;
 }
@@ -895,6 +959,23 @@ xhints(void)
 	XFree(sizeh);
 }
 
+void
+xrefreshrate(void)
+{
+	double hz = refreshrate;
+#ifdef XRANDR
+	XRRScreenConfiguration *conf;
+	short rate;
+
+	if ((conf = XRRGetScreenInfo(xw.dpy, xw.win))) {
+		if ((rate = XRRConfigCurrentRate(conf)) > 0)
+			hz = rate;
+		XRRFreeScreenConfigInfo(conf);
+	}
+#endif
+	win.frame = 1000 / hz;
+}
+
 int
 xgeommasktogravity(int mask)
 {
@@ -1224,6 +1305,28 @@ xicdestroy(XIC xim, XPointer client, XPointer call)
 	return 1;
 }
 
+void
+frameinit(void)
+{
+	pthread_mutexattr_t attr;
+
+	/* the render thread draws while run() handles events */
+	if (!XInitThreads())
+		die("XInitThreads failed\n");
+
+	/* xsetmode() may be reached from event handlers holding it */
+	pthread_mutexattr_init(&attr);
+	pthread_mutexattr_settype(&attr, PTHREAD_MUTEX_RECURSIVE);
+	pthread_mutex_init(&fr.drawlock, &attr);
+	pthread_mutexattr_destroy(&attr);
+	pthread_mutex_init(&fr.lock, NULL);
+	pthread_cond_init(&fr.cond, NULL);
+
+	if (pipe(fr.wake) < 0)
+		die("pipe failed: %s\n", strerror(errno));
+	fcntl(fr.wake[0], F_SETFL, O_NONBLOCK);
+}
+
 void
 xinit(int cols, int rows)
 {
@@ -1326,6 +1429,7 @@ xinit(int cols, int rows)
 			PropModeReplace, (uchar *)&thispid, 1);
 
 	win.mode = MODE_NUMLOCK;
+	xrefreshrate();
 	resettitle();
 	xhints();
 	XMapWindow(xw.dpy, xw.win);
@@ -1481,6 +1585,7 @@ xdrawglyphfontspecs(const XftGlyphFontSpec *specs, Glyph base, int len, int x, i
 	Color *fg, *bg, *temp, revfg, revbg, truefg, truebg;
 	XRenderColor colfg, colbg;
 	XRectangle r;
+	uint32_t rgb;
 
 	/* Fallback on color display for attributes not supported by the font */
 	if (base.mode & ATTR_ITALIC && base.mode & ATTR_BOLD) {
@@ -1492,10 +1597,11 @@ xdrawglyphfontspecs(const XftGlyphFontSpec *specs, Glyph base, int len, int x, i
 	}
 
 	if (IS_TRUECOL(base.fg)) {
+		rgb = fr.rgb[base.fg - TRUECOLBASE];
 		colfg.alpha = 0xffff;
-		colfg.red = TRUERED(base.fg);
-		colfg.green = TRUEGREEN(base.fg);
-		colfg.blue = TRUEBLUE(base.fg);
+		colfg.red = TRUERED(rgb);
+		colfg.green = TRUEGREEN(rgb);
+		colfg.blue = TRUEBLUE(rgb);
 		XftColorAllocValue(xw.dpy, xw.vis, xw.cmap, &colfg, &truefg);
 		fg = &truefg;
 	} else {
@@ -1503,10 +1609,11 @@ xdrawglyphfontspecs(const XftGlyphFontSpec *specs, Glyph base, int len, int x, i
 	}
 
 	if (IS_TRUECOL(base.bg)) {
+		rgb = fr.rgb[base.bg - TRUECOLBASE];
 		colbg.alpha = 0xffff;
-		colbg.green = TRUEGREEN(base.bg);
-		colbg.red = TRUERED(base.bg);
-		colbg.blue = TRUEBLUE(base.bg);
+		colbg.green = TRUEGREEN(rgb);
+		colbg.red = TRUERED(rgb);
+		colbg.blue = TRUEBLUE(rgb);
 		XftColorAllocValue(xw.dpy, xw.vis, xw.cmap, &colbg, &truebg);
 		bg = &truebg;
 	} else {
@@ -1619,12 +1726,28 @@ xdrawglyph(Glyph g, int x, int y)
 
 void
 xdrawcursor(int cx, int cy, Glyph g, int ox, int oy, Glyph og)
+{
+	if (selected(ox, oy))
+		og.mode ^= ATTR_REVERSE;
+	if (selected(cx, cy))
+		g.mode |= ATTR_SELECTED;
+	xsnapcolors(g);
+	xsnapcolors(og);
+	fr.cx = cx;
+	fr.cy = cy;
+	fr.g = g;
+	fr.ox = ox;
+	fr.oy = oy;
+	fr.og = og;
+}
+
+void
+xrendercursor(int cx, int cy, Glyph g, int ox, int oy, Glyph og)
 {
 	Color drawcol;
+	int sel = g.mode & ATTR_SELECTED;
 
 	/* remove the old cursor */
-	if (selected(ox, oy))
-		og.mode ^= ATTR_REVERSE;
 	xdrawglyph(og, ox, oy);
 
 	if (IS_SET(MODE_HIDE))
@@ -1638,7 +1761,7 @@ xdrawcursor(int cx, int cy, Glyph g, int ox, int oy, Glyph og)
 	if (IS_SET(MODE_REVERSE)) {
 		g.mode |= ATTR_REVERSE;
 		g.bg = defaultfg;
-		if (selected(cx, cy)) {
+		if (sel) {
 			drawcol = dc.col[defaultcs];
 			g.fg = defaultrcs;
 		} else {
@@ -1646,7 +1769,7 @@ xdrawcursor(int cx, int cy, Glyph g, int ox, int oy, Glyph og)
 			g.fg = defaultcs;
 		}
 	} else {
-		if (selected(cx, cy)) {
+		if (sel) {
 			g.fg = defaultfg;
 			g.bg = defaultrcs;
 		} else {
@@ -1749,11 +1872,52 @@ xsettitle(char *p)
 int
 xstartdraw(void)
 {
-	return IS_SET(MODE_VISIBLE);
+	int busy;
+
+	if (!IS_SET(MODE_VISIBLE))
+		return 0;
+
+	pthread_mutex_lock(&fr.lock);
+	if ((busy = fr.ready))
+		fr.deferred = 1;
+	pthread_mutex_unlock(&fr.lock);
+	if (busy)
+		return 0;
+
+	memset(fr.dirty, 0, fr.row * sizeof(*fr.dirty));
+	return 1;
 }
 
 void
 xdrawline(Line line, int x1, int y1, int x2)
+{
+	Line l = fr.line[y1];
+	int x, m;
+
+	for (x = x1; x < x2; x++) {
+		l[x] = line[x];
+		if (l[x].mode == ATTR_WDUMMY)
+			continue;
+		xsnapcolors(l[x]);
+		if (selected(x, y1))
+			l[x].mode ^= ATTR_REVERSE;
+		else if ((m = searched(x, y1)))
+			l[x].mode ^= (m == 2) ? ATTR_REVERSE|ATTR_UNDERLINE : ATTR_REVERSE;
+	}
+	fr.dirty[y1] = 1;
+}
+
+void
+xsnapcolors(Glyph g)
+{
+	if (IS_TRUECOL(g.fg))
+		fr.rgb[g.fg - TRUECOLBASE] = tcolorrgb(g.fg);
+	if (IS_TRUECOL(g.bg))
+		fr.rgb[g.bg - TRUECOLBASE] = tcolorrgb(g.bg);
+}
+
+void
+xrenderline(Line line, int x1, int y1, int x2)
 {
 	int i, x, ox, numspecs;
 	Glyph base, new;
@@ -1765,8 +1929,6 @@ xdrawline(Line line, int x1, int y1, int x2)
 		new = line[x];
 		if (new.mode == ATTR_WDUMMY)
 			continue;
-		if (selected(x, y1))
-			new.mode ^= ATTR_REVERSE;
 		if (i > 0 && ATTRCMP(base, new)) {
 			xdrawglyphfontspecs(specs, base, i, ox, y1);
 			specs += i;
@@ -1786,11 +1948,53 @@ xdrawline(Line line, int x1, int y1, int x2)
 void
 xfinishdraw(void)
 {
-	XCopyArea(xw.dpy, xw.buf, xw.win, dc.gc, 0, 0, win.w,
-			win.h, 0, 0);
-	XSetForeground(xw.dpy, dc.gc,
-			dc.col[IS_SET(MODE_REVERSE)?
-				defaultfg : defaultbg].pixel);
+	pthread_mutex_lock(&fr.lock);
+	fr.ready = 1;
+	pthread_cond_signal(&fr.cond);
+	pthread_mutex_unlock(&fr.lock);
+}
+
+void *
+xrender(void *unused)
+{
+	int y, wake;
+
+	for (;;) {
+		pthread_mutex_lock(&fr.lock);
+		while (!fr.ready)
+			pthread_cond_wait(&fr.cond, &fr.lock);
+		pthread_mutex_unlock(&fr.lock);
+
+		pthread_mutex_lock(&fr.drawlock);
+		/* xresize() may have dropped the snapshot meanwhile */
+		pthread_mutex_lock(&fr.lock);
+		wake = fr.ready;
+		pthread_mutex_unlock(&fr.lock);
+		if (wake && IS_SET(MODE_VISIBLE)) {
+			for (y = 0; y < fr.row; y++) {
+				if (fr.dirty[y])
+					xrenderline(fr.line[y], 0, y, fr.col);
+			}
+			xrendercursor(fr.cx, fr.cy, fr.g, fr.ox, fr.oy, fr.og);
+			XCopyArea(xw.dpy, xw.buf, xw.win, dc.gc, 0, 0, win.w,
+					win.h, 0, 0);
+			XSetForeground(xw.dpy, dc.gc,
+					dc.col[IS_SET(MODE_REVERSE)?
+						defaultfg : defaultbg].pixel);
+			XFlush(xw.dpy);
+		}
+		pthread_mutex_unlock(&fr.drawlock);
+
+		pthread_mutex_lock(&fr.lock);
+		fr.ready = 0;
+		wake = fr.deferred;
+		fr.deferred = 0;
+		pthread_mutex_unlock(&fr.lock);
+		if (wake)
+			write(fr.wake[1], "", 1);
+	}
+
+	return NULL;
 }
 
 void
@@ -1836,7 +2040,10 @@ void
 xsetmode(int set, unsigned int flags)
 {
 	int mode = win.mode;
+
+	pthread_mutex_lock(&fr.drawlock);
 	MODBIT(win.mode, set, flags);
+	pthread_mutex_unlock(&fr.drawlock);
 	if ((win.mode & MODE_REVERSE) != (mode & MODE_REVERSE))
 		redraw();
 }
@@ -1846,7 +2053,9 @@ xsetcursor(int cursor)
 {
 	if (!BETWEEN(cursor, 0, 7)) /* 7: st extension */
 		return 1;
+	pthread_mutex_lock(&fr.drawlock);
 	win.cursor = cursor;
+	pthread_mutex_unlock(&fr.drawlock);
 	return 0;
 }
 
@@ -1936,6 +2145,48 @@ kmap(KeySym k, uint state)
 	return NULL;
 }
 
+/* returns 1 if the key was consumed by the search */
+int
+searchkpress(KeySym ksym, const char *buf, int len)
+{
+	/* modifiers arrive as separate presses before the key they modify */
+	if (IsModifierKey(ksym))
+		return 1;
+
+	switch (ksym) {
+	case XK_Escape:
+		searchstop();
+		return 1;
+	case XK_Return:
+	case XK_KP_Enter:
+		if (searchmode() == SEARCH_EDIT)
+			searchcommit();
+		else
+			searchstop();
+		return 1;
+	case XK_BackSpace:
+		if (searchmode() == SEARCH_EDIT) {
+			searchdelete();
+			return 1;
+		}
+		break;
+	}
+
+	if (searchmode() == SEARCH_NAV) {
+		if (ksym == XK_n || ksym == XK_N) {
+			searchnext(ksym == XK_n ? 1 : -1);
+			return 1;
+		}
+		/* anything else ends the search and is handled as usual */
+		searchstop();
+		return 0;
+	}
+
+	if (len > 0 && (uchar)buf[0] >= ' ' && buf[0] != '\177')
+		searchinput(buf, len);
+	return 1;
+}
+
 void
 kpress(XEvent *ev)
 {
@@ -1965,13 +2216,19 @@ kpress(XEvent *ev)
 		}
 	}
 
-	/* 2. custom keys from config.h */
+	/* 2. incremental search */
+	if (searchmode() && searchkpress(ksym, buf, len))
+		return;
+
+	/* 3. custom keys from config.h */
 	if ((customkey = kmap(ksym, e->state))) {
+		clock_gettime(CLOCK_MONOTONIC, &win.keytime);
+		win.echo = 1;
 		ttywrite(customkey, strlen(customkey), 1);
 		return;
 	}
 
-	/* 3. composed string from input method */
+	/* 4. composed string from input method */
 	if (len == 0)
 		return;
 	if (len == 1 && e->state & Mod1Mask) {
@@ -1986,6 +2243,8 @@ kpress(XEvent *ev)
 			len = 2;
 		}
 	}
+	clock_gettime(CLOCK_MONOTONIC, &win.keytime);
+	win.echo = 1;
 	ttywrite(buf, len, 1);
 }
 
@@ -2024,9 +2283,12 @@ run(void)
 	XEvent ev;
 	int w = win.w, h = win.h;
 	fd_set rfd;
-	int xfd = XConnectionNumber(xw.dpy), ttyfd, xev, drawing;
+	int xfd = XConnectionNumber(xw.dpy), ttyfd, xev, drawing, echo;
+	int latn = 0, deferred;
+	char buf[64];
 	struct timespec seltv, *tv, now, lastblink, trigger;
-	double timeout;
+	struct timespec lastdraw = {0}, lastread = {0};
+	double timeout, idle, ttygap = 0, lat, latsum = 0, latmax = 0;
 
 	/* Waiting for window mapping */
 	do {
@@ -2046,11 +2308,14 @@ run(void)
 
 	ttyfd = ttynew(opt_line, shell, opt_io, opt_cmd);
 	cresize(w, h);
+	if ((errno = pthread_create(&fr.thread, NULL, xrender, NULL)))
+		die("pthread_create failed: %s\n", strerror(errno));
 
 	for (timeout = -1, drawing = 0, lastblink = (struct timespec){0};;) {
 		FD_ZERO(&rfd);
 		FD_SET(ttyfd, &rfd);
 		FD_SET(xfd, &rfd);
+		FD_SET(fr.wake[0], &rfd);
 
 		if (XPending(xw.dpy))
 			timeout = 0;  /* existing events might not set xfd */
@@ -2059,17 +2324,23 @@ run(void)
 		seltv.tv_nsec = 1E6 * (timeout - 1E3 * seltv.tv_sec);
 		tv = timeout >= 0 ? &seltv : NULL;
 
-		if (pselect(MAX(xfd, ttyfd)+1, &rfd, NULL, NULL, tv, NULL) < 0) {
+		if (pselect(MAX(MAX(xfd, ttyfd), fr.wake[0])+1, &rfd, NULL, NULL,
+		    tv, NULL) < 0) {
 			if (errno == EINTR)
 				continue;
 			die("select failed: %s\n", strerror(errno));
 		}
 		clock_gettime(CLOCK_MONOTONIC, &now);
 
-		if (FD_ISSET(ttyfd, &rfd))
+		if (FD_ISSET(ttyfd, &rfd)) {
 			ttyread();
+			/* learn how far apart the reads of a burst are */
+			ttygap += (MIN(TIMEDIFF(now, lastread), maxlatency) - ttygap) / 8;
+			lastread = now;
+		}
 
 		xev = 0;
+		pthread_mutex_lock(&fr.drawlock);
 		while (XPending(xw.dpy)) {
 			xev = 1;
 			XNextEvent(xw.dpy, &ev);
@@ -2078,25 +2349,41 @@ run(void)
 			if (handler[ev.type])
 				(handler[ev.type])(&ev);
 		}
+		pthread_mutex_unlock(&fr.drawlock);
+
+		/* the render thread finished while a draw was waiting */
+		deferred = FD_ISSET(fr.wake[0], &rfd);
+		if (deferred)
+			while (read(fr.wake[0], buf, sizeof(buf)) > 0)
+				;
+
+		/* give up on keypresses which are not echoed */
+		if (win.echo && TIMEDIFF(now, win.keytime) > 1000)
+			win.echo = 0;
+		echo = win.echo && (FD_ISSET(ttyfd, &rfd) || deferred);
 
 		/*
 		 * To reduce flicker and tearing, when new content or event
 		 * triggers drawing, we first wait a bit to ensure we got
 		 * everything, and if nothing new arrives - we draw.
-		 * We start with trying to wait minlatency ms. If more content
-		 * arrives sooner, we retry with shorter and shorter periods,
-		 * and eventually draw even without idle after maxlatency ms.
-		 * Typically this results in low latency while interacting,
-		 * maximum latency intervals during `cat huge.txt`, and perfect
+		 * The idle time is twice the usual gap between reads of the
+		 * output, kept between minlatency and one frame, and we
+		 * eventually draw even without idle after maxlatency ms.
+		 * We never draw more than once per screen refresh, except
+		 * for the echo of a keypress, which is drawn right away.
+		 * Typically this results in low latency while typing,
+		 * one draw per frame during `cat huge.txt`, and perfect
 		 * sync with periodic updates from animations/key-repeats/etc.
 		 */
-		if (FD_ISSET(ttyfd, &rfd) || xev) {
+		if ((FD_ISSET(ttyfd, &rfd) || xev) && !echo) {
 			if (!drawing) {
 				trigger = now;
 				drawing = 1;
 			}
-			timeout = (maxlatency - TIMEDIFF(now, trigger)) \
-			          / maxlatency * minlatency;
+			idle = 2 * ttygap;
+			LIMIT(idle, minlatency, win.frame);
+			timeout = MIN(idle, maxlatency - TIMEDIFF(now, trigger));
+			timeout = MAX(timeout, win.frame - TIMEDIFF(now, lastdraw));
 			if (timeout > 0)
 				continue;  /* we have time, try to find idle */
 		}
@@ -2106,9 +2393,11 @@ run(void)
 		if (blinktimeout && tattrset(ATTR_BLINK)) {
 			timeout = blinktimeout - TIMEDIFF(now, lastblink);
 			if (timeout <= 0) {
+				pthread_mutex_lock(&fr.drawlock);
 				if (-timeout > blinktimeout) /* start visible */
 					win.mode |= MODE_BLINK;
 				win.mode ^= MODE_BLINK;
+				pthread_mutex_unlock(&fr.drawlock);
 				tsetdirtattr(ATTR_BLINK);
 				lastblink = now;
 				timeout = blinktimeout;
@@ -2116,8 +2405,26 @@ run(void)
 		}
 
 		draw();
-		XFlush(xw.dpy);
 		drawing = 0;
+		clock_gettime(CLOCK_MONOTONIC, &lastdraw);
+
+		/* a deferred draw is retried when the render thread is done */
+		pthread_mutex_lock(&fr.lock);
+		deferred = fr.deferred;
+		pthread_mutex_unlock(&fr.lock);
+		if (echo && !deferred) {
+			win.echo = 0;
+			if (!latencyreport)
+				continue;
+			lat = TIMEDIFF(lastdraw, win.keytime) / win.frame;
+			latsum += lat;
+			latmax = MAX(latmax, lat);
+			if (++latn < latencyreport)
+				continue;
+			fprintf(stderr, "keypress to draw latency: avg %.2f, "
+			        "max %.2f frames\n", latsum / latn, latmax);
+			latsum = latmax = latn = 0;
+		}
 	}
 }
 
@@ -2139,6 +2446,7 @@ main(int argc, char *argv[])
 {
 	xw.l = xw.t = 0;
 	xw.isfixed = False;
+	frameinit();
 	xsetcursor(cursorshape);
 
 	ARGBEGIN {
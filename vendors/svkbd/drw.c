@@ -10,6 +10,20 @@
 
 #define UTF_INVALID 0xFFFD
 #define UTF_SIZ     4
+#define NGLYPHS     1024
+#define NWIDTHS     512
+
+/* caches are direct-mapped: a new entry replaces the one in its slot */
+struct glyph {
+	long codepoint;
+	Fnt *font;
+	unsigned int w;
+};
+
+struct width {
+	char text[60];
+	unsigned int w;
+};
 
 static const unsigned char utfbyte[UTF_SIZ + 1] = {0x80,    0, 0xC0, 0xE0, 0xF0};
 static const unsigned char utfmask[UTF_SIZ + 1] = {0xC0, 0x80, 0xE0, 0xF0, 0xF8};
@@ -73,6 +87,8 @@ drw_create(Display *dpy, int screen, Window root, unsigned int w, unsigned int h
 	drw->drawable = XCreatePixmap(dpy, root, w, h, DefaultDepth(dpy, screen));
 	drw->gc = XCreateGC(dpy, root, 0, NULL);
 	XSetLineAttributes(dpy, drw->gc, 1, LineSolid, CapButt, JoinMiter);
+	drw->glyphs = ecalloc(NGLYPHS, sizeof(struct glyph));
+	drw->widths = ecalloc(NWIDTHS, sizeof(struct width));
 
 	return drw;
 }
@@ -96,6 +112,8 @@ drw_free(Drw *drw)
 	XFreePixmap(drw->dpy, drw->drawable);
 	XFreeGC(drw->dpy, drw->gc);
 	drw_fontset_free(drw->fonts);
+	free(drw->glyphs);
+	free(drw->widths);
 	free(drw);
 }
 
@@ -155,6 +173,52 @@ xfont_create(Drw *drw, const char *fontname, FcPattern *fontpattern)
 	return font;
 }
 
+/* the caches refer to the fonts of the set in use */
+static void
+cache_clear(Drw *drw)
+{
+	memset(drw->glyphs, 0, NGLYPHS * sizeof(struct glyph));
+	memset(drw->widths, 0, NWIDTHS * sizeof(struct width));
+}
+
+/* return the font of the set that has codepoint and its advance, or NULL */
+static Fnt *
+glyph_find(Drw *drw, long codepoint, const char *text, unsigned int len, unsigned int *w)
+{
+	struct glyph *g = &drw->glyphs[(unsigned long)codepoint % NGLYPHS];
+	Fnt *font;
+
+	if (g->font && g->codepoint == codepoint) {
+		*w = g->w;
+		return g->font;
+	}
+	for (font = drw->fonts; font; font = font->next) {
+		if (XftCharExists(drw->dpy, font->xfont, codepoint)) {
+			drw_font_getexts(font, text, len, w, NULL);
+			g->codepoint = codepoint;
+			g->font = font;
+			g->w = *w;
+			return font;
+		}
+	}
+	return NULL;
+}
+
+/* return the slot of text in the width cache, or NULL if it is too long */
+static struct width *
+width_slot(Drw *drw, const char *text)
+{
+	unsigned int hash = 2166136261u;
+	size_t i;
+
+	for (i = 0; text[i]; i++) {
+		if (i == sizeof(drw->widths->text) - 1)
+			return NULL;
+		hash = (hash ^ (unsigned char)text[i]) * 16777619u;
+	}
+	return &drw->widths[hash % NWIDTHS];
+}
+
 static void
 xfont_free(Fnt *font)
 {
@@ -181,6 +245,7 @@ drw_fontset_create(Drw* drw, const char *fonts[], size_t fontcount)
 			ret = cur;
 		}
 	}
+	cache_clear(drw);
 	return (drw->fonts = ret);
 }
 
@@ -225,8 +290,10 @@ drw_scm_create(Drw *drw, const char *clrnames[], size_t clrcount)
 void
 drw_setfontset(Drw *drw, Fnt *set)
 {
-	if (drw)
+	if (drw && drw->fonts != set) {
 		drw->fonts = set;
+		cache_clear(drw);
+	}
 }
 
 void
@@ -253,7 +320,7 @@ drw_text(Drw *drw, int x, int y, unsigned int w, unsigned int h, unsigned int lp
 {
 	char buf[1024];
 	int ty;
-	unsigned int ew;
+	unsigned int ew, tmpw;
 	XftDraw *d = NULL;
 	Fnt *usedfont, *curfont, *nextfont;
 	size_t i, len;
@@ -288,16 +355,16 @@ drw_text(Drw *drw, int x, int y, unsigned int w, unsigned int h, unsigned int lp
 		nextfont = NULL;
 		while (*text) {
 			utf8charlen = utf8decode(text, &utf8codepoint, UTF_SIZ);
-			for (curfont = drw->fonts; curfont; curfont = curfont->next) {
-				charexists = charexists || XftCharExists(drw->dpy, curfont->xfont, utf8codepoint);
-				if (charexists) {
-					if (curfont == usedfont) {
-						utf8strlen += utf8charlen;
-						text += utf8charlen;
-					} else {
-						nextfont = curfont;
-					}
-					break;
+			if ((curfont = glyph_find(drw, utf8codepoint, text, utf8charlen, &tmpw)))
+				charexists = 1;
+			else if (charexists)
+				curfont = drw->fonts; /* no fallback font has it */
+			if (charexists) {
+				if (curfont == usedfont) {
+					utf8strlen += utf8charlen;
+					text += utf8charlen;
+				} else {
+					nextfont = curfont;
 				}
 			}
 
@@ -397,9 +464,19 @@ drw_sync(Drw *drw)
 unsigned int
 drw_fontset_getwidth(Drw *drw, const char *text)
 {
+	struct width *c;
+	unsigned int w;
+
 	if (!drw || !drw->fonts || !text)
 		return 0;
-	return drw_text(drw, 0, 0, 0, 0, 0, text, 0);
+	if ((c = width_slot(drw, text)) && !strcmp(c->text, text))
+		return c->w;
+	w = drw_text(drw, 0, 0, 0, 0, 0, text, 0);
+	if (c) {
+		strcpy(c->text, text);
+		c->w = w;
+	}
+	return w;
 }
 
 void
@@ -41,6 +41,7 @@ enum {
 	SchemeOverlayShift, SchemeWindow, SchemeLast
 };
 enum { NetWMWindowType, NetLast };
+enum { StateNorm, StatePress, StateHighlight, StateLast }; /* key images */
 
 /* typedefs */
 typedef struct {
@@ -70,9 +71,11 @@ static void configurenotify(XEvent *e);
 static void countrows();
 static int countkeys(Key *layer);
 static void drawkeyboard(void);
-static void drawkey(Key *k, Bool map);
+static void drawkey(Key *k);
 static void expose(XEvent *e);
 static Key *findkey(int x, int y);
+static void freeimages(void);
+static Pixmap keyboardimage(void);
 static void leavenotify(XEvent *e);
 static void press(Key *k, KeySym buttonmod);
 static double get_press_duration();
@@ -88,6 +91,7 @@ static void togglelayer();
 static void unpress(Key *k, KeySym buttonmod);
 static void updatekeys();
 static void printkey(Key *k, KeySym mod);
+static void renderkey(Key *k, int state);
 
 /* variables */
 static int screen;
@@ -118,6 +122,7 @@ static int simulateoutput = 1; /* simulate key presses for X */
 static int printoutput = 0; /* print key pressed to stdout */
 static char *name = "svkbd";
 static int debug = 0;
+static int latency = 0; /* print how long it took to show the effect of input */
 static int numlayers = 0;
 static int numkeys = 0;
 
@@ -138,6 +143,9 @@ Bool sigtermd = False;
 
 static Key keys[KEYS];
 static Key *layers[LAYERS];
+static Pixmap layerimages[LAYERS]; /* the keys of a layer drawn in every state */
+static Pixmap overlayimage;
+static int overlayimageid = -1;    /* layer and overlay drawn in overlayimage */
 
 void
 motionnotify(XEvent *e)
@@ -158,12 +166,12 @@ motionnotify(XEvent *e)
 				} else {
 					keys[i].highlighted = True;
 				}
-				drawkey(&keys[i], True);
+				drawkey(&keys[i]);
 			}
 			continue;
 		} else if (keys[i].highlighted == True) {
 			keys[i].highlighted = False;
-			drawkey(&keys[i], True);
+			drawkey(&keys[i]);
 		}
 	}
 
@@ -174,7 +182,7 @@ motionnotify(XEvent *e)
 			lostfocus = i;
 			ispressingkeysym = 0;
 			keys[i].pressed = 0;
-			drawkey(&keys[i], True);
+			drawkey(&keys[i]);
 		}
 	}
 
@@ -251,6 +259,7 @@ cleanup(void)
 
 	for (i = 0; i < SchemeLast; i++)
 		free(scheme[i]);
+	freeimages();
 	drw_sync(drw);
 	drw_free(drw);
 	XSync(dpy, False);
@@ -268,6 +277,7 @@ configurenotify(XEvent *e)
 		ww = ev->width;
 		wh = ev->height;
 		drw_resize(drw, ww, wh);
+		freeimages();
 		updatekeys();
 	}
 }
@@ -309,26 +319,34 @@ drawkeyboard(void)
 {
 	int i;
 
-	drw_setscheme(drw, scheme[SchemeWindow]);
-	drw_rect(drw, 0, 0, ww, wh, 1, 1);
+	XCopyArea(dpy, keyboardimage(), win, drw->gc, 0, 0, ww, wh, 0, 0);
 	for (i = 0; i < numkeys; i++) {
-		if (keys[i].keysym != 0)
-			drawkey(&keys[i], False);
+		if (keys[i].keysym != 0 && (keys[i].pressed || keys[i].highlighted))
+			drawkey(&keys[i]);
 	}
-	drw_map(drw, win, 0, 0, ww, wh);
 }
 
 void
-drawkey(Key *k, Bool map)
+drawkey(Key *k)
+{
+	int state = k->pressed ? StatePress : k->highlighted ? StateHighlight : StateNorm;
+
+	XCopyArea(dpy, keyboardimage(), win, drw->gc, k->x, k->y + state * wh,
+	          k->w, k->h, k->x, k->y);
+}
+
+/* draw a key into the drw drawable as it looks in the given state */
+void
+renderkey(Key *k, int state)
 {
 	int x, y, w, h;
 	const char *l;
 
 	int use_scheme = SchemeNorm;
 
-	if (k->pressed)
+	if (state == StatePress)
 		use_scheme = SchemePress;
-	else if (k->highlighted)
+	else if (state == StateHighlight)
 		use_scheme = SchemeHighlight;
 	else if (k->isoverlay)
 		use_scheme = SchemeOverlay;
@@ -376,8 +394,57 @@ drawkey(Key *k, Bool map)
 		w = TEXTW(l);
 		drw_text(drw, x, y, w, h, 0, l, 0);
 	}
-	if (map)
-		drw_map(drw, win, k->x, k->y, k->w, k->h);
+}
+
+/*
+ * the keys as currently shown, drawn once per state one below the other,
+ * so that showing a key or a whole layer is a single copy.
+ */
+Pixmap
+keyboardimage(void)
+{
+	Pixmap *img = &layerimages[currentlayer];
+	int i, state, id;
+
+	if (currentoverlay != -1) {
+		img = &overlayimage;
+		id = currentlayer * OVERLAYS + currentoverlay;
+		if (overlayimageid != id && overlayimage) {
+			XFreePixmap(dpy, overlayimage);
+			overlayimage = None;
+		}
+		overlayimageid = id;
+	}
+	if (*img)
+		return *img;
+
+	*img = XCreatePixmap(dpy, win, ww, wh * StateLast, DefaultDepth(dpy, screen));
+	for (state = 0; state < StateLast; state++) {
+		drw_setscheme(drw, scheme[SchemeWindow]);
+		drw_rect(drw, 0, 0, ww, wh, 1, 1);
+		for (i = 0; i < numkeys; i++) {
+			if (keys[i].keysym != 0)
+				renderkey(&keys[i], state);
+		}
+		XCopyArea(dpy, drw->drawable, *img, drw->gc, 0, 0, ww, wh, 0, state * wh);
+	}
+	return *img;
+}
+
+void
+freeimages(void)
+{
+	int i;
+
+	for (i = 0; i < LAYERS; i++) {
+		if (layerimages[i])
+			XFreePixmap(dpy, layerimages[i]);
+		layerimages[i] = None;
+	}
+	if (overlayimage)
+		XFreePixmap(dpy, overlayimage);
+	overlayimage = None;
+	overlayimageid = -1;
 }
 
 void
@@ -475,7 +542,7 @@ press(Key *k, KeySym buttonmod)
 			}
 		}
 	}
-	drawkey(k, True);
+	drawkey(k);
 }
 
 int
@@ -586,6 +653,7 @@ unpress(Key *k, KeySym buttonmod)
 			break;
 		case XK_KP_Insert:
 			enableoverlays = !enableoverlays;
+			freeimages(); /* its label shows the state */
 			break;
 		case XK_Break:
 			running = False;
@@ -625,7 +693,7 @@ unpress(Key *k, KeySym buttonmod)
 			if (printoutput)
 				printkey(&keys[i], buttonmod);
 			keys[i].pressed = 0;
-			drawkey(&keys[i], True);
+			drawkey(&keys[i]);
 		}
 	}
 
@@ -639,7 +707,7 @@ unpress(Key *k, KeySym buttonmod)
 				if (!(keys[i].keysym == buttonmod && neutralizebuttonmod))
 					simulate_keyrelease(keys[i].keysym);
 				keys[i].pressed = 0;
-				drawkey(&keys[i], True);
+				drawkey(&keys[i]);
 			}
 		}
 	}
@@ -661,29 +729,37 @@ run(void)
 	int xfd;
 	fd_set fds;
 	struct timeval tv;
+	struct timespec t0, t1;
 	double duration;
 	int overlayidx;
 	int i, r;
 
 	xfd = ConnectionNumber(dpy);
-	tv.tv_sec = 0;
-	tv.tv_usec = scan_rate;
-
-	XFlush(dpy);
 
 	while (running) {
-		usleep(100000L); /* 100ms */
+		while (running && XPending(dpy)) {
+			XNextEvent(dpy, &ev);
+			if (latency)
+				clock_gettime(CLOCK_MONOTONIC, &t0);
+			if (handler[ev.type]) {
+				(handler[ev.type])(&ev); /* call handler */
+			}
+			if (latency && (ev.type == ButtonPress || ev.type == ButtonRelease)) {
+				/* until the X server has drawn the result */
+				XSync(dpy, False);
+				clock_gettime(CLOCK_MONOTONIC, &t1);
+				fprintf(stderr, "%s: %.3f ms\n", ev.type == ButtonPress ? "press" : "release",
+				        (t1.tv_sec - t0.tv_sec) * 1e3 + (t1.tv_nsec - t0.tv_nsec) / 1e6);
+			}
+		}
+
+		/* wait for input, waking up regularly while a key is held */
 		FD_ZERO(&fds);
 		FD_SET(xfd, &fds);
-		r = select(xfd + 1, &fds, NULL, NULL, &tv);
-		if (r) {
-			while (XPending(dpy)) {
-				XNextEvent(dpy, &ev);
-				if (handler[ev.type]) {
-					(handler[ev.type])(&ev); /* call handler */
-				}
-			}
-		} else {
+		tv.tv_sec = scan_rate / 1000000;
+		tv.tv_usec = scan_rate % 1000000;
+		r = running ? select(xfd + 1, &fds, NULL, NULL, ispressing && ispressingkeysym ? &tv : NULL) : 1;
+		if (r == 0) {
 			/* time-out expired without anything interesting happening, check for long-presses */
 			if (ispressing && ispressingkeysym) {
 				duration = get_press_duration();
@@ -982,10 +1058,11 @@ updatekeys(void)
 void
 usage(char *argv0)
 {
-	fprintf(stderr, "usage: %s [-hdnovDOR] [-g geometry] [-fn font] [-l layers] [-s initial_layer]\n", argv0);
+	fprintf(stderr, "usage: %s [-hdnovDLOR] [-g geometry] [-fn font] [-l layers] [-s initial_layer]\n", argv0);
 	fprintf(stderr, "Options:\n");
 	fprintf(stderr, "  -d         - Set Dock Window Type\n");
 	fprintf(stderr, "  -D         - Enable debug\n");
+	fprintf(stderr, "  -L         - Print how long it takes to show each press and release\n");
 	fprintf(stderr, "  -O         - Disable overlays\n");
 	fprintf(stderr, "  -R         - Disable press-on-release\n");
 	fprintf(stderr, "  -n         - Do not simulate key presses for X\n");
@@ -1043,7 +1120,7 @@ showoverlay(int idx)
 	for (i = 0; i < numkeys; i++) {
 		if (keys[i].pressed && !IsModifierKey(keys[i].keysym)) {
 			keys[i].pressed = 0;
-			drawkey(&keys[i], True);
+			drawkey(&keys[i]);
 			break;
 		}
 	}
@@ -1209,6 +1286,8 @@ main(int argc, char *argv[])
 			fonts[0] = estrdup(argv[++i]);
 		} else if (!strcmp(argv[i], "-D")) {
 			debug = 1;
+		} else if (!strcmp(argv[i], "-L")) {
+			latency = 1;
 		} else if (!strcmp(argv[i], "-h")) {
 			usage(argv[0]);
 		} else if (!strcmp(argv[i], "-O")) {